@@ -0,0 +1,89 @@
+#include <utility>  // (first: see statemachine.h)
+#include <iostream>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <functional>
+
+#include <experimental/optional>
+
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "descriptor_input.h"
+
+
+
+// usage: ping_pong [trace_file]
+int main(int argc, char *argv[])
+{
+  const int stdin_fd = ::dup(STDIN_FILENO); // the keyboard (read on the io_service, see below)
+  if (stdin_fd < 0) {
+    std::cerr << "stdin: " << std::strerror(errno) << " (no input)\nusage: ping_pong [trace_file]\n";
+    return 1;
+  }
+
+  std::cout <<
+    "There are 2 states: statePing and statePong\n"
+    "When timer running then:\n"
+    "Maximum lifetime of statePing is 1000 ms - it will then automatically transition to statePong;\n"
+    "Maximum lifetime of statePong is 2000 ms - it will then automatically transition to statePing.\n"
+    "\n"
+    "Keyboard-Input can cause transitions before the max-lifetime-timeouts:\n"
+    "'x': xchange state\n"
+    "'i': leave current state and go to statePing (pIng)\n"
+    "'o': leave current state and go to statePong (pOng)\n"
+    "'t': toggle timer (on/off)\n"
+    "'q' or eof (Ctrl-d): exit\n"
+    "\n"
+    "...Hit Enter to start!" << std::flush;
+
+  if (::isatty(STDIN_FILENO)) // (std::cin would buffer more than a line of a pipe)
+    std::cin.ignore();
+
+
+  boost::asio::io_service io_service;
+
+  //work to keep io_service busy
+  std::experimental::optional<boost::asio::io_service::work> work(std::experimental::in_place, io_service);
+  /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
+
+  // always-on trace of every entry / exit (see trace_recorder.h; decode with trace_decode)
+  TraceRecorder trace{(argc > 1) ? argv[1] : "ping_pong.trace"};
+  TraceRecorder::current() = &trace; // the machine runs on this thread (io_service.run() below)
+
+  StateMachine sm{io_service};
+  sm.start();
+
+  // timer accuracy (lateness, phase error): reported on SIGUSR1 and at exit
+  boost::asio::signal_set report_signal{io_service, SIGUSR1};
+  std::function<void(const boost::system::error_code &, int)> on_report = [&](const boost::system::error_code &err, int) {
+      if (!err) {
+        sm.timer_stats().report(std::cerr);
+        report_signal.async_wait(on_report);
+      }
+    };
+  report_signal.async_wait(on_report);
+
+  // stdin is read in chunks on this thread (see descriptor_input.h)
+  const EventID key_events[] = {eidI, eidO, eidX, eidT, eidQ};
+  DescriptorInput<EventID> stdin_input{io_service, stdin_fd, "ioxtq", key_events, 'q', [&](Span<const EventID> events) {
+      for (EventID eid : events) {
+        sm.process_event(eid);       // (eidQ: the coroutine returns)
+        if (eid == eidQ) {
+          work = std::experimental::nullopt; /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
+          report_signal.cancel();
+        }
+      }
+    }};
+
+  io_service.run();
+
+  AsyncLogger::instance().flush(); // last "Leaving : ..."
+  sm.timer_stats().report(std::cerr);
+
+  return 0;
+}
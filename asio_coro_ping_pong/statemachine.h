@@ -0,0 +1,197 @@
+#ifndef STATEMACHINE_H
+#define STATEMACHINE_H
+
+#include <utility>  // (first: boost/asio/awaitable.hpp of Boost 1.74 uses std::exchange without including it)
+#include <string>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include "async_logger.h"
+#include "trace_recorder.h"
+#include "timer_stats.h"
+
+
+
+
+//////////
+// events (ids as in the other realizations: recordings and traces are interchangeable)
+//////////
+enum EventID : std::uint8_t {
+  eidI, // pIng
+  eidO, // pOng
+  eidX, // xchange
+  eidT, // toggle timer on/off
+  eidQ, // quit
+  eidTimeout // deadline of the current state passed (not from the keyboard)
+};
+
+
+
+
+////////////////
+// State Machine: one C++20 coroutine per machine
+//
+// The whole behaviour is the loop in run(): wait until either the deadline of the current
+// state passes or an event arrives, then make the transition. State, timer_running and the
+// deadline are locals of the coroutine; its frame replaces the state objects, timeout
+// callbacks and recycled handler memory of the callback realization (asio_ping_pong).
+//
+// The race of deadline and event channel: the coroutine waits on its timer (expiring at the
+// deadline, or never while the timer is off); process_event() puts the event into the
+// mailbox and cancels that wait. (Boost 1.74 has neither asio's experimental channels nor the
+// awaitable operators || , so the timer doubles as the channel's wake-up.)
+//
+// process_event() only queues: the transition happens when the io_service runs the
+// coroutine. Before a StateMachine is destroyed, stop() it and let the io_service run, so that
+// the coroutine has returned.
+////////////////
+class StateMachine {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  enum StateID : std::uint8_t {
+    sidPing,
+    sidPong,
+    NumStates
+  };
+
+  StateMachine(boost::asio::io_service &io_service, std::uint32_t instance_ = 0)
+    : timer{io_service}, instance{instance_} {}
+
+  StateMachine(const StateMachine &) = delete;
+  StateMachine &operator=(const StateMachine &) = delete;
+
+  // enter the initial state (statePing), once the io_service runs
+  void start() {
+    boost::asio::co_spawn(timer.get_executor(), run(), boost::asio::detached);
+  }
+
+  void process_event(EventID eid) {
+    mailbox.push_back(eid);
+    timer.cancel();  // wake the coroutine
+  }
+
+  // leave the current state (the coroutine returns)
+  void stop() { process_event(eidQ); }
+
+  bool is_active(StateID sid) const { return state == sid; }
+
+  // accuracy of the timeouts (see timer_stats.h)
+  TimerStats &timer_stats() { return stats; }
+
+private:
+  boost::asio::awaitable<void> run();
+
+  static clock_type::duration lifetime(StateID sid) {
+    return (sid == sidPing) ? std::chrono::milliseconds(1000) : std::chrono::milliseconds(2000);
+  }
+
+  static StateID other(StateID sid) { return (sid == sidPing) ? sidPong : sidPing; }
+
+  static std::int64_t to_ns(clock_type::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+  }
+
+  // log entry or exit (asynchronously: see async_logger.h) and record it in the trace of this thread, if any
+  void record(LogRecord::Kind kind, StateID sid, std::uint8_t event) const {
+    static const std::array<std::uint16_t, NumStates> log_ids{{AsyncLogger::instance().register_state("statePing"),
+                                                               AsyncLogger::instance().register_state("statePong")}};
+    const std::uint64_t now = static_cast<std::uint64_t>(to_ns(clock_type::now()));
+    if (TraceRecorder *trace = TraceRecorder::current())
+      trace->record(now, kind, log_ids[sid], event, instance);
+    AsyncLogger::instance().log(kind, log_ids[sid], event, instance, now);
+  }
+
+  void change_to(StateID next, std::uint8_t event) {
+    record(LogRecord::exit, state, event);
+    state = next;
+    record(LogRecord::entry, state, event);
+  }
+
+  bool mailbox_empty() const { return head == mailbox.size(); }
+
+  EventID pop() {
+    const EventID eid = mailbox[head++];
+    if (head == mailbox.size()) {  // (keeps its capacity: no allocation once it has grown)
+      mailbox.clear();
+      head = 0;
+    }
+    return eid;
+  }
+
+  boost::asio::steady_timer timer;
+  std::vector<EventID> mailbox;       // events not yet handled by the coroutine (from mailbox[head])
+  std::size_t head = 0;
+  StateID state = sidPing;
+  std::uint32_t instance;
+  TimerStats stats;
+};
+
+
+
+inline boost::asio::awaitable<void> StateMachine::run()
+{
+  bool timer_running = true;
+  clock_type::time_point deadline = clock_type::now() + lifetime(state);
+  stats.armed(to_ns(deadline));
+  record(LogRecord::entry, state, LogRecord::no_event);
+
+  for (;;) {
+    bool expired = false;
+    if (mailbox_empty()) {
+      boost::system::error_code err;
+      timer.expires_at(timer_running ? deadline : clock_type::time_point::max());
+      co_await timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, err));
+      expired = !err;
+    }
+
+    if (expired) {
+      /*
+        .           timeout
+        statePing -----------> statePong
+        statePong -----------> statePing
+
+        no drift: the next deadline is based on the one that passed, not on "now"
+      */
+      stats.fired(to_ns(deadline), to_ns(clock_type::now()));
+      change_to(other(state), eidTimeout);
+      deadline += lifetime(state);
+      stats.rearmed(std::chrono::duration_cast<std::chrono::nanoseconds>(lifetime(state)).count());
+      continue;
+    }
+    if (mailbox_empty())
+      continue;  // (woken for nothing)
+
+    const EventID eid = pop();
+    switch (eid) {
+    case eidI: change_to(sidPing, eid);      break;  // state -> statePing
+    case eidO: change_to(sidPong, eid);      break;  // state -> statePong
+    case eidX: change_to(other(state), eid); break;  // statePing <-> statePong
+    case eidT:                                       // toggle timer on/off (no transition)
+      timer_running = !timer_running;
+      break;
+    case eidQ:
+      record(LogRecord::exit, state, LogRecord::no_event);
+      co_return;
+    default:
+      continue;
+    }
+    if (timer_running) {
+      deadline = clock_type::now() + lifetime(state);  // entered a state (or timer switched on): a full lifetime
+      stats.armed(to_ns(deadline));
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,102 @@
+// check: heap allocations of a steady-state ping-pong loop (timers running)
+//
+// usage: bench_alloc [num_transitions]
+//
+// Counts every operator new of the state machine thread after a warmup: keyboard-like
+// transitions (each one cancels and re-arms a timer) plus real timeouts. Exits with 1 if
+// anything was allocated. (The logger's writer thread is not counted.)
+
+#include <iostream>
+#include <cstdlib>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+
+
+
+static std::atomic<long> num_allocations{0};
+static thread_local bool counting = false;
+
+// every form of operator new / delete: all allocations are counted, and freed by the matching free()
+static void *counted_alloc(std::size_t size, std::size_t alignment = 0) noexcept
+{
+  if (counting)
+    ++num_allocations;
+  if (size == 0)
+    size = 1;
+  if (alignment == 0)
+    return std::malloc(size);
+  return ::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static void *counted_alloc_or_throw(std::size_t size, std::size_t alignment = 0)
+{
+  if (void *p = counted_alloc(size, alignment))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void *operator new  (std::size_t size)                                   { return counted_alloc_or_throw(size); }
+void *operator new[](std::size_t size)                                   { return counted_alloc_or_throw(size); }
+void *operator new  (std::size_t size, const std::nothrow_t &) noexcept  { return counted_alloc(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept  { return counted_alloc(size); }
+void *operator new  (std::size_t size, std::align_val_t a)               { return counted_alloc_or_throw(size, static_cast<std::size_t>(a)); }
+void *operator new[](std::size_t size, std::align_val_t a)               { return counted_alloc_or_throw(size, static_cast<std::size_t>(a)); }
+void *operator new  (std::size_t size, std::align_val_t a, const std::nothrow_t &) noexcept { return counted_alloc(size, static_cast<std::size_t>(a)); }
+void *operator new[](std::size_t size, std::align_val_t a, const std::nothrow_t &) noexcept { return counted_alloc(size, static_cast<std::size_t>(a)); }
+
+void operator delete  (void *p) noexcept                                           { std::free(p); }
+void operator delete[](void *p) noexcept                                           { std::free(p); }
+void operator delete  (void *p, std::size_t) noexcept                              { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept                              { std::free(p); }
+void operator delete  (void *p, const std::nothrow_t &) noexcept                   { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept                   { std::free(p); }
+void operator delete  (void *p, std::align_val_t) noexcept                         { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept                         { std::free(p); }
+void operator delete  (void *p, std::size_t, std::align_val_t) noexcept            { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept            { std::free(p); }
+void operator delete  (void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { std::free(p); }
+
+
+static void transitions(StateMachine &sm, boost::asio::io_service &io_service, long n)
+{
+  for (long i = 0; i < n; ++i) {
+    sm.process_event((i % 3 == 0) ? TaggedEvent{eidI, {}} : TaggedEvent{eidX, {}});
+    io_service.poll(); // run the handlers of cancelled waits
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  const long n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+
+  AsyncLogger::instance().set_output(nullptr);
+  counting = true;
+
+  boost::asio::io_service io_service;
+  StateMachine sm{"StateMachine", io_service};
+  sm.start();
+
+  // warmup: asio's own per-thread caches etc.
+  transitions(sm, io_service, 1000);
+  io_service.run_for(std::chrono::milliseconds(1100));
+
+  const long before = num_allocations.load();
+  transitions(sm, io_service, n);
+  io_service.run_for(std::chrono::milliseconds(3100)); // ping (1000 ms) and pong (2000 ms) time out
+  const long after = num_allocations.load();
+
+  sm.stop();
+  io_service.poll();
+  counting = false;
+
+  std::cerr << n << " transitions + timeouts: " << after - before << " heap allocations after warmup\n";
+  return (after == before) ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+// benchmark: KeyClassifier (SSE2, 16 chars at a time) vs. one char at a time (tolower + switch, as Interface does)
+//
+// usage: bench_classifier [megabytes]
+//
+// Input: keyboard-like lines ("x\n", "i\n", ...) and, for comparison, text with few keys.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "descriptor_input.h"
+
+
+
+static std::uint64_t per_char(const std::string &input)
+{
+  std::uint64_t sum = 0;
+  for (char c : input) {
+    switch (std::tolower(static_cast<unsigned char>(c))) {
+    case 'i': sum += 1; break;
+    case 'o': sum += 2; break;
+    case 'x': sum += 3; break;
+    case 't': sum += 4; break;
+    case 'q': sum += 5; break;
+    }
+  }
+  return sum;
+}
+
+static std::uint64_t classifier(const KeyClassifier &kc, const std::string &input)
+{
+  std::uint64_t sum = 0;
+  kc.scan(input.data(), input.data() + input.size(), [&sum](std::uint8_t k) { sum += k + 1; return true; });
+  return sum;
+}
+
+template <typename F>
+static void measure(const char *name, const std::string &input, F f)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  const std::uint64_t sum = f(input);
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::cout << name << ": " << input.size() / secs / 1e6 << " MB/s (checksum " << sum << ")\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t mb = (argc > 1) ? std::atol(argv[1]) : 64;
+
+  std::string keys, text;
+  const char line_keys[] = "ioxxxIOX";
+  for (std::size_t i = 0; keys.size() < mb * 1000000; ++i) {
+    keys += line_keys[(i * 7) % 8];
+    keys += '\n';
+  }
+  const std::string sentence = "lorem ipsum dolor sit amet, consectetur adipiscing elit. 0123456789 ";
+  while (text.size() < mb * 1000000)
+    text += sentence;
+
+  const KeyClassifier kc{"ioxtq"};
+  for (const auto &in : {std::make_pair("keys", &keys), std::make_pair("text", &text)}) {
+    std::cout << in.first << '\n';
+    measure("  per char (tolower + switch)", *in.second, per_char);
+    measure("  KeyClassifier              ", *in.second, [&kc](const std::string &s) { return classifier(kc, s); });
+  }
+  return 0;
+}
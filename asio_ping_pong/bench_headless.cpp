@@ -0,0 +1,67 @@
+// headless benchmark (same synthetic keyboard stream for every realization; see headless_bench.h)
+//
+// usage: bench_headless [num_events] [num_instances]
+//
+// Timers are running (every transition re-arms one); after each event the io_service runs
+// its ready handlers once, as in the real program.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "headless_bench.h"
+
+
+
+static TaggedEvent to_event(char c)
+{
+  switch (c) {
+  case 'i': return TaggedEvent{eidI, {}};
+  case 'o': return TaggedEvent{eidO, {}};
+  default:  return TaggedEvent{eidX, {}};
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  const std::size_t k = (argc > 2) ? std::atol(argv[2]) : 10000;
+
+  AsyncLogger::instance().set_output(nullptr);
+  HeadlessBench bench{"asio"};
+
+  boost::asio::io_service io_service;
+  {
+    std::vector<std::unique_ptr<StateMachine>> instances;
+    bench.rss_per_instance(k, instances, [&]() {
+        std::unique_ptr<StateMachine> sm{new StateMachine{"StateMachine", io_service}};
+        sm->start();
+        return sm;
+      });
+    for (auto &sm : instances)
+      sm->stop();
+    io_service.poll();
+  }
+  io_service.restart();
+
+  StateMachine sm{"StateMachine", io_service};
+  sm.start();
+  const auto deliver = [&](char c) {
+    sm.process_event(to_event(c));
+    io_service.poll();
+  };
+  bench.throughput(n / 10, deliver); // warmup
+  bench.throughput(n, deliver);
+  bench.latency(n, deliver);
+  sm.stop();
+  io_service.poll();
+
+  bench.report(std::cout);
+  return 0;
+}
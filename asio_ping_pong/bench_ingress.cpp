@@ -0,0 +1,141 @@
+// benchmark: producer-to-transition latency of the event ingress
+//   io_service.post(std::bind(&StateMachine::process_event, ...))   (one handler per event)
+// versus
+//   EventIngress (lock-free MPSC ring, drained in batches)
+//
+// usage: bench_ingress [num_events] [pace_us]
+//
+// paced : the producer sends one event every pace_us microseconds -> latency percentiles
+// burst : the producer sends all events as fast as it can        -> throughput
+
+#include <iostream>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <experimental/optional>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "event_ingress.h"
+
+
+
+using clock_type = std::chrono::steady_clock;
+
+struct StampedEvent {
+  EventID eid;
+  clock_type::time_point sent;
+};
+
+struct Result {
+  std::vector<long> latency_ns;
+  double secs;
+};
+
+// consumer side: one transition, then take the time
+struct Sink {
+  Sink(StateMachine &sm_, std::size_t n) : sm(sm_) { latency_ns.reserve(n); }
+
+  void deliver(const StampedEvent &e) {
+    sm.process_event(EventX{});
+    latency_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - e.sent).count());
+  }
+
+  StateMachine &sm;
+  std::vector<long> latency_ns;
+};
+
+
+template <typename Send>
+static void produce(std::size_t n, std::chrono::microseconds pace, Send send)
+{
+  auto next = clock_type::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    if (pace.count() > 0) {
+      next += pace;
+      while (clock_type::now() < next)
+        std::this_thread::yield();
+    }
+    send(StampedEvent{eidX, clock_type::now()});
+  }
+}
+
+static Result run_post(std::size_t n, std::chrono::microseconds pace)
+{
+  boost::asio::io_service io_service;
+  std::experimental::optional<boost::asio::io_service::work> work(std::experimental::in_place, io_service);
+  StateMachine sm{"StateMachine", io_service};
+  sm.process_event(EventT{}); // timers off
+  Sink sink{sm, n};
+
+  const auto t0 = clock_type::now();
+  std::thread producer([&]() {
+      produce(n, pace, [&](const StampedEvent &e) { io_service.post(std::bind(&Sink::deliver, &sink, e)); });
+      io_service.post([&]() { work = std::experimental::nullopt; });
+    });
+  io_service.run();
+  producer.join();
+  return Result{std::move(sink.latency_ns), std::chrono::duration<double>(clock_type::now() - t0).count()};
+}
+
+static Result run_ring(std::size_t n, std::chrono::microseconds pace)
+{
+  boost::asio::io_service io_service;
+  std::experimental::optional<boost::asio::io_service::work> work(std::experimental::in_place, io_service);
+  StateMachine sm{"StateMachine", io_service};
+  sm.process_event(EventT{}); // timers off
+  Sink sink{sm, n};
+
+  EventIngress<StampedEvent> ingress{io_service, [&](const StampedEvent &e) {
+      sink.deliver(e);
+      if (sink.latency_ns.size() == n)
+        work = std::experimental::nullopt;
+    }};
+
+  const auto t0 = clock_type::now();
+  std::thread producer([&]() { produce(n, pace, [&](const StampedEvent &e) { ingress.post(e); }); });
+  io_service.run();
+  producer.join();
+  return Result{std::move(sink.latency_ns), std::chrono::duration<double>(clock_type::now() - t0).count()};
+}
+
+
+static void report(const char *name, Result r, bool paced)
+{
+  std::sort(r.latency_ns.begin(), r.latency_ns.end());
+  const auto pct = [&](double p) { return r.latency_ns[static_cast<std::size_t>(p * (r.latency_ns.size() - 1))]; };
+  std::cerr << name;
+  if (paced)
+    std::cerr << "latency ns: p50 " << pct(0.5) << ", p99 " << pct(0.99) << ", p99.9 " << pct(0.999) << ", max " << r.latency_ns.back() << "\n";
+  else
+    std::cerr << static_cast<long>(r.latency_ns.size() / r.secs) << " events/sec\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 200000;
+  const std::chrono::microseconds pace{(argc > 2) ? std::atol(argv[2]) : 10};
+
+  AsyncLogger::instance().set_output(nullptr); // no "Entering: / Leaving :"
+
+  Result post_paced  = run_post(n, pace);
+  Result ring_paced  = run_ring(n, pace);
+  Result post_burst  = run_post(n, std::chrono::microseconds(0));
+  Result ring_burst  = run_ring(n, std::chrono::microseconds(0));
+
+  std::cerr << n << " events, paced every " << pace.count() << " us\n";
+  report("  post(std::bind) paced : ", std::move(post_paced), true);
+  report("  EventIngress    paced : ", std::move(ring_paced), true);
+  std::cerr << n << " events, burst\n";
+  report("  post(std::bind) burst : ", std::move(post_burst), false);
+  report("  EventIngress    burst : ", std::move(ring_burst), false);
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+// benchmark: latency of a transition with entry/exit logging on
+//   synchronous : std::cout << "Entering: " << name << std::endl   (as StateBase used to do)
+// versus
+//   AsyncLogger : binary record into a per-thread ring, formatted and written by a background thread
+//
+// usage: bench_logging [num_transitions] [pace_us]
+//
+// Both write to /dev/null (a real file: every std::endl is a write() system call).
+// One transition every pace_us microseconds, so that the logger's writer thread keeps up.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+
+
+
+using clock_type = std::chrono::steady_clock;
+
+template <typename Transition>
+static std::vector<long> run(long n, std::chrono::microseconds pace, Transition transition)
+{
+  std::vector<long> latency_ns;
+  latency_ns.reserve(n);
+  auto next = clock_type::now();
+  for (long i = 0; i < n; ++i) {
+    next += pace;
+    while (clock_type::now() < next)
+      std::this_thread::yield();
+    const auto t0 = clock_type::now();
+    transition();
+    latency_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t0).count());
+  }
+  return latency_ns;
+}
+
+static void report(const char *name, std::vector<long> latency_ns)
+{
+  std::sort(latency_ns.begin(), latency_ns.end());
+  const auto pct = [&](double p) { return latency_ns[static_cast<std::size_t>(p * (latency_ns.size() - 1))]; };
+  std::cerr << name << "latency ns: p50 " << pct(0.5) << ", p99 " << pct(0.99) << ", p99.9 " << pct(0.999)
+            << ", max " << latency_ns.back() << "\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const long n = (argc > 1) ? std::atol(argv[1]) : 200000;
+  const std::chrono::microseconds pace{(argc > 2) ? std::atol(argv[2]) : 5};
+
+  std::ofstream devnull{"/dev/null"};
+  boost::asio::io_service io_service;
+  StateMachine sm{"StateMachine", io_service};
+  sm.process_event(EventT{}); // timers off: we measure the logging
+
+  // synchronous: the logger is silent, the transition writes its two lines itself
+  AsyncLogger::instance().set_output(nullptr);
+  bool ping = true;
+  std::vector<long> sync = run(n, pace, [&]() {
+      sm.process_event(EventX{});
+      devnull << "Leaving : " << (ping ? "statePing" : "statePong") << std::endl;
+      devnull << "Entering: " << (ping ? "statePong" : "statePing") << std::endl;
+      ping = !ping;
+    });
+
+  // asynchronous
+  AsyncLogger::instance().set_output(&devnull);
+  const auto dropped = AsyncLogger::instance().dropped_records();
+  std::vector<long> async = run(n, pace, [&]() { sm.process_event(EventX{}); });
+  AsyncLogger::instance().set_output(nullptr);
+
+  std::cerr << n << " transitions, one every " << pace.count() << " us\n";
+  report("  synchronous std::endl : ", std::move(sync));
+  report("  AsyncLogger           : ", std::move(async));
+  std::cerr << "  records dropped: " << AsyncLogger::instance().dropped_records() - dropped << "\n";
+
+  return 0;
+}
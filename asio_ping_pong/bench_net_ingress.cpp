@@ -0,0 +1,171 @@
+// benchmark: events over loopback into the machine (NetIngress, see net_ingress.h)
+//
+// usage: bench_net_ingress [num_events] [pace_us]
+//
+// A producer thread sends frames with NetSender to a NetIngress on 127.0.0.1; the machine
+// (StateMachine, timers off) takes every read as one batch (process_events()).
+//
+// paced : one event per frame every pace_us microseconds -> latency send-to-transition percentiles
+// burst : frames of 1 or 64 events as fast as the sender can -> events/sec, reads (system calls
+//         on the receiving side), events per read, lost datagrams
+//
+// UDP with recvmmsg() of 64 datagrams against 1 (one datagram per wakeup, as a plain recv() loop), and TCP.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <experimental/optional>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "net_ingress.h"
+
+
+
+using clock_type = std::chrono::steady_clock;
+
+static std::int64_t now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+struct Result {
+  std::vector<long> latency_ns;
+  std::size_t   received;
+  std::uint64_t reads;
+  double secs;
+};
+
+struct Config {
+  const char *name;
+  NetProtocol protocol;
+  std::size_t slots;             // datagrams per recvmmsg()
+};
+
+static Result run(const Config &config, std::size_t n, std::size_t per_frame, std::chrono::microseconds pace)
+{
+  boost::asio::io_service io_service;
+  std::experimental::optional<boost::asio::io_service::work> work(std::experimental::in_place, io_service);
+  StateMachine sm{"StateMachine", io_service};
+  sm.process_event(EventT{}); // timers off
+
+  Result result{{}, 0, 0, 0};
+  clock_type::time_point last;  // batch (runs with lost datagrams end with 200 ms of nothing)
+  result.latency_ns.reserve(n);
+  const bool stamped = pace.count() > 0;
+  const TaggedEvent events[] = {{eidI, {}}, {eidO, {}}, {eidX, {}}, {eidT, {}}, {eidQ, {}}};
+  std::unique_ptr<NetIngress<TaggedEvent>> ingress;
+  ingress.reset(new NetIngress<TaggedEvent>{io_service, config.protocol, 0, events, [&](Span<const TaggedEvent> batch) {
+      sm.process_events(batch);
+      if (stamped) {
+        const std::int64_t now = now_ns();
+        for (std::int64_t sent : ingress->stamps())
+          result.latency_ns.push_back(static_cast<long>(now - sent));
+      }
+      result.received += batch.size();
+      last = clock_type::now();
+      if (result.received == n) {
+        ingress->cancel();
+        work = std::experimental::nullopt;
+      }
+    }, config.slots});
+
+  // end of a run with lost datagrams: the producer is done and nothing came for 200 ms
+  bool producer_done = false; // (set on the io_service's thread)
+  std::size_t last_received = 0;
+  boost::asio::steady_timer idle{io_service};
+  std::function<void(const boost::system::error_code &)> check_idle = [&](const boost::system::error_code &err) {
+      if (err || !work)
+        return;
+      if (producer_done && result.received == last_received) {
+        ingress->cancel();
+        work = std::experimental::nullopt;
+        return;
+      }
+      last_received = result.received;
+      idle.expires_after(std::chrono::milliseconds(200));
+      idle.async_wait(check_idle);
+    };
+  idle.expires_after(std::chrono::milliseconds(200));
+  idle.async_wait(check_idle);
+
+  std::vector<std::uint8_t> eids(n, eidX);
+  const unsigned short port = ingress->port();
+  const auto t0 = clock_type::now();
+  std::thread producer([&]() {
+      NetSender sender{config.protocol, port, per_frame};
+      if (!stamped)
+        sender.send(eids.data(), nullptr, n);
+      else {
+        auto next = clock_type::now();
+        for (std::size_t i = 0; i < n; ++i) {
+          next += pace;
+          while (clock_type::now() < next)
+            std::this_thread::yield();
+          const std::int64_t sent = now_ns();
+          sender.send(&eids[i], &sent, 1);
+        }
+      }
+      boost::asio::post(io_service, [&]() { producer_done = true; });
+    });
+  io_service.run();
+  result.secs = std::chrono::duration<double>(last - t0).count();
+  producer.join();
+  idle.cancel();
+  result.reads = ingress->reads();
+  return result;
+}
+
+
+static void report(const Config &config, Result r, std::size_t n, bool paced)
+{
+  std::cerr << "  " << config.name << ": ";
+  if (paced && !r.latency_ns.empty()) {
+    std::sort(r.latency_ns.begin(), r.latency_ns.end());
+    const auto pct = [&](double p) { return r.latency_ns[static_cast<std::size_t>(p * (r.latency_ns.size() - 1))]; };
+    std::cerr << "latency ns: p50 " << pct(0.5) << ", p99 " << pct(0.99) << ", p99.9 " << pct(0.999) << ", max " << r.latency_ns.back();
+  }
+  else
+    std::cerr << static_cast<long>(r.received / r.secs) << " events/sec";
+  std::cerr << "  (" << r.reads << " reads, " << (r.reads ? r.received / static_cast<double>(r.reads) : 0) << " events/read";
+  if (r.received < n)
+    std::cerr << ", " << n - r.received << " lost";
+  std::cerr << ")\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  const std::chrono::microseconds pace{(argc > 2) ? std::atol(argv[2]) : 20};
+
+  AsyncLogger::instance().set_output(nullptr); // no "Entering: / Leaving :"
+
+  const Config configs[] = {
+    {"UDP recvmmsg 64", NetProtocol::udp, 64},
+    {"UDP recvmmsg 1 ", NetProtocol::udp, 1},
+    {"TCP            ", NetProtocol::tcp, 64},
+  };
+
+  const std::size_t num_paced = std::min<std::size_t>(n, 100000);
+  std::cerr << num_paced << " events, one per frame, paced every " << pace.count() << " us\n";
+  for (const Config &config : configs)
+    report(config, run(config, num_paced, 1, pace), num_paced, true);
+
+  for (std::size_t per_frame : {std::size_t{1}, std::size_t{64}}) {
+    std::cerr << n << " events, " << per_frame << " per frame, burst\n";
+    for (const Config &config : configs)
+      report(config, run(config, n, per_frame, std::chrono::microseconds(0)), n, false);
+  }
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+// benchmark: InstancePool (structure-of-arrays) with many ping-pong machines
+// reports bytes/instance and events/sec for single and batched processing
+//
+// usage: bench_pool [num_instances] [num_events]
+
+#include <iostream>
+#include <cstdlib>
+
+#include <algorithm>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "instance_pool.h"
+
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t num_instances = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  const std::size_t num_events    = (argc > 2) ? std::atol(argv[2]) : 20000000;
+
+  using clock = std::chrono::steady_clock;
+
+  InstancePool pool{num_instances};
+  pool.start();
+
+  // synthetic event stream: random instance, random event (no quit)
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<InstancePool::InstanceID> pick_id(0, num_instances - 1);
+  std::uniform_int_distribution<int>                      pick_eid(eidI, eidT);
+  std::vector<InstancePool::InstanceID> ids(num_events);
+  std::vector<EventID>                  eids(num_events);
+  for (std::size_t i = 0; i < num_events; ++i) {
+    ids[i]  = pick_id(rng);
+    eids[i] = static_cast<EventID>(pick_eid(rng));
+  }
+
+  std::cerr << "instances:              " << num_instances << "\n"
+            << "bytes/instance (pool):  " << InstancePool::bytes_per_instance() << "\n"
+            << "bytes/instance (StateMachine object, without timer-queue ops): " << sizeof(StateMachine) << "\n";
+
+  // one event at a time
+  auto t0 = clock::now();
+  for (std::size_t i = 0; i < num_events; ++i)
+    pool.process_event(ids[i], eids[i]);
+  auto t1 = clock::now();
+  double secs = std::chrono::duration<double>(t1 - t0).count();
+  std::cerr << "process_event  : " << static_cast<long>(num_events / secs) << " events/sec\n";
+
+  // batches of 256
+  const std::size_t batch = 256;
+  t0 = clock::now();
+  for (std::size_t i = 0; i < num_events; i += batch)
+    pool.process_events(&ids[i], &eids[i], std::min(batch, num_events - i));
+  t1 = clock::now();
+  secs = std::chrono::duration<double>(t1 - t0).count();
+  std::cerr << "process_events : " << static_cast<long>(num_events / secs) << " events/sec (batch " << batch << ")\n";
+
+  // sweep of expired lifetimes (every running timer has expired 10 s from now)
+  t0 = clock::now();
+  const std::size_t expired = pool.process_expired(clock::now() + std::chrono::seconds(10));
+  t1 = clock::now();
+  secs = std::chrono::duration<double>(t1 - t0).count();
+  std::cerr << "process_expired: " << expired << " timeouts, " << static_cast<long>(expired / secs) << " timeouts/sec\n";
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+// timed rings of 2 to 64 phases (see ring_config.h, timed_ring.h, instance_pool.h)
+//
+// usage: bench_ring [hours] [num_instances]
+//
+// 1) memory per machine against the number of phases: TimedRing (one timer) and InstancePool
+//    stay the same; one StateTime per phase (as StateMachine does it) grows with every phase
+// 2) virtual time: 16 rings of N phases with random lifetimes (100 ms .. 2 s), run for hours:
+//    every ring must see exactly the timeouts its schedule has, each exactly on time
+// 3) InstancePool with num_instances spread over tenants of 3 .. 64 phases: events/sec
+//
+// exit code 1 if a check fails
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "timed_ring.h"
+#include "instance_pool.h"
+
+
+
+static const std::size_t phase_counts[] = {2, 3, 8, 16, 64};
+
+
+// num_rings rings of num_phases phases, lifetimes 100 ms .. 2 s
+static RingConfig make_config(std::size_t num_rings, std::size_t num_phases, std::mt19937 &rng)
+{
+  std::uniform_int_distribution<int> pick_ms(100, 2000);
+  RingConfig config;
+  for (std::size_t r = 0; r < num_rings; ++r) {
+    config.add_ring("tenant" + std::to_string(r));
+    for (std::size_t p = 0; p < num_phases; ++p)
+      config.add_phase("phase" + std::to_string(p), std::chrono::milliseconds(pick_ms(rng)));
+  }
+  return config;
+}
+
+
+// timeouts of ring r within d (timer running from phase 0 at time 0)
+static std::uint64_t expected_timeouts(const RingConfig &config, std::size_t r, std::chrono::nanoseconds d)
+{
+  std::uint64_t n = 0;
+  std::chrono::nanoseconds t{0};
+  for (std::size_t p = 0; (t += config.lifetime(r, p)) <= d; p = (p + 1) % config.num_phases(r))
+    ++n;
+  return n;
+}
+
+
+static bool simulate(std::size_t num_phases, std::chrono::hours hours)
+{
+  std::mt19937 rng{static_cast<unsigned>(num_phases)};
+  const std::size_t num_rings = 16;
+  const RingConfig config = make_config(num_rings, num_phases, rng);
+  const RingPhases phases{config};
+
+  VirtualTime::enable();
+  boost::asio::io_service io_service;
+  TimerStats stats;
+  std::vector<std::unique_ptr<TimedRing>> rings;
+  for (std::size_t r = 0; r < num_rings; ++r) {
+    rings.emplace_back(new TimedRing{io_service, phases, static_cast<std::uint16_t>(r), static_cast<std::uint32_t>(r)});
+    rings.back()->set_timer_stats(&stats);
+    rings.back()->start();
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  VirtualTime::instance().run_for(io_service, hours);
+  const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  for (auto &ring : rings)
+    ring->stop();
+  io_service.poll();
+
+  std::uint64_t expected = 0;
+  for (std::size_t r = 0; r < num_rings; ++r)
+    expected += expected_timeouts(config, r, hours);
+  const bool ok = stats.lateness_ns().count() == expected && stats.lateness_ns().max() == 0;
+  std::cout << "virtual " << num_phases << " phases: " << num_rings << " rings, " << hours.count() << " h in " << wall << " s wall, "
+            << stats.lateness_ns().count() << " timeouts (expected " << expected << "), max lateness "
+            << stats.lateness_ns().max() << " ns" << (ok ? "" : "  FAIL") << '\n';
+  return ok;
+}
+
+
+static void pool(std::size_t num_instances)
+{
+  std::mt19937 rng{42};
+  RingConfig config;
+  for (std::size_t r = 0; r < 62; ++r) {            // tenants of 3 .. 64 phases
+    config.add_ring("tenant" + std::to_string(r));
+    for (std::size_t p = 0; p < r + 3; ++p)
+      config.add_phase("phase" + std::to_string(p), std::chrono::milliseconds(100 + rng() % 1900));
+  }
+
+  InstancePool pool{num_instances, config};
+  for (InstancePool::InstanceID id = 0; id < num_instances; ++id)
+    pool.set_ring(id, static_cast<std::uint16_t>(id % config.num_rings()));
+  pool.start();
+
+  const std::size_t num_events = 20000000;
+  std::vector<InstancePool::InstanceID> ids(num_events);
+  std::vector<EventID>                  eids(num_events);
+  for (std::size_t i = 0; i < num_events; ++i) {
+    ids[i]  = static_cast<InstancePool::InstanceID>(rng() % num_instances);
+    eids[i] = static_cast<EventID>(eidI + rng() % 4);
+  }
+  const auto t0 = std::chrono::steady_clock::now();
+  pool.process_events(ids.data(), eids.data(), num_events);
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  std::cout << "InstancePool: " << num_instances << " instances in " << config.num_rings() << " rings of 3 .. 64 phases ("
+            << config.lifetimes_ns().size() << " phases in all), " << InstancePool::bytes_per_instance() << " bytes/instance, "
+            << static_cast<long>(num_events / secs) << " events/sec\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::chrono::hours hours{(argc > 1) ? std::atol(argv[1]) : 1};
+  const std::size_t num_instances = (argc > 2) ? std::atol(argv[2]) : 1000000;
+  AsyncLogger::instance().set_output(nullptr);
+
+  for (std::size_t n : phase_counts)
+    std::cout << "memory  " << n << " phases: TimedRing " << sizeof(TimedRing) << " bytes, InstancePool "
+              << InstancePool::bytes_per_instance() << " bytes, one StateTime (and timer) per phase " << n * sizeof(StateTime)
+              << " bytes\n";
+
+  bool ok = true;
+  for (std::size_t n : phase_counts)
+    ok = simulate(n, hours) && ok;
+
+  pool(num_instances);
+
+  AsyncLogger::instance().flush();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// benchmark: scaling of ShardedRuntime with the number of shards (one pinned thread each)
+//
+// usage: bench_shards [max_shards] [num_instances] [num_events]
+//
+// One producer thread per shard generates a synthetic event stream for random instances (of
+// all shards) and hands every event to ShardedRuntime::post(), which routes it to the owning
+// shard. Every window of events a producer posts a fence to each shard and waits for the
+// fences of its previous window, so no more than two windows per producer are queued.
+// Reported: events/sec (posted and processed) and speedup over 1 shard.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "sharded_runtime.h"
+
+
+
+static const char usage[] = "usage: bench_shards [max_shards] [num_instances] [num_events]\n";
+
+static const std::size_t window = 65536;
+
+static double run(std::size_t num_shards, std::size_t num_instances, std::size_t num_events)
+{
+  ShardedRuntime runtime{num_shards, num_instances};
+  runtime.start();
+
+  const std::size_t per_producer = num_events / num_shards;
+  const auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (std::size_t p = 0; p < num_shards; ++p)
+    producers.emplace_back([&runtime, num_shards, num_instances, per_producer, p]() {
+        std::atomic<std::size_t> fences_done{0};
+        std::size_t fences_posted = 0;
+        std::uint64_t x = p + 1;
+        for (std::size_t i = 0; i < per_producer; ++i) {
+          x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+          runtime.post(static_cast<ShardedRuntime::InstanceID>((x >> 33) % num_instances),
+                       static_cast<EventID>((x >> 20) & 3));
+          if ((i + 1) % window == 0) {
+            for (std::size_t s = 0; s < num_shards; ++s)
+              runtime.post_to_shard(s, [&fences_done](ShardedRuntime::Shard &) { fences_done.fetch_add(1, std::memory_order_release); });
+            fences_posted += num_shards;
+            while (fences_done.load(std::memory_order_acquire) + num_shards < fences_posted) // (the previous window is through)
+              std::this_thread::yield();
+          }
+        }
+        while (fences_done.load(std::memory_order_acquire) < fences_posted) // (fences_done lives on this stack)
+          std::this_thread::yield();
+      });
+  for (std::thread &producer : producers)
+    producer.join();
+  runtime.stop(); // (the shards finish their queued events)
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  return (per_producer * num_shards) / secs;
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t max_shards    = (argc > 1) ? std::atol(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t num_instances = (argc > 2) ? std::atol(argv[2]) : 1000000;
+  const std::size_t num_events    = (argc > 3) ? std::atol(argv[3]) : 10000000;
+  if (max_shards == 0 || num_instances == 0) {
+    std::cerr << usage;
+    return 1;
+  }
+
+  std::cerr << "cores: " << std::thread::hardware_concurrency() << ", instances: " << num_instances
+            << ", events: " << num_events << "\n";
+
+  std::vector<std::size_t> shard_counts;
+  for (std::size_t shards = 1; shards < max_shards; shards *= 2)
+    shard_counts.push_back(shards);
+  shard_counts.push_back(max_shards);
+
+  double base = 0;
+  for (std::size_t shards : shard_counts) {
+    const double rate = run(shards, num_instances, num_events);
+    if (shards == 1)
+      base = rate;
+    std::cerr << "shards " << shards << ": " << static_cast<long>(rate) << " events/sec, speedup " << rate / base << "x\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+// benchmark: events from another process into the machine, shared memory ring against UDP
+//
+// usage: bench_shm_ingress [num_events] [pace_us]
+//
+// The producer is a second process (this program again, started with --producer): it pushes
+// stamped events into the ShmEventRing of a ShmIngress (see shm_ingress.h) or sends them to a
+// NetIngress over UDP (see net_ingress.h, one event per datagram). The machine (StateMachine,
+// timers off) takes every batch with process_events().
+//
+// paced : one event every pace_us microseconds -> latency send-to-transition percentiles
+// burst : as fast as the producer can                -> events/sec
+//
+// shm spin 0      the consumer sleeps on the futex whenever the ring is empty (a wakeup per event when paced)
+// shm spin 200 us the consumer polls the ring for 200 us before it sleeps (no system call per event)
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <experimental/optional>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "net_ingress.h"
+#include "shm_ingress.h"
+
+
+
+using clock_type = std::chrono::steady_clock;
+
+static std::int64_t now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+
+// the producer process: bench_shm_ingress --producer shm:NAME|udp:PORT num_events pace_us
+static int producer(const char *endpoint, std::size_t n, std::chrono::microseconds pace)
+{
+  std::unique_ptr<ShmEventRing> ring;
+  std::unique_ptr<NetSender>    sender;
+  NetProtocol protocol;
+  unsigned short port;
+  if (!std::strncmp(endpoint, "shm:", 4))
+    ring.reset(new ShmEventRing{ShmEventRing::attach(endpoint + 4)});
+  else if (parse_net_endpoint(endpoint, protocol, port))
+    sender.reset(new NetSender{protocol, port, 1});
+  else
+    return 1;
+
+  auto next = clock_type::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    if (pace.count() > 0) {
+      next += pace;
+      while (clock_type::now() < next)
+        std::this_thread::yield();
+    }
+    const ShmEventRecord record{now_ns(), eidX};
+    if (ring)
+      ring->push(record);
+    else
+      sender->send(&record.eid, &record.sent_ns, 1);
+  }
+  return 0;
+}
+
+
+struct Result {
+  std::vector<long> latency_ns;
+  std::size_t received;
+  double secs;
+};
+
+template <typename Ingress>
+struct Consumer {
+  Consumer(std::size_t n_) : n{n_} {
+    result.latency_ns.reserve(n);
+    sm.process_event(EventT{}); // timers off
+  }
+
+  void deliver(Span<const TaggedEvent> batch) {
+    sm.process_events(batch);
+    const std::int64_t now = now_ns();
+    for (std::int64_t sent : ingress->stamps())
+      result.latency_ns.push_back(static_cast<long>(now - sent));
+    result.received += batch.size();
+    last = clock_type::now();
+    if (result.received == n)
+      done();
+  }
+
+  void done() {
+    ingress->cancel();
+    work = std::experimental::nullopt;
+  }
+
+  boost::asio::io_service io_service;
+  std::experimental::optional<boost::asio::io_service::work> work{std::experimental::in_place, io_service};
+  StateMachine sm{"StateMachine", io_service};
+  std::unique_ptr<Ingress> ingress;
+  std::size_t n;
+  Result result{{}, 0, 0};
+  clock_type::time_point last;
+};
+
+static const TaggedEvent events[] = {{eidI, {}}, {eidO, {}}, {eidX, {}}, {eidT, {}}, {eidQ, {}}};
+
+
+// starts the producer process, runs the consumer till all events are in (or, with lost
+// datagrams, the producer has exited and nothing came for 200 ms)
+template <typename Ingress>
+static Result run(Consumer<Ingress> &consumer, const char *self, const std::string &endpoint, std::size_t n, std::chrono::microseconds pace)
+{
+  const std::string num = std::to_string(n), pace_us = std::to_string(pace.count());
+  const auto t0 = clock_type::now();
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    ::execl(self, self, "--producer", endpoint.c_str(), num.c_str(), pace_us.c_str(), static_cast<char *>(nullptr));
+    ::_exit(127);
+  }
+
+  bool exited = false;
+  std::size_t last_received = 0;
+  boost::asio::steady_timer idle{consumer.io_service};
+  std::function<void(const boost::system::error_code &)> check = [&](const boost::system::error_code &err) {
+      if (err || !consumer.work)
+        return;
+      exited = exited || ::waitpid(pid, nullptr, WNOHANG) == pid;
+      if (exited && consumer.result.received == last_received) {
+        consumer.done();
+        return;
+      }
+      last_received = consumer.result.received;
+      idle.expires_after(std::chrono::milliseconds(200));
+      idle.async_wait(check);
+    };
+  idle.expires_after(std::chrono::milliseconds(200));
+  idle.async_wait(check);
+
+  consumer.io_service.run();
+  if (!exited)
+    ::waitpid(pid, nullptr, 0);
+  consumer.result.secs = std::chrono::duration<double>(consumer.last - t0).count();
+  return std::move(consumer.result);
+}
+
+static Result run_shm(const char *self, std::size_t n, std::chrono::microseconds pace, std::chrono::microseconds spin)
+{
+  Consumer<ShmIngress<TaggedEvent>> consumer{n};
+  const std::string name = "/bench_shm_ingress." + std::to_string(::getpid());
+  consumer.ingress.reset(new ShmIngress<TaggedEvent>{consumer.io_service, name, events,
+                                                     [&](Span<const TaggedEvent> batch) { consumer.deliver(batch); }, spin});
+  return run(consumer, self, "shm:" + name, n, pace);
+}
+
+static Result run_udp(const char *self, std::size_t n, std::chrono::microseconds pace)
+{
+  Consumer<NetIngress<TaggedEvent>> consumer{n};
+  consumer.ingress.reset(new NetIngress<TaggedEvent>{consumer.io_service, NetProtocol::udp, 0, events,
+                                                     [&](Span<const TaggedEvent> batch) { consumer.deliver(batch); }});
+  return run(consumer, self, "udp:" + std::to_string(consumer.ingress->port()), n, pace);
+}
+
+
+static void report(const char *name, Result r, std::size_t n, bool paced)
+{
+  std::cerr << "  " << name << ": ";
+  if (paced && !r.latency_ns.empty()) {
+    std::sort(r.latency_ns.begin(), r.latency_ns.end());
+    const auto pct = [&](double p) { return r.latency_ns[static_cast<std::size_t>(p * (r.latency_ns.size() - 1))]; };
+    std::cerr << "latency ns: p50 " << pct(0.5) << ", p99 " << pct(0.99) << ", p99.9 " << pct(0.999) << ", max " << r.latency_ns.back();
+  }
+  else
+    std::cerr << static_cast<long>(r.received / r.secs) << " events/sec";
+  if (r.received < n)
+    std::cerr << "  (" << n - r.received << " lost)";
+  std::cerr << '\n';
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc == 5 && !std::strcmp(argv[1], "--producer"))
+    return producer(argv[2], std::atol(argv[3]), std::chrono::microseconds(std::atol(argv[4])));
+
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  const std::chrono::microseconds pace{(argc > 2) ? std::atol(argv[2]) : 20};
+  const std::chrono::microseconds spin{200};
+  const char *self = "/proc/self/exe";
+
+  AsyncLogger::instance().set_output(nullptr); // no "Entering: / Leaving :"
+
+  const std::size_t num_paced = std::min<std::size_t>(n, 100000);
+  std::cerr << num_paced << " events from another process, paced every " << pace.count() << " us\n";
+  report("shm spin 0     ", run_shm(self, num_paced, pace, std::chrono::microseconds(0)), num_paced, true);
+  report("shm spin 200 us", run_shm(self, num_paced, pace, spin), num_paced, true);
+  report("UDP            ", run_udp(self, num_paced, pace), num_paced, true);
+
+  std::cerr << n << " events from another process, burst\n";
+  report("shm spin 0     ", run_shm(self, n, std::chrono::microseconds(0), std::chrono::microseconds(0)), n, false);
+  report("shm spin 200 us", run_shm(self, n, std::chrono::microseconds(0), spin), n, false);
+  report("UDP            ", run_udp(self, n, std::chrono::microseconds(0)), n, false);
+
+  return 0;
+}
@@ -0,0 +1,196 @@
+// benchmark and check: snapshot / warm restart (see snapshot_file.h)
+//
+// usage: bench_snapshot [num_instances] [num_machines] [file]
+//
+// 1) InstancePool with num_instances: snapshot and restore time, every instance restored exactly
+// 2) num_machines StateMachine objects: snapshot, then construct + restore new ones
+// 3) zero drift across a restart (virtual time, see pluggable_clock.h): 10 h, snapshot, restore
+//    into a new machine, 10 h more -> the same timeouts as 20 h without restart, phase error 0
+//
+// exit code 1 if a check fails
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "instance_pool.h"
+#include "snapshot_file.h"
+
+
+
+using clock_type = std::chrono::steady_clock;
+
+static double ms_since(clock_type::time_point t0)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+}
+
+static bool same(const MachineSnapshot &a, const MachineSnapshot &b)
+{
+  return a.deadline_ns == b.deadline_ns && a.instance == b.instance && a.state == b.state && a.timer_running == b.timer_running;
+}
+
+
+static bool pool_snapshot(std::size_t n, const std::string &path)
+{
+  InstancePool pool{n};
+  pool.start();
+  std::mt19937 rng{42};
+  for (std::size_t i = 0; i < n; ++i)
+    pool.process_event(static_cast<InstancePool::InstanceID>(rng() % n), static_cast<EventID>(eidI + rng() % 4));
+
+  auto t0 = clock_type::now();
+  {
+    SnapshotWriter writer{path, pool.size()};
+    pool.snapshot(writer.records());
+    writer.commit();
+  }
+  const double write_ms = ms_since(t0);
+
+  t0 = clock_type::now();
+  SnapshotReader reader{path};
+  InstancePool restored{0};
+  restored.restore(reader.records(), reader.clock_offset_ns());
+  const double read_ms = ms_since(t0);
+
+  bool ok = (restored.size() == pool.size());
+  for (InstancePool::InstanceID id = 0; ok && id < pool.size(); ++id)
+    ok = restored.get_state(id) == pool.get_state(id) && restored.is_timer_running(id) == pool.is_timer_running(id) &&
+         restored.get_deadline(id) == pool.get_deadline(id);
+
+  const double mb = (snapshot_header_size + n * sizeof(MachineSnapshot)) / 1e6;
+  std::cout << "InstancePool  " << n << " instances, " << mb << " MB: snapshot " << write_ms << " ms, restore " << read_ms
+            << " ms (" << mb / read_ms * 1000 << " MB/s)" << (ok ? "" : "  FAIL: restored instances differ") << '\n';
+  return ok;
+}
+
+
+static bool machines_snapshot(std::size_t n, const std::string &path)
+{
+  boost::asio::io_service io_service;
+  std::vector<std::unique_ptr<StateMachine>> machines;
+  for (std::size_t i = 0; i < n; ++i) {
+    machines.emplace_back(new StateMachine{"StateMachine", io_service, static_cast<std::uint32_t>(i)});
+    machines.back()->start();
+    if (i % 3 == 1)
+      machines.back()->process_event(EventX{});
+    if (i % 5 == 2)
+      machines.back()->process_event(EventT{});
+  }
+
+  auto t0 = clock_type::now();
+  {
+    SnapshotWriter writer{path, n};
+    for (std::size_t i = 0; i < n; ++i)
+      writer.records()[i] = machines[i]->snapshot();
+    writer.commit();
+  }
+  const double write_ms = ms_since(t0);
+
+  t0 = clock_type::now();
+  SnapshotReader reader{path};
+  std::vector<std::unique_ptr<StateMachine>> restored;
+  for (const MachineSnapshot &snap : reader.records()) {
+    restored.emplace_back(new StateMachine{"StateMachine", io_service, snap.instance});
+    restored.back()->restore(snap, reader.clock_offset_ns());
+  }
+  const double read_ms = ms_since(t0);
+
+  bool ok = true;
+  for (std::size_t i = 0; ok && i < n; ++i)
+    ok = same(restored[i]->snapshot(), machines[i]->snapshot());
+
+  std::cout << "StateMachine  " << n << " machines: snapshot " << write_ms << " ms, construct + restore " << read_ms << " ms"
+            << (ok ? "" : "  FAIL: restored machines differ") << '\n';
+
+  for (auto &sm : machines)
+    sm->stop();
+  for (auto &sm : restored)
+    sm->stop();
+  io_service.poll();
+  return ok;
+}
+
+
+struct DriftResult {
+  std::uint64_t timeouts;
+  MachineSnapshot end;         // deadline_ns: relative to the start of the run
+  std::int64_t max_phase_ns;
+};
+
+// hours of virtual time; restart after hours_before (0: no restart)
+static DriftResult run_virtual(int hours, int hours_before, const std::string &path)
+{
+  const auto start = PluggableClock::now();
+  DriftResult r{0, {}, 0};
+
+  std::unique_ptr<boost::asio::io_service> io_service{new boost::asio::io_service};
+  std::unique_ptr<StateMachine> sm{new StateMachine{"StateMachine", *io_service}};
+  sm->start();
+  if (hours_before) {
+    VirtualTime::instance().run_until(*io_service, start + std::chrono::hours(hours_before) + std::chrono::milliseconds(500));
+    r.timeouts += sm->timer_stats().lateness_ns().count();
+    r.max_phase_ns = sm->timer_stats().max_phase_error_ns();
+    {
+      SnapshotWriter writer{path, 1};
+      writer.records()[0] = sm->snapshot();
+      writer.commit();
+    }
+    sm->stop();           // the old process is gone
+    io_service->poll();
+    sm.reset();
+    io_service.reset(new boost::asio::io_service);
+
+    SnapshotReader reader{path};
+    sm.reset(new StateMachine{"StateMachine", *io_service});
+    sm->restore(reader.records()[0], reader.clock_offset_ns());
+  }
+  VirtualTime::instance().run_until(*io_service, start + std::chrono::hours(hours));
+  r.timeouts += sm->timer_stats().lateness_ns().count();
+  r.end = sm->snapshot();
+  r.end.deadline_ns -= std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+  r.max_phase_ns = std::max(r.max_phase_ns, sm->timer_stats().max_phase_error_ns());
+  sm->stop();
+  io_service->poll();
+  return r;
+}
+
+static bool zero_drift(const std::string &path)
+{
+  VirtualTime::enable(PluggableClock::now());
+  const DriftResult straight  = run_virtual(20, 0, path);
+  const DriftResult restarted = run_virtual(20, 10, path);
+
+  const bool ok = straight.timeouts == restarted.timeouts && straight.end.state == restarted.end.state &&
+                  straight.end.deadline_ns == restarted.end.deadline_ns && restarted.max_phase_ns == 0;
+  std::cout << "zero drift    20 h: " << straight.timeouts << " timeouts; with a restart after 10 h: " << restarted.timeouts
+            << " timeouts, max phase error " << restarted.max_phase_ns << " ns" << (ok ? "" : "  FAIL") << '\n';
+  return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t num_instances = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  const std::size_t num_machines  = (argc > 2) ? std::atol(argv[2]) : 10000;
+  const std::string path          = (argc > 3) ? argv[3] : "bench_snapshot.snap";
+
+  AsyncLogger::instance().set_output(nullptr);
+
+  bool ok = pool_snapshot(num_instances, path);
+  ok = machines_snapshot(num_machines, path) && ok;
+  ok = zero_drift(path) && ok;
+
+  std::remove(path.c_str());
+  AsyncLogger::instance().flush();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// benchmark: arm / cancel / fire cost of TimingWheel versus one boost::asio::steady_timer per timer
+//
+// usage: bench_timing_wheel [num_timers ...]        (default: 10000 1000000 10000000)
+//
+// The asio variant is skipped above 1M timers (a steady_timer plus its wait-operation is
+// some 100s of bytes: 10M of them don't fit into a small machine).
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "timing_wheel.h"
+#include "instance_pool.h"
+
+
+
+using clock_type = std::chrono::steady_clock;
+
+static double secs_since(clock_type::time_point t0)
+{
+  return std::chrono::duration<double>(clock_type::now() - t0).count();
+}
+
+static void report(const char *what, std::size_t n, double secs)
+{
+  std::cerr << "  " << what << secs * 1e9 / n << " ns/op\n";
+}
+
+
+static void bench_wheel(const std::vector<std::chrono::microseconds> &offsets)
+{
+  const std::size_t n = offsets.size();
+  const auto origin = clock_type::now();
+  TimingWheel wheel{n, std::chrono::milliseconds(1), origin};
+
+  auto t0 = clock_type::now();
+  for (TimingWheel::TimerID id = 0; id < n; ++id)
+    wheel.arm(id, origin + offsets[id]);
+  report("TimingWheel arm   : ", n, secs_since(t0));
+
+  t0 = clock_type::now();
+  for (TimingWheel::TimerID id = 1; id < n; id += 2)
+    wheel.cancel(id);
+  report("TimingWheel cancel: ", n / 2, secs_since(t0));
+
+  std::size_t fired = 0;
+  t0 = clock_type::now();
+  wheel.advance(origin + std::chrono::seconds(3), [&](TimingWheel::TimerID, clock_type::time_point) { ++fired; });
+  report("TimingWheel fire  : ", fired, secs_since(t0));
+}
+
+
+static void bench_asio(const std::vector<std::chrono::microseconds> &offsets)
+{
+  const std::size_t n = offsets.size();
+  boost::asio::io_service io_service;
+  std::vector<std::unique_ptr<boost::asio::steady_timer>> timers;
+  timers.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    timers.emplace_back(new boost::asio::steady_timer{io_service});
+
+  std::size_t fired = 0;
+  auto handler = [&](const boost::system::error_code &err) { if (err == boost::system::errc::success) ++fired; };
+
+  const auto now = clock_type::now();
+  auto t0 = clock_type::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    timers[i]->expires_at(now + std::chrono::hours(1) + offsets[i]);
+    timers[i]->async_wait(handler);
+  }
+  report("steady_timer arm   : ", n, secs_since(t0));
+
+  t0 = clock_type::now();
+  for (std::size_t i = 1; i < n; i += 2)
+    timers[i]->cancel();
+  io_service.poll(); // cancelled handlers have to run, too
+  report("steady_timer cancel: ", n / 2, secs_since(t0));
+
+  for (std::size_t i = 0; i < n; i += 2)
+    timers[i]->cancel();
+  io_service.poll();
+  io_service.restart();
+
+  // fire: deadlines in the past, so that run() does not sleep
+  for (std::size_t i = 0; i < n; ++i) {
+    timers[i]->expires_at(now - offsets[i]);
+    timers[i]->async_wait(handler);
+  }
+  t0 = clock_type::now();
+  io_service.run();
+  report("steady_timer fire  : ", fired, secs_since(t0));
+}
+
+
+// zero drift: InstancePool driven by a TimingWheel, one hour of virtual time in steps of 7 ms
+static void check_drift()
+{
+  const std::size_t n = 1000;
+  const auto origin = clock_type::now();
+  TimingWheel  wheel{n, std::chrono::milliseconds(1), origin};
+  InstancePool pool{n, std::chrono::milliseconds(1000), std::chrono::milliseconds(2000), &wheel};
+  pool.start(origin);
+
+  auto fire = [&](TimingWheel::TimerID id, clock_type::time_point deadline) { pool.process_event(id, DEventTimeout{{deadline}}); };
+  const auto end = origin + std::chrono::hours(1);
+  for (auto t = origin; t < end; t += std::chrono::milliseconds(7))
+    wheel.advance(t, fire);
+
+  // every instance: ping 1000 ms + pong 2000 ms, so deadlines stay on the 1000 ms / 3000 ms grid
+  std::chrono::nanoseconds max_error{0};
+  for (InstancePool::InstanceID id = 0; id < n; ++id) {
+    const auto since = pool.get_deadline(id) - origin;
+    const auto phase = since % std::chrono::milliseconds(3000);
+    const auto error = (pool.get_state(id) == InstancePool::sidPong) ? phase - std::chrono::milliseconds(0)
+                                                                      : phase - std::chrono::milliseconds(1000);
+    max_error = std::max(max_error, std::chrono::duration_cast<std::chrono::nanoseconds>(error < error.zero() ? -error : error));
+  }
+  std::cerr << "drift after 1 h (virtual) of " << n << " machines: max " << max_error.count() << " ns\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::size_t> sizes;
+  for (int i = 1; i < argc; ++i)
+    sizes.push_back(std::atol(argv[i]));
+  if (sizes.empty())
+    sizes = {10000, 1000000, 10000000};
+
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<long> pick(1000, 2000000); // 1 ms .. 2000 ms (in us)
+
+  for (std::size_t n : sizes) {
+    std::vector<std::chrono::microseconds> offsets(n);
+    for (auto &o : offsets)
+      o = std::chrono::microseconds(pick(rng));
+
+    std::cerr << n << " pending timers:\n";
+    bench_wheel(offsets);
+    if (n <= 1000000)
+      bench_asio(offsets);
+  }
+
+  check_drift();
+
+  return 0;
+}
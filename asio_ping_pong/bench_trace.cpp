@@ -0,0 +1,70 @@
+// benchmark: cost of the always-on trace (TraceRecorder, see trace_recorder.h)
+//
+// usage: bench_trace [num_transitions] [trace_file]
+//
+// Transitions with and without a TraceRecorder on this thread (timers off, log silenced);
+// the difference is the cost of recording (one entry and one exit per transition). The file is
+// small (4 MiB), so the rolling limit is hit many times.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+
+
+
+static double run(StateMachine &sm, long n)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < n; ++i)
+    sm.process_event(EventX{});
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static double run_records(TraceRecorder &trace, long n)
+{
+  std::uint64_t now = AsyncLogger::now_ns();
+  const auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < n; ++i) {
+    now += 1000 + (i & 0xff);
+    trace.record(now, (i & 1) ? LogRecord::exit : LogRecord::entry, 1 + ((i >> 1) & 1), eidX, 0); // states 1 and 2 in turn
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+int main(int argc, char *argv[])
+{
+  const long n = (argc > 1) ? std::atol(argv[1]) : 10000000L;
+  const char *path = (argc > 2) ? argv[2] : "bench_trace.trace";
+
+  AsyncLogger::instance().set_output(nullptr);
+
+  boost::asio::io_service io_service;
+  StateMachine sm{"StateMachine", io_service};
+  sm.process_event(EventT{}); // timers off
+
+  TraceRecorder trace{path, 4 * 1024 * 1024};
+
+  run(sm, n / 10); // warmup
+  const double secs_plain = run(sm, n);
+
+  TraceRecorder::current() = &trace;
+  run(sm, n / 10);
+  const double secs_trace = run(sm, n);
+  TraceRecorder::current() = nullptr;
+
+  const double secs_records = run_records(trace, 2 * n);
+
+  std::cerr << n << " transitions\n"
+            << "  without trace : " << secs_plain * 1e9 / n << " ns/transition\n"
+            << "  with trace    : " << secs_trace * 1e9 / n << " ns/transition\n"
+            << "  -> recording  : " << (secs_trace - secs_plain) * 1e9 / n << " ns/transition\n"
+            << "  record() alone: " << secs_records * 1e9 / (2 * n) << " ns/record (timestamp given)\n";
+
+  return 0;
+}
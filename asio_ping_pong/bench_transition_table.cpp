@@ -0,0 +1,241 @@
+// microbenchmark: dispatch of one transition table, three ways
+//
+//   matrix       TransitionTable lowered to the [state][event] matrix (transition_table.h)
+//   hand-written switch on the event id + if-chains on the active state (StateMachine before)
+//   msm          the same table as a Boost.MSM functor-row transition_table
+//
+// The states only count their entries / exits, so we measure dispatch and not logging or
+// timers. Two event streams: EventX only (predictable) and a random mix of I, O, X, T and
+// timeouts (the branch predictor cannot learn it).
+//
+// usage: bench_transition_table [num_events]
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <boost/msm/back/state_machine.hpp>
+#include <boost/msm/front/state_machine_def.hpp>
+#include <boost/msm/front/functor_row.hpp>
+
+#include "statemachine.h"  // events
+#include "transition_table.h"
+
+namespace msm = boost::msm;
+
+
+
+struct CountingState {
+  template <typename Event, typename FSM> void on_entry(const Event &, FSM &) { ++entries; }
+  template <typename Event, typename FSM> void on_exit(const Event &, FSM &)  { ++exits; }
+  unsigned long entries = 0;
+  unsigned long exits   = 0;
+};
+
+struct Ping : CountingState {};
+struct Pong : CountingState {};
+
+
+/////////////////
+// TableMachine: the transition_table of StateMachine, on counting states
+/////////////////
+class TableMachine {
+public:
+  using States = std::tuple<Ping, Pong>;
+  using Events = std::tuple<EventI, EventO, EventX, EventT, EventQ, DEventTimeout>;
+  using Tagged = TaggedEvent;
+
+  struct Toggle {
+    void operator()(TableMachine &sm, const EventT &) const { sm.timer_running = !sm.timer_running; }
+  };
+
+  using transition_table = TransitionTable<
+    Row<AnyState, EventI,        Ping>,
+    Row<AnyState, EventO,        Pong>,
+    Row<Ping,     EventX,        Pong>,
+    Row<Pong,     EventX,        Ping>,
+    Row<Ping,     DEventTimeout, Pong>,
+    Row<Pong,     DEventTimeout, Ping>,
+    Row<AnyState, EventT,        NoTarget, Toggle>
+  >;
+
+  template <typename Event>
+  static Event untag(const TaggedEvent &event) {
+    if constexpr (std::is_same<Event, DEventTimeout>::value)
+      return DEventTimeout{event.data};
+    else
+      return Event{};
+  }
+
+  void process_event(const TaggedEvent &event) {
+    if (static_cast<std::size_t>(event.eid) < std::tuple_size<Events>::value)
+      transition_matrix<TableMachine>[current_state][event.eid].action(*this, event);
+  }
+
+  unsigned long transitions() const { return std::get<Ping>(states).entries + std::get<Pong>(states).entries; }
+
+private:
+  friend class TransitionMatrix<TableMachine>;
+
+  States states;
+  std::size_t current_state = 0;
+  bool timer_running = true;
+};
+
+
+/////////////////
+// HandWrittenMachine: the dispatch as it was before (switch, then if-chains)
+/////////////////
+class HandWrittenMachine {
+public:
+  void process_event(const TaggedEvent &event) {
+    switch (event.eid) {
+    case eidI:       change_to<Ping>(EventI{}); break;
+    case eidO:       change_to<Pong>(EventO{}); break;
+    case eidX:       if (current_state == 0) change_to<Pong>(EventX{}); else change_to<Ping>(EventX{}); break;
+    case eidTimeout: if (current_state == 0) change_to<Pong>(DEventTimeout{event.data}); else change_to<Ping>(DEventTimeout{event.data}); break;
+    case eidT:       timer_running = !timer_running; break;
+    default:         break;
+    }
+  }
+
+  unsigned long transitions() const { return ping.entries + pong.entries; }
+
+private:
+  template <typename State, typename Event>
+  void change_to(const Event &event) {
+    if (current_state == 0)
+      ping.on_exit(event, *this);
+    else
+      pong.on_exit(event, *this);
+    if (std::is_same<State, Ping>::value) {
+      current_state = 0;
+      ping.on_entry(event, *this);
+    } else {
+      current_state = 1;
+      pong.on_entry(event, *this);
+    }
+  }
+
+  Ping ping;
+  Pong pong;
+  std::size_t current_state = 0;
+  bool timer_running = true;
+};
+
+
+/////////////////
+// MSM: the same table (AnyState rows written out per state)
+/////////////////
+struct MsmPing : CountingState, msm::front::state<> {
+  using CountingState::on_entry;
+  using CountingState::on_exit;
+};
+struct MsmPong : CountingState, msm::front::state<> {
+  using CountingState::on_entry;
+  using CountingState::on_exit;
+};
+
+struct MsmFront : msm::front::state_machine_def<MsmFront> {
+  using initial_state = MsmPing;
+
+  struct Toggle {
+    template <typename Event, typename FSM, typename Source, typename Target>
+    void operator()(const Event &, FSM &fsm, Source &, Target &) { fsm.timer_running = !fsm.timer_running; }
+  };
+
+  using none = msm::front::none;
+  struct transition_table : boost::mpl::vector<
+    msm::front::Row<MsmPing, EventI,        MsmPing>,
+    msm::front::Row<MsmPong, EventI,        MsmPing>,
+    msm::front::Row<MsmPing, EventO,        MsmPong>,
+    msm::front::Row<MsmPong, EventO,        MsmPong>,
+    msm::front::Row<MsmPing, EventX,        MsmPong>,
+    msm::front::Row<MsmPong, EventX,        MsmPing>,
+    msm::front::Row<MsmPing, DEventTimeout, MsmPong>,
+    msm::front::Row<MsmPong, DEventTimeout, MsmPing>,
+    msm::front::Row<MsmPing, EventT,        none,    Toggle>,
+    msm::front::Row<MsmPong, EventT,        none,    Toggle>
+  > {};
+
+  bool timer_running = true;
+};
+
+using MsmMachine = msm::back::state_machine<MsmFront>;
+
+static void msm_process_event(MsmMachine &sm, const TaggedEvent &event)
+{
+  switch (event.eid) {
+  case eidI:       sm.process_event(EventI{}); break;
+  case eidO:       sm.process_event(EventO{}); break;
+  case eidX:       sm.process_event(EventX{}); break;
+  case eidT:       sm.process_event(EventT{}); break;
+  case eidTimeout: sm.process_event(DEventTimeout{event.data}); break;
+  default:         break;
+  }
+}
+
+
+
+template <typename Deliver>
+double run(const std::vector<TaggedEvent> &events, Deliver deliver)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  for (const TaggedEvent &event : events)
+    deliver(event);
+  const auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(t1 - t0).count();
+}
+
+void report(const char *stream, const char *name, std::size_t n, double secs, unsigned long transitions)
+{
+  std::cerr << stream << "  " << name << ": " << secs * 1e9 / n << " ns/event  ("
+            << static_cast<long>(n / secs) << " events/sec, " << transitions << " transitions)\n";
+}
+
+void bench(const char *stream, const std::vector<TaggedEvent> &events)
+{
+  TableMachine       table;
+  HandWrittenMachine hand;
+  MsmMachine         fsm;
+  fsm.start();
+
+  const auto deliver_table = [&](const TaggedEvent &e) { table.process_event(e); };
+  const auto deliver_hand  = [&](const TaggedEvent &e) { hand.process_event(e); };
+  const auto deliver_msm   = [&](const TaggedEvent &e) { msm_process_event(fsm, e); };
+
+  run(events, deliver_table); // warmup
+  run(events, deliver_hand);
+  run(events, deliver_msm);
+
+  const double secs_table = run(events, deliver_table);
+  const double secs_hand  = run(events, deliver_hand);
+  const double secs_msm   = run(events, deliver_msm);
+
+  const unsigned long msm_transitions = fsm.get_state<MsmPing &>().entries + fsm.get_state<MsmPong &>().entries;
+  report(stream, "matrix      ", events.size(), secs_table, table.transitions());
+  report(stream, "hand-written", events.size(), secs_hand,  hand.transitions());
+  report(stream, "msm         ", events.size(), secs_msm,   msm_transitions);
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 10000000;
+
+  std::vector<TaggedEvent> xchange(n, TaggedEvent{eidX, {}});
+
+  std::vector<TaggedEvent> mixed;
+  mixed.reserve(n);
+  std::mt19937 rng{42};
+  const EventID kinds[] = {eidI, eidO, eidX, eidX, eidT, eidTimeout};
+  for (std::size_t i = 0; i < n; ++i)
+    mixed.push_back(TaggedEvent{kinds[rng() % 6], {}});
+
+  bench("EventX", xchange);
+  bench("mixed ", mixed);
+  return 0;
+}
@@ -0,0 +1,130 @@
+// microbenchmark: transitions/sec of StateMachine (tagged index + constexpr dispatch tables)
+// versus the former dispatch (StateBase * current_state, found via a dynamic_cast chain)
+//
+// usage: bench_transitions [num_transitions]
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include <chrono>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+
+
+
+/////////////////
+// LegacyMachine: the dispatch as it was before (RTTI on every transition)
+/////////////////
+struct PolyBase {
+  virtual ~PolyBase() {} // polymorphic
+};
+
+struct LegacyPing : public PolyBase, public StatePing {
+  LegacyPing(const std::string &name, std::chrono::milliseconds max_lifetime, boost::asio::io_service &io_service, bool timer_running)
+    : StatePing{name, max_lifetime, io_service, timer_running} {}
+};
+
+struct LegacyPong : public PolyBase, public StatePong {
+  LegacyPong(const std::string &name, std::chrono::milliseconds max_lifetime, boost::asio::io_service &io_service, bool timer_running)
+    : StatePong{name, max_lifetime, io_service, timer_running} {}
+};
+
+class LegacyMachine {
+public:
+  LegacyMachine(boost::asio::io_service &io_service, bool timer_running) :
+    statePing{"statePing", std::chrono::milliseconds(1000), io_service, timer_running},
+    statePong{"statePong", std::chrono::milliseconds(2000), io_service, timer_running},
+    current_state{&statePing} {}
+
+  void process_event(const EventX &event) {
+    if (current_state == &statePing) {
+      change_to_state(event, statePong);
+    } else {
+      change_to_state(event, statePing);
+    }
+  }
+
+  void process_event(const DEventTimeout &event) {
+    if (current_state == &statePing) {
+      change_to_state(event, statePong);
+    } else {
+      change_to_state(event, statePing);
+    }
+  }
+
+  TimerStats &timer_stats() { return stats; }
+
+private:
+  template <typename Event>
+  void leave_state(const Event& event) {
+    if (LegacyPing* p_ping = dynamic_cast<LegacyPing*>(current_state)) {
+      p_ping->on_exit(event, *this);
+    } else if (LegacyPong* p_pong = dynamic_cast<LegacyPong*>(current_state)) {
+      p_pong->on_exit(event, *this);
+    }
+  }
+
+  template <typename Event, typename State>
+  void change_to_state(const Event& event, State &newState) {
+    leave_state(event);
+    current_state = &newState;
+    newState.on_entry(event, *this);
+  }
+
+  LegacyPing statePing;
+  LegacyPong statePong;
+
+  PolyBase *current_state;
+
+  TimerStats stats;
+};
+
+
+
+template <typename Machine>
+double run(Machine &sm, long n)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < n; ++i)
+    sm.process_event(EventX{});
+  const auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(t1 - t0).count();
+}
+
+void report(const char *name, long n, double secs)
+{
+  std::cerr << name << ": " << n << " transitions in " << secs << " s  -> "
+            << static_cast<long>(n / secs) << " transitions/sec  ("
+            << secs * 1e9 / n << " ns/transition)\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const long n = (argc > 1) ? std::atol(argv[1]) : 10000000L;
+
+  boost::asio::io_service io_service;
+
+  // silence "Entering: / Leaving :" so that we measure dispatch and not the console
+  AsyncLogger::instance().set_output(nullptr);
+
+  // timers are switched off: the timer-queue is benchmarked elsewhere
+  LegacyMachine legacy{io_service, false};
+  StateMachine  sm{"StateMachine", io_service};
+  sm.process_event(EventT{});
+
+  run(legacy, n / 10); // warmup
+  run(sm,     n / 10);
+
+  const double secs_legacy = run(legacy, n);
+  const double secs_sm     = run(sm,     n);
+
+  report("dynamic_cast chain   ", n, secs_legacy);
+  report("constexpr dispatch   ", n, secs_sm);
+  std::cerr << "speedup: " << secs_legacy / secs_sm << "x\n";
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+// virtual time: simulate a day of ping pong faster than real time, deterministically
+//
+// usage: bench_virtual [hours]
+//
+// 1) timers only: every timeout must fire exactly on its deadline (lateness 0, phase error 0),
+//    24 h give 24 * 3600 / 3 * 2 = 57600 timeouts (statePing 1 s, statePong 2 s)
+// 2) timers plus a synthetic keyboard (a key every 1300 ms of virtual time), run twice:
+//    both runs must see the same sequence of (time, state)
+//
+// exit code 1 if a check fails
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+#include <cstdint>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+#include "headless_bench.h"
+
+
+
+struct Run {
+  std::uint64_t timeouts = 0;
+  std::uint64_t keys     = 0;
+  std::uint64_t hash     = 14695981039346656037ull;  // FNV-1a over (time, state) at every key
+  std::int64_t  max_lateness_ns = 0;
+  std::int64_t  max_phase_ns    = 0;
+  double        wall_secs       = 0;
+};
+
+
+static void fnv(std::uint64_t &hash, std::uint64_t v)
+{
+  for (int i = 0; i < 8; ++i, v >>= 8) {
+    hash ^= (v & 0xff);
+    hash *= 1099511628211ull;
+  }
+}
+
+
+static Run simulate(std::chrono::hours hours, bool keyboard)
+{
+  VirtualTime::enable();
+
+  Run run;
+  boost::asio::io_service io_service;
+  StateMachine sm{"StateMachine", io_service};
+
+  SyntheticInput input;
+  PluggableTimer key_timer{io_service};
+  std::function<void(const boost::system::error_code &)> on_key = [&](const boost::system::error_code &err) {
+    if (err)
+      return;
+    ++run.keys;
+    fnv(run.hash, static_cast<std::uint64_t>(PluggableClock::now().time_since_epoch().count()));
+    fnv(run.hash, sm.is_active<StatePing>() ? 1 : 2);
+    const char c = input.next();
+    sm.process_event(TaggedEvent{(c == 'i') ? eidI : (c == 'o') ? eidO : eidX, {}});
+    key_timer.expires_at(key_timer.expires_at() + std::chrono::milliseconds(1300));
+    key_timer.async_wait(on_key);
+  };
+
+  const auto t0 = std::chrono::steady_clock::now();
+  sm.start();
+  if (keyboard) {
+    key_timer.expires_at(PluggableClock::now() + std::chrono::milliseconds(1300));
+    key_timer.async_wait(on_key);
+  }
+  VirtualTime::instance().run_for(io_service, hours);
+  run.wall_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  key_timer.cancel();
+  sm.stop();
+  io_service.poll();
+
+  run.timeouts        = sm.timer_stats().lateness_ns().count();
+  run.max_lateness_ns = static_cast<std::int64_t>(sm.timer_stats().lateness_ns().max());
+  run.max_phase_ns    = sm.timer_stats().max_phase_error_ns();
+  return run;
+}
+
+
+static void report(const char *name, const Run &run, std::chrono::hours hours)
+{
+  std::cout << name << ": " << hours.count() << " h virtual in " << run.wall_secs << " s wall ("
+            << static_cast<std::uint64_t>(hours.count() * 3600 / run.wall_secs) << "x real time), "
+            << run.timeouts << " timeouts, " << run.keys << " keys, max lateness " << run.max_lateness_ns
+            << " ns, max phase error " << run.max_phase_ns << " ns, hash " << std::hex << run.hash << std::dec << '\n';
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::chrono::hours hours{(argc > 1) ? std::atol(argv[1]) : 24};
+  AsyncLogger::instance().set_output(nullptr);
+
+  bool ok = true;
+
+  const Run timers = simulate(hours, false);
+  report("timers only  ", timers, hours);
+  const std::uint64_t expected = static_cast<std::uint64_t>(hours.count()) * 3600 / 3 * 2;
+  if (timers.timeouts != expected || timers.max_lateness_ns != 0 || timers.max_phase_ns != 0) {
+    std::cout << "FAIL: expected " << expected << " timeouts, all exactly on time\n";
+    ok = false;
+  }
+
+  const Run a = simulate(hours, true);
+  const Run b = simulate(hours, true);
+  report("keyboard (1) ", a, hours);
+  report("keyboard (2) ", b, hours);
+  if (a.hash != b.hash || a.timeouts != b.timeouts || a.keys != b.keys) {
+    std::cout << "FAIL: runs differ\n";
+    ok = false;
+  }
+
+  AsyncLogger::instance().flush();
+  return ok ? 0 : 1;
+}
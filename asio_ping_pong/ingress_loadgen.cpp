@@ -0,0 +1,105 @@
+// load generator for ping_pong --listen (see net_ingress.h) and ping_pong --shm (see shm_ingress.h)
+//
+// usage: ingress_loadgen udp:PORT|tcp:PORT|shm:NAME [num_events] [events_per_frame] [events_per_sec] [--stamp] [--quit]
+//
+// Sends num_events (default 1000000) random I, O and X events in frames of events_per_frame
+// (default 64) to localhost, or pushes them into the shared memory ring NAME (a frame: that many
+// events pushed back to back); events_per_sec 0 (default): as fast as the socket / ring takes them,
+// else paced frame by frame. --stamp: events carry send times; --quit: a final q stops the machine.
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "statemachine.h"  // EventID
+#include "net_ingress.h"
+#include "shm_ingress.h"
+
+
+
+int main(int argc, char *argv[])
+{
+  NetProtocol protocol = NetProtocol::udp;
+  unsigned short port = 0;
+  const bool shm = (argc >= 2 && !std::strncmp(argv[1], "shm:", 4));
+  if (argc < 2 || (!shm && !parse_net_endpoint(argv[1], protocol, port))) {
+    std::cerr << "usage: ingress_loadgen udp:PORT|tcp:PORT|shm:NAME [num_events] [events_per_frame] [events_per_sec] [--stamp] [--quit]\n";
+    return 1;
+  }
+  std::size_t numbers[3] = {1000000, 64, 0};
+  std::size_t num_numbers = 0;
+  bool stamp = false, send_quit = false;
+  for (int i = 2; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--stamp"))
+      stamp = true;
+    else if (!std::strcmp(argv[i], "--quit"))
+      send_quit = true;
+    else if (num_numbers < 3)
+      numbers[num_numbers++] = std::strtoul(argv[i], nullptr, 10);
+  }
+  const std::size_t num_events = numbers[0];
+  const std::size_t per_frame  = (numbers[1] > 0) ? numbers[1] : 1;
+  const std::size_t rate       = numbers[2];
+
+  std::mt19937 rng{42};
+  std::vector<std::uint8_t> eids(num_events);
+  for (std::uint8_t &eid : eids)
+    eid = static_cast<std::uint8_t>(eidI + rng() % 3); // I, O, X
+  std::vector<std::int64_t> sent_ns(stamp ? per_frame : 0);
+
+  std::unique_ptr<NetSender>    sender;
+  std::unique_ptr<ShmEventRing> ring;
+  if (shm)
+    ring.reset(new ShmEventRing{ShmEventRing::attach(argv[1] + 4)});
+  else
+    sender.reset(new NetSender{protocol, port, per_frame});
+  const auto send = [&](const std::uint8_t *eid, const std::int64_t *sent, std::size_t n) {
+    if (sender)
+      sender->send(eid, sent, n);
+    else
+      for (std::size_t i = 0; i < n; ++i)
+        ring->push(ShmEventRecord{sent ? sent[i] : 0, eid[i]});
+  };
+  const auto now_ns = []() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  };
+
+  const auto t0 = std::chrono::steady_clock::now();
+  if (rate == 0 && !stamp)
+    send(eids.data(), nullptr, num_events);
+  else {
+    const std::chrono::nanoseconds frame_period{rate ? static_cast<std::int64_t>(1e9 * per_frame / rate) : 0};
+    auto next = t0;
+    for (std::size_t i = 0; i < num_events; i += per_frame) {
+      if (rate) {
+        next += frame_period;
+        while (std::chrono::steady_clock::now() < next)
+          std::this_thread::yield();
+      }
+      const std::size_t n = (num_events - i < per_frame) ? num_events - i : per_frame;
+      if (stamp)
+        std::fill(sent_ns.begin(), sent_ns.begin() + n, now_ns());
+      send(&eids[i], stamp ? sent_ns.data() : nullptr, n);
+    }
+  }
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  if (send_quit) {
+    const std::uint8_t q = eidQ;
+    send(&q, nullptr, 1);
+  }
+  if (sender)
+    sender->close();
+
+  std::cerr << "sent " << num_events << " events in frames of " << per_frame << " in " << secs << " s ("
+            << static_cast<long>(num_events / secs) << " events/s)\n";
+  return 0;
+}
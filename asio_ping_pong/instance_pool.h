@@ -0,0 +1,205 @@
+#ifndef INSTANCE_POOL_H
+#define INSTANCE_POOL_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "statemachine.h"   // events
+#include "timing_wheel.h"
+#include "snapshot_file.h"
+#include "ring_config.h"
+
+
+
+////////////////
+// InstancePool
+//
+// Many timed rings (ping-pong: the ring of 2 phases statePing, statePong; see ring_config.h),
+// stored as structure-of-arrays and addressed by instance id. Per instance we only keep 11 bytes
+// (bytes_per_instance()): the current phase (2: its position in the flat phase arrays of all
+// rings), timer_running (1) and the absolute deadline of the running lifetime-timer (8). Lifetime, next phase and first phase of its
+// ring are per position, in flat arrays shared by all instances (so a transition is one load
+// from them, whatever the ring), and there is no timer object per instance: whoever owns the
+// clock delivers DEventTimeout. That is either a TimingWheel given at
+// construction (one wheel entry per instance, id == instance id; see AsioTimingWheel), or a call
+// to process_expired().
+//
+// Transitions generalize those of StateMachine (statemachine.h): DEventTimeout and EventX go on
+// to the next phase of the ring, EventI to phase 0, EventO to phase 1; zero drift as there:
+// after DEventTimeout the next deadline is event.data.time_point + max_lifetime.
+////////////////
+class InstancePool {
+public:
+  using clock       = std::chrono::steady_clock;
+  using time_point  = clock::time_point;
+  using InstanceID  = std::uint32_t;
+
+  enum StateID : std::uint8_t {
+    sidPing,
+    sidPong,
+    NumStates
+  };
+
+  static constexpr time_point no_deadline = time_point::max(); // timer not running
+
+  // every instance in ring 0 of config (see set_ring())
+  explicit InstancePool(std::size_t num_instances, const RingConfig &config_ = RingConfig::current(), TimingWheel *timers_ = nullptr) :
+    config{config_}, timers{timers_},
+    pos(num_instances, 0), timer_running(num_instances, true), deadline(num_instances, no_deadline)
+  {
+    if (config.lifetimes_ns().size() > max_positions)
+      throw std::runtime_error{"InstancePool: more than 65536 phases in the ring config"};
+    for (std::size_t r = 0; r < config.num_rings(); ++r) {
+      const std::size_t first = config.first(r), n = config.num_phases(r);
+      for (std::size_t p = 0; p < n; ++p) {
+        lifetime.push_back(config.lifetime(r, p));
+        next_pos.push_back(static_cast<Position>(first + (p + 1) % n));
+        ring_first.push_back(static_cast<Position>(first));
+        ring_of.push_back(static_cast<std::uint16_t>(r));
+      }
+    }
+  }
+
+  InstancePool(std::size_t num_instances, std::chrono::milliseconds ping_lifetime, std::chrono::milliseconds pong_lifetime,
+               TimingWheel *timers_ = nullptr) :
+    InstancePool{num_instances, RingConfig::ping_pong(ping_lifetime, pong_lifetime), timers_} {}
+
+  // put instance id into ring r of the config (before start())
+  void set_ring(InstanceID id, std::uint16_t r) { pos[id] = static_cast<Position>(config.first(r)); }
+
+  // enter initial state (phase 0: statePing) in every instance
+  void start(time_point now = clock::now()) {
+    for (InstanceID id = 0; id < size(); ++id)
+      enter(id, sidPing, now);
+  }
+
+  void process_event(InstanceID id, const EventI &, time_point now = clock::now()) { enter(id, ring_first[pos[id]], now); }
+  void process_event(InstanceID id, const EventO &, time_point now = clock::now()) { enter(id, next_pos[ring_first[pos[id]]], now); }
+  void process_event(InstanceID id, const EventX &, time_point now = clock::now()) { enter(id, next_pos[pos[id]], now); }
+
+  // zero drift: the new deadline is based on the deadline that expired, not on "now"
+  void process_event(InstanceID id, const DEventTimeout &event) { enter(id, next_pos[pos[id]], event.data.time_point); }
+
+  void process_event(InstanceID id, const EventT &, time_point now = clock::now()) {
+    timer_running[id] = !timer_running[id];
+    set_deadline(id, timer_running[id] ? now + lifetime[pos[id]] : no_deadline);
+  }
+
+  // runtime-tagged event (eidQ is ignored: quitting is a matter of the runtime, not of an instance)
+  void process_event(InstanceID id, EventID eid, time_point now = clock::now()) {
+    switch (eid) {
+    case eidI: process_event(id, EventI{}, now); break;
+    case eidO: process_event(id, EventO{}, now); break;
+    case eidX: process_event(id, EventX{}, now); break;
+    case eidT: process_event(id, EventT{}, now); break;
+    default:   break;
+    }
+  }
+
+  // batch: event eids[i] goes to instance ids[i]. "now" is taken once for the whole batch
+  void process_events(const InstanceID *ids, const EventID *eids, std::size_t n, time_point now = clock::now()) {
+    for (std::size_t i = 0; i < n; ++i)
+      process_event(ids[i], eids[i], now);
+  }
+
+  // batch: the same event to every instance in [first, last)
+  void process_events(InstanceID first, InstanceID last, EventID eid, time_point now = clock::now()) {
+    for (InstanceID id = first; id < last; ++id)
+      process_event(id, eid, now);
+  }
+
+  // deliver DEventTimeout to every instance whose deadline is <= now (linear sweep); returns number of timeouts
+  std::size_t process_expired(time_point now = clock::now()) {
+    std::size_t count = 0;
+    for (InstanceID id = 0; id < size(); ++id) {
+      if (deadline[id] <= now) {
+        process_event(id, DEventTimeout{{deadline[id]}});
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  StateID    get_state(InstanceID id)         const { return static_cast<StateID>(get_phase(id)); } // (ping-pong)
+  std::uint8_t  get_phase(InstanceID id)      const { return static_cast<std::uint8_t>(pos[id] - ring_first[pos[id]]); }
+  std::uint16_t get_ring(InstanceID id)       const { return ring_of[pos[id]]; }
+  bool       is_timer_running(InstanceID id)  const { return timer_running[id]; }
+  time_point get_deadline(InstanceID id)      const { return deadline[id]; }
+  std::size_t size()                          const { return pos.size(); }
+
+  static const char *state_name(StateID sid) {
+    static const char *const names[NumStates] = {"statePing", "statePong"};
+    return names[sid];
+  }
+
+  const std::string &phase_name(InstanceID id) const { return config.all_phase_names()[pos[id]]; }
+
+  const RingConfig &ring_config() const { return config; }
+
+  /* warm restart (see snapshot_file.h): out / in hold one record per instance, in the order of
+     the instance ids: one sequential pass, no per-instance objects */
+  void snapshot(Span<MachineSnapshot> out) const {
+    for (InstanceID id = 0; id < size(); ++id)
+      out[id] = MachineSnapshot{(deadline[id] == no_deadline) ? snapshot_no_deadline : to_ns(deadline[id]), id, get_phase(id), timer_running[id], get_ring(id)};
+  }
+
+  // instead of start(): every instance continues in its state, running timers at their original deadlines (zero drift)
+  void restore(Span<const MachineSnapshot> in, std::int64_t clock_offset_ns = 0) {
+    pos.resize(in.size());
+    timer_running.resize(in.size());
+    deadline.resize(in.size());
+    for (InstanceID id = 0; id < size(); ++id) {
+      const MachineSnapshot &snap = in[id];
+      const std::size_t r = (snap.ring < config.num_rings()) ? snap.ring : 0;
+      pos[id]           = static_cast<Position>(config.first(r) + ((snap.state < config.num_phases(r)) ? snap.state : 0));
+      timer_running[id] = snap.timer_running;
+      set_deadline(id, (snap.timer_running && snap.deadline_ns != snapshot_no_deadline)
+                       ? time_point{std::chrono::nanoseconds{snap.deadline_ns + clock_offset_ns}} : no_deadline);
+    }
+  }
+
+  // memory that grows with the number of instances
+  static constexpr std::size_t bytes_per_instance() {
+    return sizeof(Position) + sizeof(std::uint8_t) + sizeof(time_point);
+  }
+
+private:
+  using Position = std::uint16_t;  // in the flat phase arrays
+  static constexpr std::size_t max_positions = 65536;
+
+  static std::int64_t to_ns(time_point t) { return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count(); }
+
+  // leave the current phase and enter the one at position p; the lifetime-timer (if running) starts at base
+  void enter(InstanceID id, Position p, time_point base) {
+    pos[id] = p;
+    set_deadline(id, timer_running[id] ? base + lifetime[p] : no_deadline);
+  }
+
+  void set_deadline(InstanceID id, time_point t) {
+    deadline[id] = t;
+    if (timers) {
+      if (t != no_deadline) timers->arm(id, t);
+      else                  timers->cancel(id);
+    }
+  }
+
+  RingConfig config;
+  TimingWheel *timers;
+
+  // flat, indexed by Position: phase i of ring r is at config.first(r) + i
+  std::vector<clock::duration> lifetime;
+  std::vector<Position>        next_pos;    // the next phase of the ring (after the last: phase 0)
+  std::vector<Position>        ring_first;  // phase 0 of the ring
+  std::vector<std::uint16_t>   ring_of;
+
+  // structure-of-arrays, indexed by InstanceID
+  std::vector<Position>     pos;            // current phase (ping-pong: StateID)
+  std::vector<std::uint8_t> timer_running;  // bool (not std::vector<bool>: no bit-fiddling on the hot path)
+  std::vector<time_point>   deadline;       // absolute; no_deadline if the timer is not running
+};
+
+#endif
@@ -1,282 +1,34 @@
 #include <iostream>
 #include <string>
 #include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
 
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include <experimental/optional>
 
 #include <boost/asio.hpp>
-#include <boost/asio/steady_timer.hpp>
-#include <boost/signals2.hpp>
-
-
-
-
-////////////////////////
-// base-class for states
-// print message for entry or exit to state
-////////////////////////
-class StateBase {
-public:
-  StateBase(const std::string& name_) : name{name_} {}
-
-  virtual ~StateBase() {} // polymorphic
-  
-  template <typename Event, typename FSM>
-  void on_entry(const Event&, FSM&) { std::cout << "Entering: " << name << std::endl; }
-
-  template <typename Event, typename FSM>
-  void on_exit(const Event&, FSM&) { std::cout << "Leaving : " << name << std::endl; }
-
-private:
-  std::string name;
-  
-};
-
-
-
-// Data for DEventTimeout
-struct TimeoutData {
-  std::chrono::steady_clock::time_point time_point;
-};
-
-//////////
-// events
-//////////
-struct EventI {};  // pIng    event: leave current state and go to ping state
-struct EventO {};  // pOng    event: leave current state and go to pong state
-struct EventX {};  // xchange event: change between ping and pong
-struct EventT {};  // toggle timer on/off
-struct DEventTimeout {
-  TimeoutData data;  /* Timeout Event
-                        This will be a DataEvent [DEvent] carrying the timestamp-of-timeout.
-                        Reason:
-                        if we timeout and enter a new state; and setup a new timer, there is a brief delay until that timer is running.
-                        This could cause timer drift.
-                        Therefore the timeout event carries the timestamp-of-timeout, so that the new timer can be
-                        setup (taking into consideration timestamp-of-timeout), leading to *no* timer drift!
-                     */
-};
 
+#include "statemachine.h"
+#include "event_ingress.h"
+#include "event_recording.h"
+#include "descriptor_input.h"
+#include "net_ingress.h"
+#include "shm_ingress.h"
+#include "fast_signal.h"
+#include "snapshot_file.h"
 
-enum EventID {
-  eidI, // pIng
-  eidO, // pOng
-  eidX, // xchange
-  eidT, // toggle timer on/off
-  eidQ  // quit
-};
-
-
-////////////////
-// State Machine
-////////////////
-class StateMachine : public StateBase {
-public:
-  StateMachine(const std::string& name_, boost::asio::io_service &io_service_) :
-    StateBase{name_}, timer_running{true},
-    statePing{"statePing", std::chrono::milliseconds(1000), io_service_, timer_running},
-    statePong{"statePong", std::chrono::milliseconds(2000), io_service_, timer_running},
-    current_state{&statePing} {}
-
-  void start()
-  {
-    // enter initial state
-    if (StatePing* p_ping = dynamic_cast<StatePing*>(current_state)) {
-      p_ping->on_entry(0, *this);
-    } else if (StatePong* p_pong = dynamic_cast<StatePong*>(current_state)) {
-      p_pong->on_entry(0, *this);
-    }    
-  }
-
-  void stop()
-  {
-    leave_state(0);
-  }
-
-  /*
-    .       EventI
-    state ----------> statePing
-  */
-  void process_event(const EventI &event) {
-    change_to_state(event, statePing);
-  }
 
-  /*
-    .       EventO
-    state ----------> statePong
-  */
-  void process_event(const EventO &event) {
-    change_to_state(event, statePong);
-  }
-
-
-  /*
-    .           EventX
-    statePing ----------> statePong
-
-    .           EventX
-    statePong ----------> statePing
-  */
-  void process_event(const EventX &event) {
-    if (current_state == &statePing) {
-      change_to_state(event, statePong);
-    } else /* if (current_state == &statePong) */ {
-      change_to_state(event, statePing);
-    }
-  }
-
-  /*
-    .           DEventTimeout
-    statePing -----------------> statePong
-
-    .           DEventTimeout
-    statePong -----------------> statePing
-
-  */
-  void process_event(const DEventTimeout &event) {
-    if (current_state == &statePing) {
-      change_to_state(event, statePong);
-    } else /* if (current_state == &statePong) */ {
-      change_to_state(event, statePing);
-    }
-  }
-
-  /*
-    .       EventT
-    state ----------| 
-  */
-  void process_event(const EventT &event) {
-    timer_running = !timer_running;
-    statePing.set_timer_running(timer_running, *this, current_state);
-    statePong.set_timer_running(timer_running, *this, current_state);
-    /*
-      if (StatePing* p_ping = dynamic_cast<StatePing*>(current_state)) {
-        p_ping->on_entry(event, *this);
-      } else if (StatePong* p_pong = dynamic_cast<StatePong*>(current_state)) {
-        p_pong->on_entry(event, *this);
-      }
-    */
-  }
-
-  
-private:
-  
-  // ##### StateTime #####
-  struct StateTime : public StateBase {
-    StateTime(const std::string &name, std::chrono::milliseconds max_lifetime_, boost::asio::io_service &io_service_, bool timer_running_)
-      : StateBase{name}, max_lifetime{max_lifetime_}, timer{io_service_}, timer_running{timer_running_} {}
-
-    template <typename Event, typename FSM> // see overloads below
-    void on_entry(const Event &event, FSM &fsm) {
-      if (timer_running) {
-        timer.expires_from_now(max_lifetime);
-        start_timer(fsm);
-      }
-      StateBase::on_entry(event, fsm);
-    }
-
-    template <typename FSM> // overload: specializing Event to DEventTimeout
-    void on_entry(const DEventTimeout &event, FSM &fsm) {
-      if (timer_running) {
-        timer.expires_at(event.data.time_point + max_lifetime);
-        start_timer(fsm);
-      }
-      StateBase::on_entry(event, fsm);
-    }
-
-    template <typename FSM> // overload: specializing Event to EventT (toggle timer) -- this is currently not called (see set_timer_running() below)
-    void on_entry(const EventT &event, FSM &fsm) {
-      if (timer_running) {
-        timer.expires_from_now(max_lifetime);
-        start_timer(fsm);
-      } else {
-        timer.cancel();
-      }
-      // StateBase::on_entry(event, fsm); // don't call this line, or we would print entry to a state, in which we are already in
-    }
-    
-    template <typename Event, typename FSM>
-    void on_exit(const Event &event, FSM &fsm) {
-      timer.cancel();
-      StateBase::on_exit(event, fsm);
-    }
-
-    template <typename FSM>
-    void set_timer_running(bool run, FSM &fsm, StateBase *current_state) {
-      timer_running = run;
-      if (timer_running) {
-        if (current_state == this) {
-          /* because of the following, we don't send EventT into the state itself
-             (see overload specializing Event to EventT)
-          */
-          timer.expires_from_now(max_lifetime);
-          start_timer(fsm);
-        }
-      } else {
-        timer.cancel();
-      }
-    }
-    
-  private:
-    template <typename FSM>
-    void timeout(const boost::system::system_error &err, FSM &fsm) {
-      if (err.code() == boost::system::errc::success)
-        fsm.process_event(DEventTimeout{{timer.expires_at()}});
-    }
-
-    template <typename FSM>
-    void start_timer(FSM &fsm) {
-        timer.async_wait(std::bind(&StateTime::timeout<FSM>, this, std::placeholders::_1, std::ref(fsm)));
-    }
-    
-  private:
-    std::chrono::milliseconds max_lifetime;
-    boost::asio::steady_timer timer;
-    bool timer_running;
-  };
-
-  // ##### StatePing #####
-  struct StatePing : public StateTime {
-    using StateTime::StateTime;
-  };
-
-  // ##### StatePong #####
-  struct StatePong : public StateTime {
-    using StateTime::StateTime;
-  };
-
-
-  template <typename Event>
-  void leave_state(const Event& event) {
-    // leave old state
-    if (StatePing* p_ping = dynamic_cast<StatePing*>(current_state)) {
-      p_ping->on_exit(event, *this);
-    } else if (StatePong* p_pong = dynamic_cast<StatePong*>(current_state)) {
-      p_pong->on_exit(event, *this);
-    }
-  }
-
-  template <typename Event, typename State>
-  void change_to_state(const Event& event, State &newState) {
-    leave_state(event);
-    
-    // set   new state
-    current_state = &newState;  
-    newState.on_entry(event, *this);
-  }
-
-
-  bool timer_running;
-  StatePing statePing;
-  StatePong statePong;
-  
-  StateBase *current_state;
-  
-};
 
 
 // class Interface {
@@ -311,23 +63,23 @@ public:
   Interface(boost::asio::io_service &io_service_) : io_service{io_service_} {}
   
   void run_statemachine() {
-    for (char c; std::cin >> c; ) {
+    for (char c; wait_for_key() && std::cin.get(c); ) {
       switch (tolower(c)) {
       case 'i':
         //sm.process_event(EventI{}); // go to state ping
-        sig(eidI);
+        emit(eidI);
         break;
       case 'o':
         //sm.process_event(EventO{}); // go to state pong
-        sig(eidO);
+        emit(eidO);
         break;
       case 'x':
         //sm.process_event(EventX{}); // xchange state
-        sig(eidX);
+        emit(eidX);
         break;
       case 't':
         //sm.process_event(EventT{}); // toggle timer on/off
-        sig(eidT);
+        emit(eidT);
         break;
       case 'q':
         goto label_stop;
@@ -335,27 +87,152 @@ public:
       }
     }
   label_stop:
-    sig(eidQ);
+    if (!stopped.load(std::memory_order_relaxed))
+      emit(eidQ);
+  }
+
+  // instead of std::cin: the events of a recording (paced: at their original pacing; else as fast as possible)
+  void replay(const std::vector<RecordedEvent> &events, bool paced) {
+    replay_events(events, paced, [this](std::uint8_t eid) {
+        if (eid != eidQ)
+          emit(static_cast<T>(eid));
+      }, &stopped);
+    if (!stopped.load(std::memory_order_relaxed))
+      emit(eidQ); // (also if the recording was cut short)
   }
 
-  void connect(std::function<void(T)> f) {
-    sig.connect(f);
+  // quit came from another input (--listen, --shm): the loop above ends, without a further event
+  void stop() {
+    stopped.store(true, std::memory_order_relaxed);
+  }
+
+  // every event from the interface is also recorded (nullptr: not recorded)
+  void set_recorder(EventRecorder *recorder_) {
+    recorder = recorder_;
+  }
+
+  template <typename F>
+  void connect(F f) {
+    sig.connect(std::move(f));
   }
   
   
   private:
-  boost::signals2::signal<void(T)> sig;
+  /* till std::cin has a key (or eof, an error) or stop(): a key read ahead is in std::cin's own
+     buffer (std::ios::sync_with_stdio(false), see main), else stdin is polled every 100 ms */
+  bool wait_for_key() {
+    while (!stopped.load(std::memory_order_relaxed)) {
+      if (std::cin.rdbuf()->in_avail() != 0)
+        return true;
+      pollfd fd{STDIN_FILENO, POLLIN, 0};
+      if (::poll(&fd, 1, 100) != 0)
+        return true;
+    }
+    return false;
+  }
+
+  void emit(T eid) {
+    if (recorder)
+      recorder->record(eid);
+    sig(eid);
+  }
+
+  Signal<void(T)> sig; // (lock-free emission: see fast_signal.h)
+  EventRecorder *recorder = nullptr;
+  std::atomic<bool> stopped{false};
   boost::asio::io_service &io_service;
 };
 
 
-int main()
+static const char usage[] = "usage: ping_pong [--record file] [--replay file [--fast]] [--cin] [--snapshot file] [--ring file] [--listen udp:PORT|tcp:PORT] [--shm name] [trace_file]\n";
+
+int main(int argc, char *argv[])
 {
+  const char *trace_path  = "ping_pong.trace";
+  const char *record_path = nullptr; // record the input events
+  const char *replay_path = nullptr; // input events from a recording instead of the keyboard
+  bool        fast        = false;   // replay as fast as the machine takes them
+  bool        cin_thread  = false;   // read std::cin char by char on a thread (instead of stdin in chunks on the io_service)
+  const char *snapshot_path = nullptr; // warm restart: state and timer deadline saved at exit, restored at start
+  const char *listen      = nullptr; // event frames from localhost (see net_ingress.h), besides the keyboard
+  NetProtocol listen_protocol = NetProtocol::udp;
+  unsigned short listen_port  = 0;
+  const char *shm_name    = nullptr; // event ring in shared memory for other processes (see shm_ingress.h)
+  const auto takes_value = [](const char *arg) {
+    for (const char *option : {"--record", "--replay", "--snapshot", "--ring", "--listen", "--shm"})
+      if (!std::strcmp(arg, option))
+        return true;
+    return false;
+  };
+  for (int i = 1; i < argc; ++i) {
+    if (takes_value(argv[i]) && i + 1 == argc) {
+      std::cerr << argv[i] << ": value missing\n" << usage;
+      return 1;
+    }
+    if (!std::strcmp(argv[i], "--record"))
+      record_path = argv[++i];
+    else if (!std::strcmp(argv[i], "--replay"))
+      replay_path = argv[++i];
+    else if (!std::strcmp(argv[i], "--fast"))
+      fast = true;
+    else if (!std::strcmp(argv[i], "--cin"))
+      cin_thread = true;
+    else if (!std::strcmp(argv[i], "--snapshot"))
+      snapshot_path = argv[++i];
+    else if (!std::strcmp(argv[i], "--ring")) {
+      try {
+        RingConfig::current() = RingConfig::load(argv[++i]); // lifetimes of statePing, statePong (see ring_config.h)
+        RingConfig::current().require_phases(0, 2, "statePing, statePong");
+      }
+      catch (const std::exception &e) {
+        std::cerr << e.what() << '\n' << usage;
+        return 1;
+      }
+    }
+    else if (!std::strcmp(argv[i], "--listen")) {
+      listen = argv[++i];
+      if (!parse_net_endpoint(listen, listen_protocol, listen_port)) {
+        std::cerr << "--listen: expected udp:PORT or tcp:PORT, got " << listen << '\n';
+        return 1;
+      }
+    }
+    else if (!std::strcmp(argv[i], "--shm"))
+      shm_name = argv[++i];
+    else if (!std::strncmp(argv[i], "--", 2)) {
+      std::cerr << argv[i] << ": unknown option\n" << usage;
+      return 1;
+    }
+    else
+      trace_path = argv[i];
+  }
+
+  if (cin_thread) // (before any output: std::cin then buffers itself, see Interface::wait_for_key())
+    std::ios::sync_with_stdio(false);
+
+  /* the keyboard: stdin, read on the io_service (see below), unless --replay or --cin. A closed
+     stdin (e.g. ping_pong <&-) leaves the other inputs, if any */
+  const int stdin_fd = (replay_path || cin_thread) ? -1 : ::dup(STDIN_FILENO);
+  if (!replay_path && !cin_thread && stdin_fd < 0 && !listen && !shm_name) {
+    std::cerr << "stdin: " << std::strerror(errno) << " (no input)\n" << usage;
+    return 1;
+  }
+
+  std::vector<RecordedEvent> recording;
+  if (replay_path) {
+    try {
+      recording = load_event_recording(replay_path);
+    }
+    catch (const std::exception &e) {
+      std::cerr << e.what() << '\n';
+      return 1;
+    }
+  }
+
   std::cout <<
     "There are 2 states: statePing and statePong\n"
     "When timer running then:\n"
-    "Maximum lifetime of statePing is 1000 ms - it will then automatically transition to statePong;\n"
-    "Maximum lifetime of statePong is 2000 ms - it will then automatically transition to statePing.\n"
+    "Maximum lifetime of statePing is " << std::chrono::duration_cast<std::chrono::milliseconds>(RingConfig::current().lifetime(0, 0)).count() << " ms - it will then automatically transition to statePong;\n"
+    "Maximum lifetime of statePong is " << std::chrono::duration_cast<std::chrono::milliseconds>(RingConfig::current().lifetime(0, 1)).count() << " ms - it will then automatically transition to statePing.\n"
     "\n"
     "Keyboard-Input can cause transitions before the max-lifetime-timeouts:\n"
     "'x': xchange state\n"
@@ -366,7 +243,8 @@ int main()
     "\n"
     "...Hit Enter to start!" << std::flush;
 
-  std::cin.ignore();
+  if (!replay_path && (cin_thread || ::isatty(STDIN_FILENO))) // (std::cin would buffer more than a line of a pipe)
+    std::cin.ignore();
 
 
   boost::asio::io_service io_service;
@@ -384,46 +262,168 @@ int main()
   */
 
   
-  std::thread th(&Interface::run_statemachine, &interface);
+
+  // always-on trace of every entry / exit (see trace_recorder.h; decode with trace_decode)
+  TraceRecorder trace{trace_path};
+  TraceRecorder::current() = &trace; // the machine runs on this thread (io_service.run() below)
 
   StateMachine sm{"StateMachine", io_service};
-  sm.start();
+  if (snapshot_path && ::access(snapshot_path, R_OK) == 0) { // warm restart (see snapshot_file.h)
+    SnapshotReader reader{snapshot_path};
+    if (reader.records().empty())
+      sm.start();
+    else
+      sm.restore(reader.records()[0], reader.clock_offset_ns());
+  }
+  else
+    sm.start();
   
-  interface.connect([&](EventID eid) {
+  // timer accuracy (lateness, phase error): reported on SIGUSR1 and at exit
+  boost::asio::signal_set report_signal{io_service, SIGUSR1};
+  std::function<void(const boost::system::error_code &, int)> on_report = [&](const boost::system::error_code &err, int) {
+      if (!err) {
+        sm.timer_stats().report(std::cerr);
+        report_signal.async_wait(on_report);
+      }
+    };
+  report_signal.async_wait(on_report);
+
+  /* events from the interface thread are handed over through a lock-free ring and
+     handled in batches on the io_service's thread (see event_ingress.h) */
+  std::unique_ptr<DescriptorInput<TaggedEvent>> stdin_input; // (see below)
+  std::unique_ptr<NetIngress<TaggedEvent>>      net_input;
+  std::unique_ptr<ShmIngress<TaggedEvent>>      shm_input;
+  bool quitting = false;
+  const auto quit = [&]() {
+    if (quitting)               // (once: a batch already handed over may end with eidQ as well)
+      return;
+    quitting = true;
+    if (snapshot_path) {        // for the warm restart
+      SnapshotWriter writer{snapshot_path, 1};
+      writer.records()[0] = sm.snapshot();
+      writer.commit();
+    }
+    sm.stop();                  // stop machine
+    work = std::experimental::nullopt; /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
+    report_signal.cancel();
+    if (stdin_input)            // the other input, if quit came from one
+      stdin_input->cancel();
+    if (net_input)
+      net_input->cancel();
+    if (shm_input)
+      shm_input->cancel();
+    interface.stop();           // --cin, --replay
+  };
+
+  EventIngress<EventID> ingress{io_service, [&](EventID eid) {
       switch (eid) {
       case eidI:
-        io_service.post(std::bind(static_cast<void (StateMachine::*)(const EventI &event)>(&StateMachine::process_event),
-                                  &sm, EventI{})); // go to state ping
-        //sm.process_event(EventI{}); 
+        sm.process_event(EventI{}); // go to state ping
         break;
       case eidO:
-        io_service.post(std::bind(static_cast<void (StateMachine::*)(const EventO &event)>(&StateMachine::process_event),
-                                  &sm, EventO{})); // go to state pong
-        //sm.process_event(EventO{});
+        sm.process_event(EventO{}); // go to state pong
         break;
       case eidX:
-        io_service.post(std::bind(static_cast<void (StateMachine::*)(const EventX &event)>(&StateMachine::process_event),
-                                  &sm, EventX{})); // xchange state
-        //sm.process_event(EventX{});
+        sm.process_event(EventX{}); // xchange state
         break;
       case eidT:
-        io_service.post(std::bind(static_cast<void (StateMachine::*)(const EventT &event)>(&StateMachine::process_event),
-                                  &sm, EventT{})); // toggle timer on/off
-        //sm.process_event(EventT{});
+        sm.process_event(EventT{}); // toggle timer on/off
         break;
       case eidQ:
-        io_service.post(std::bind(&StateMachine::stop, &sm)); // stop machine
-        work = std::experimental::nullopt; /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
+        quit();
         break;
       default:
         break;
       }
+    }};
+
+  interface.connect([&](EventID eid) { ingress.post(eid); });
+
+  // input starts only now that it is connected (else early events, e.g. of a replay, are lost)
+  std::unique_ptr<EventRecorder> recorder;
+  if (record_path) {
+    recorder.reset(new EventRecorder{record_path});
+    interface.set_recorder(recorder.get());
+  }
+
+  const TaggedEvent key_events[] = {{eidI, {}}, {eidO, {}}, {eidX, {}}, {eidT, {}}, {eidQ, {}}};
+
+  // a batch of events from another process (up to eidQ: events after quit are ignored)
+  const auto process_external = [&](Span<const TaggedEvent> events) {
+    std::size_t n = 0;
+    while (n < events.size() && events[n].eid != eidQ)
+      ++n;
+    if (recorder)
+      for (std::size_t i = 0; i < n; ++i)
+        recorder->record(events[i].eid);
+    sm.process_events(events.subspan(0, n));
+    if (n < events.size()) {
+      if (recorder)
+        recorder->record(eidQ);
+      quit();
     }
-    );
-  
+  };
+
+  /* --listen: frames of events from localhost, every read (a recvmmsg() of datagrams, or a chunk
+     of the TCP stream) becomes one batch (see net_ingress.h); the wire ids are the EventIDs.
+     --shm: producers in other processes attach to the ring /dev/shm/<name> and push EventIDs
+     (see shm_ingress.h; e.g. ingress_loadgen shm:name).
+     (before the input thread starts: failing here, e.g. on a port in use, ends the program) */
+  const auto input_failed = [&](const char *option, const char *value, const std::exception &e) {
+    std::cerr << option << ' ' << value << ": " << e.what() << '\n';
+    sm.stop();
+  };
+  try {
+    if (listen)
+      net_input.reset(new NetIngress<TaggedEvent>{io_service, listen_protocol, listen_port, key_events, process_external});
+  }
+  catch (const std::exception &e) {
+    input_failed("--listen", listen, e);
+    return 1;
+  }
+  try {
+    if (shm_name)
+      shm_input.reset(new ShmIngress<TaggedEvent>{io_service, shm_name, key_events, process_external});
+  }
+  catch (const std::exception &e) {
+    input_failed("--shm", shm_name, e);
+    return 1;
+  }
+
+  const auto input_start = std::chrono::steady_clock::now();
+  std::thread th;
+  if (replay_path)
+    th = std::thread{[&]() { interface.replay(recording, !fast); }};
+  else if (cin_thread)
+    th = std::thread{&Interface::run_statemachine, &interface};
+
+  /* default: stdin is read in chunks on this thread, every chunk becomes one batch of events
+     (see descriptor_input.h) */
+  if (stdin_fd >= 0)
+    stdin_input.reset(new DescriptorInput<TaggedEvent>{io_service, stdin_fd, "ioxtq", key_events, 'q',
+                                                       [&](Span<const TaggedEvent> events) {
+          if (recorder)
+            for (const TaggedEvent &event : events)
+              recorder->record(event.eid);
+          const bool last = (events[events.size() - 1].eid == eidQ);
+          sm.process_events(last ? events.subspan(0, events.size() - 1) : events);
+          if (last)
+            quit();
+        }});
+
   io_service.run();
-  
-  th.join();
+
+  if (th.joinable())
+    th.join();
+
+  if (replay_path) { // till the machine has handled the last event
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - input_start).count();
+    std::cerr << "replay " << recording.size() << " events in " << secs << " s ("
+              << static_cast<std::uint64_t>(recording.size() / secs) << " events/s)\n";
+  }
+
+  AsyncLogger::instance().flush(); // last "Leaving : ..."
+  sm.timer_stats().report(std::cerr);
   
   return 0;
 }
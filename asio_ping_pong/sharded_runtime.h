@@ -0,0 +1,131 @@
+#ifndef SHARDED_RUNTIME_H
+#define SHARDED_RUNTIME_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <experimental/optional>
+
+#include <boost/asio.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "instance_pool.h"
+#include "timing_wheel.h"
+
+
+
+////////////////
+// ShardedRuntime
+//
+// N shards, each with its own io_service running on its own thread (pinned to a core).
+// Every shard owns a disjoint set of machine instances: instance id belongs to shard (id % N)
+// and has the local id (id / N) in that shard's InstancePool. Events are routed by instance id
+// and posted to the owning shard, so a pool (and its TimingWheel) is only ever touched by one
+// thread: no locks in the state machines.
+////////////////
+class ShardedRuntime {
+public:
+  using InstanceID = InstancePool::InstanceID;
+
+  struct Shard {
+    Shard(std::size_t num_instances, std::chrono::milliseconds ping_lifetime, std::chrono::milliseconds pong_lifetime) :
+      work{std::experimental::in_place, io_service},
+      wheel{num_instances},
+      pool{num_instances, ping_lifetime, pong_lifetime, &wheel},
+      timers{io_service, wheel, [this](TimingWheel::TimerID id, TimingWheel::time_point deadline) {
+          pool.process_event(id, DEventTimeout{{deadline}});
+        }} {}
+
+    boost::asio::io_service io_service;
+    std::experimental::optional<boost::asio::io_service::work> work; // keep io_service.run() going
+    TimingWheel     wheel;
+    InstancePool    pool;
+    AsioTimingWheel timers;
+    std::thread     thread;
+  };
+
+  ShardedRuntime(std::size_t num_shards, std::size_t num_instances,
+                 std::chrono::milliseconds ping_lifetime = std::chrono::milliseconds(1000),
+                 std::chrono::milliseconds pong_lifetime = std::chrono::milliseconds(2000),
+                 bool pin_threads = true) :
+    pin{pin_threads}
+  {
+    for (std::size_t s = 0; s < num_shards; ++s) {
+      // instances s, s+N, s+2N, ... live in shard s
+      const std::size_t local_instances = num_instances / num_shards + (s < num_instances % num_shards ? 1 : 0);
+      shards.emplace_back(new Shard{local_instances, ping_lifetime, pong_lifetime});
+    }
+  }
+
+  ~ShardedRuntime() { stop(); }
+
+  // start one thread per shard; every shard enters the initial state of its instances on its own thread
+  void start() {
+    const unsigned num_cores = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t s = 0; s < shards.size(); ++s) {
+      Shard &shard = *shards[s];
+      boost::asio::post(shard.io_service, [&shard]() { shard.pool.start(); shard.timers.start(); });
+      shard.thread = std::thread([&shard]() { shard.io_service.run(); });
+      if (pin)
+        pin_to_core(shard.thread, s % num_cores);
+    }
+  }
+
+  // let every shard finish its queued events, then join the threads
+  void stop() {
+    for (auto &shard : shards) {
+      if (!shard->thread.joinable())
+        continue;
+      Shard *p = shard.get();
+      boost::asio::post(p->io_service, [p]() { p->timers.stop(); });
+      p->work = std::experimental::nullopt;
+    }
+    for (auto &shard : shards)
+      if (shard->thread.joinable())
+        shard->thread.join();
+  }
+
+  std::size_t num_shards()                  const { return shards.size(); }
+  std::size_t shard_of(InstanceID id)       const { return id % shards.size(); }
+  InstanceID  local_id(InstanceID id)       const { return id / shards.size(); }
+  Shard      &shard(std::size_t s)                { return *shards[s]; }
+
+  // route event eid to instance id (thread-safe: runs on the owning shard's thread)
+  void post(InstanceID id, EventID eid) {
+    Shard &s = *shards[shard_of(id)];
+    const InstanceID local = local_id(id);
+    boost::asio::post(s.io_service, [&s, local, eid]() { s.pool.process_event(local, eid); });
+  }
+
+  // run f(shard) on the thread of shard s
+  template <typename F>
+  void post_to_shard(std::size_t s, F &&f) {
+    Shard &sh = *shards[s];
+    boost::asio::post(sh.io_service, [&sh, f = std::forward<F>(f)]() mutable { f(sh); });
+  }
+
+private:
+  static void pin_to_core(std::thread &th, unsigned core) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    pthread_setaffinity_np(th.native_handle(), sizeof(cpu_set_t), &cpuset);
+#else
+    (void)th; (void)core;
+#endif
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  bool pin;
+};
+
+#endif
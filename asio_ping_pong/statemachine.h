@@ -0,0 +1,484 @@
+#ifndef STATEMACHINE_H
+#define STATEMACHINE_H
+
+#include <iostream>
+#include <string>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "span.h"
+#include "handler_allocator.h"
+#include "async_logger.h"
+#include "trace_recorder.h"
+#include "timer_stats.h"
+#include "pluggable_clock.h"
+#include "snapshot_file.h"
+#include "transition_table.h"
+#include "ring_config.h"
+
+
+
+
+// Data for DEventTimeout
+struct TimeoutData {
+  std::chrono::steady_clock::time_point time_point;
+};
+
+//////////
+// events
+//////////
+struct EventI {};  // pIng    event: leave current state and go to ping state
+struct EventO {};  // pOng    event: leave current state and go to pong state
+struct EventX {};  // xchange event: change between ping and pong
+struct EventT {};  // toggle timer on/off
+struct EventQ {};  // quit: leave the current state
+struct DEventTimeout {
+  TimeoutData data;  /* Timeout Event
+                        This will be a DataEvent [DEvent] carrying the timestamp-of-timeout.
+                        Reason:
+                        if we timeout and enter a new state; and setup a new timer, there is a brief delay until that timer is running.
+                        This could cause timer drift.
+                        Therefore the timeout event carries the timestamp-of-timeout, so that the new timer can be
+                        setup (taking into consideration timestamp-of-timeout), leading to *no* timer drift!
+                     */
+};
+
+
+enum EventID {
+  eidI, // pIng
+  eidO, // pOng
+  eidX, // xchange
+  eidT, // toggle timer on/off
+  eidQ, // quit
+  eidTimeout // DEventTimeout (not from the keyboard: carries TimeoutData)
+};
+
+// an event as a value: id plus (for eidTimeout) its data
+struct TaggedEvent {
+  EventID     eid;
+  TimeoutData data;
+};
+
+// EventID of an event-type (for logging)
+template <typename Event> struct event_id                { static constexpr std::uint8_t value = LogRecord::no_event; };
+template <>               struct event_id<EventI>        { static constexpr std::uint8_t value = eidI; };
+template <>               struct event_id<EventO>        { static constexpr std::uint8_t value = eidO; };
+template <>               struct event_id<EventX>        { static constexpr std::uint8_t value = eidX; };
+template <>               struct event_id<EventT>        { static constexpr std::uint8_t value = eidT; };
+template <>               struct event_id<DEventTimeout> { static constexpr std::uint8_t value = eidTimeout; };
+
+
+
+////////////////////////
+// base-class for states
+// log entry or exit to state (asynchronously: see async_logger.h)
+// and record it in the trace of this thread, if any (see trace_recorder.h)
+////////////////////////
+class StateBase {
+public:
+  StateBase(const std::string& name_, std::uint32_t instance_ = 0)
+    : state_id{AsyncLogger::instance().register_state(name_)}, instance{instance_} {}
+
+  template <typename Event, typename FSM>
+  void on_entry(const Event&, FSM&) { record(LogRecord::entry, event_id<Event>::value); }
+
+  template <typename Event, typename FSM>
+  void on_exit(const Event&, FSM&)  { record(LogRecord::exit,  event_id<Event>::value); }
+
+  std::uint32_t get_instance() const { return instance; }
+
+private:
+  void record(LogRecord::Kind kind, std::uint8_t event) {
+    const std::uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(PluggableClock::now().time_since_epoch()).count();
+    if (TraceRecorder *trace = TraceRecorder::current())
+      trace->record(now, kind, state_id, event, instance);
+    AsyncLogger::instance().log(kind, state_id, event, instance, now);
+  }
+
+  std::uint16_t state_id;
+  std::uint32_t instance;
+
+};
+
+
+
+////////////////////////
+// state with lifetime-timers
+//
+// While deferred (see StateMachine::process_events()) the timer is not started on entry:
+// only the expiry is noted, and flush_timer() starts it at the end of the batch. So only the
+// last re-arm of a batch reaches the io_service.
+////////////////////////
+struct StateTime : public StateBase {
+  StateTime(const std::string &name, std::chrono::steady_clock::duration max_lifetime_, boost::asio::io_service &io_service_, bool timer_running_,
+            std::uint32_t instance = 0)
+    : StateBase{name, instance}, max_lifetime{max_lifetime_}, timer{io_service_}, timer_running{timer_running_},
+      deferred{false}, pending{false}, waiting{false} {}
+
+  template <typename Event, typename FSM> // see overloads below
+  void on_entry(const Event &event, FSM &fsm) {
+    if (timer_running)
+      arm(PluggableClock::now() + max_lifetime, fsm);
+    StateBase::on_entry(event, fsm);
+  }
+
+  template <typename FSM> // overload: specializing Event to DEventTimeout
+  void on_entry(const DEventTimeout &event, FSM &fsm) {
+    if (timer_running)
+      arm(event.data.time_point + max_lifetime, fsm, true);
+    StateBase::on_entry(event, fsm);
+  }
+
+  template <typename FSM> // overload: specializing Event to EventT (toggle timer) -- this is currently not called (see set_timer_running() below)
+  void on_entry(const EventT &event, FSM &fsm) {
+    if (timer_running) {
+      arm(PluggableClock::now() + max_lifetime, fsm);
+    } else {
+      disarm();
+    }
+    // StateBase::on_entry(event, fsm); // don't call this line, or we would print entry to a state, in which we are already in
+  }
+
+  template <typename Event, typename FSM>
+  void on_exit(const Event &event, FSM &fsm) {
+    disarm();
+    StateBase::on_exit(event, fsm);
+  }
+
+  template <typename FSM>
+  void set_timer_running(bool run, FSM &fsm, bool active) {
+    timer_running = run;
+    if (timer_running) {
+      if (active) {
+        /* because of the following, we don't send EventT into the state itself
+           (see overload specializing Event to EventT)
+        */
+        arm(PluggableClock::now() + max_lifetime, fsm);
+      }
+    } else {
+      disarm();
+    }
+  }
+
+  // batch mode: note expiries only; flush_timer() starts the timer (if still wanted)
+  void defer_timer(bool defer) { deferred = defer; }
+
+  // deadline of the lifetime-timer (valid in the active state, while the timer is running)
+  std::chrono::steady_clock::time_point deadline() const { return expiry; }
+
+  /* warm restart (see StateMachine::restore()): no entry action; the active state re-arms its
+     timer at the deadline of the snapshot (snapshot_no_deadline: a full lifetime from now) */
+  template <typename FSM>
+  void restore(bool run, std::int64_t deadline_ns, FSM &fsm, bool active) {
+    disarm();
+    timer_running = run;
+    if (timer_running && active)
+      arm((deadline_ns == snapshot_no_deadline) ? PluggableClock::now() + max_lifetime
+                                                : std::chrono::steady_clock::time_point{std::chrono::nanoseconds{deadline_ns}}, fsm);
+  }
+
+  template <typename FSM>
+  void flush_timer(FSM &fsm) {
+    if (pending) {
+      pending = false;
+      timer.expires_at(expiry);
+      start_timer(fsm);
+    }
+  }
+
+private:
+  static std::int64_t to_ns(std::chrono::steady_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+  }
+
+  // from_timeout: expiry_ is the previous deadline + max_lifetime (see TimerStats)
+  template <typename FSM>
+  void arm(std::chrono::steady_clock::time_point expiry_, FSM &fsm, bool from_timeout = false) {
+    if (from_timeout)
+      fsm.timer_stats().rearmed(std::chrono::duration_cast<std::chrono::nanoseconds>(max_lifetime).count());
+    else
+      fsm.timer_stats().armed(to_ns(expiry_));
+    expiry  = expiry_;
+    pending = true;
+    if (!deferred)
+      flush_timer(fsm);
+  }
+
+  void disarm() {
+    pending = false;
+    if (waiting) {
+      timer.cancel();
+      waiting = false;
+    }
+  }
+
+  /* a wait that expired just before it was cancelled completes with success all the same: after
+     disarm() (not waiting) or a re-arm (deadline ahead) it is outdated and ignored */
+  template <typename FSM>
+  void timeout(const boost::system::error_code &err, FSM &fsm) {
+    if (err == boost::system::errc::success && waiting && timer.expires_at() <= PluggableClock::now()) {
+      waiting = false;
+      fsm.timer_stats().fired(to_ns(timer.expires_at()), to_ns(PluggableClock::now()));
+      fsm.process_event(DEventTimeout{{timer.expires_at()}});
+    }
+  }
+
+  template <typename FSM>
+  void start_timer(FSM &fsm) {
+      waiting = true;
+      timer.async_wait(make_recycling_handler(handler_memory,  // no heap allocation per wait
+                                              std::bind(&StateTime::timeout<FSM>, this, std::placeholders::_1, std::ref(fsm))));
+  }
+
+private:
+  std::chrono::steady_clock::duration max_lifetime;
+  PluggableTimer timer;                         // steady_timer, or virtual time (see pluggable_clock.h)
+  bool timer_running;
+
+  bool deferred;                                // batch mode
+  bool pending;                                 // expiry noted, timer not started yet
+  bool waiting;                                 // async_wait outstanding
+  std::chrono::steady_clock::time_point expiry; // of the pending timer
+
+  HandlerMemory handler_memory;                 // for the completion handlers of timer
+};
+
+// ##### StatePing #####
+struct StatePing : public StateTime {
+  using StateTime::StateTime;
+};
+
+// ##### StatePong #####
+struct StatePong : public StateTime {
+  using StateTime::StateTime;
+};
+
+
+
+
+////////////////
+// State Machine
+//
+// The states live by value in a std::tuple; the active state is a plain index into that tuple.
+// Transitions are declared in transition_table; at compile time the table becomes a dense
+// [state][event] matrix of {target, action} (see transition_table.h), so a transition is one
+// indexed load and one call: no RTTI, no if-chains. start() / stop() find on_entry / on_exit
+// of the active state through constexpr tables of function-pointers (one table per event-type).
+////////////////
+class StateMachine : public StateBase {
+public:
+  using States = std::tuple<StatePing, StatePong>;
+  using Events = std::tuple<EventI, EventO, EventX, EventT, EventQ, DEventTimeout>; // in EventID order
+  using Tagged = TaggedEvent;
+
+  // lifetimes: of the 2 phases of ring 0 of config (see ring_config.h; rings of more phases: see timed_ring.h)
+  StateMachine(const std::string& name_, boost::asio::io_service &io_service_, std::uint32_t instance = 0,
+               const RingConfig &config = RingConfig::current()) :
+    StateBase{name_, instance}, timer_running{true},
+    states{StatePing{"statePing", ping_pong_lifetime(config, 0), io_service_, timer_running, instance},
+           StatePong{"statePong", ping_pong_lifetime(config, 1), io_service_, timer_running, instance}},
+    current_state{index_of<StatePing>()} {}
+
+  void start()
+  {
+    // enter initial state
+    enter_state(0);
+  }
+
+  void stop()
+  {
+    leave_state(0);
+  }
+
+private:
+  /*
+    .       EventT
+    state ----------|
+  */
+  struct ToggleTimer {
+    void operator()(StateMachine &sm, const EventT &) const {
+      sm.timer_running = !sm.timer_running;
+      sm.get_state<StatePing>().set_timer_running(sm.timer_running, sm, sm.is_active<StatePing>());
+      sm.get_state<StatePong>().set_timer_running(sm.timer_running, sm, sm.is_active<StatePong>());
+    }
+  };
+
+  /*
+    .       EventQ
+    state ----------|  (the active state is left; no state is entered)
+  */
+  struct Stop {
+    void operator()(StateMachine &sm, const EventQ &) const { sm.stop(); }
+  };
+
+public:
+  using transition_table = TransitionTable<
+    //  Source     Event          Target     Action
+    Row<AnyState,  EventI,        StatePing>,                 // state -> statePing
+    Row<AnyState,  EventO,        StatePong>,                 // state -> statePong
+    Row<StatePing, EventX,        StatePong>,
+    Row<StatePong, EventX,        StatePing>,
+    Row<StatePing, DEventTimeout, StatePong>,                 // lifetime over
+    Row<StatePong, DEventTimeout, StatePing>,
+    Row<AnyState,  EventT,        NoTarget,  ToggleTimer>,
+    Row<AnyState,  EventQ,        NoTarget,  Stop>
+  >;
+
+  template <typename Event>
+  void process_event(const Event &) {
+    process_event(TaggedEvent{static_cast<EventID>(event_id<Event>::value), {}});
+  }
+
+  void process_event(const DEventTimeout &event) {
+    process_event(TaggedEvent{eidTimeout, event.data});
+  }
+
+  void process_event(const EventQ &) {
+    process_event(TaggedEvent{eidQ, {}});
+  }
+
+  // the event-type of a TaggedEvent
+  template <typename Event>
+  static Event untag(const TaggedEvent &event) {
+    if constexpr (std::is_same<Event, DEventTimeout>::value)
+      return DEventTimeout{event.data};
+    else
+      return Event{};
+  }
+
+  // runtime-tagged event: one cell of the transition matrix
+  void process_event(const TaggedEvent &event) {
+    if (static_cast<std::size_t>(event.eid) < std::tuple_size<Events>::value)
+      transition_matrix<StateMachine>[current_state][event.eid].action(*this, event);
+  }
+
+  /* batch: every event runs to completion, in order. Across the batch, timers are re-armed
+     once (the last re-arm takes effect) */
+  void process_events(Span<const TaggedEvent> events) {
+    std::apply([](auto &... state) { (state.defer_timer(true), ...); }, states);
+
+    for (const TaggedEvent &event : events)
+      process_event(event);
+
+    std::apply([this](auto &... state) { (state.defer_timer(false), ...); (state.flush_timer(*this), ...); }, states);
+  }
+
+  template <typename State>
+  State &get_state() { return std::get<State>(states); }
+
+  template <typename State>
+  bool is_active() const { return current_state == index_of<State>(); }
+
+  // accuracy of the timeouts (see timer_stats.h)
+  TimerStats &timer_stats() { return stats; }
+
+  // current state, timer_running and the deadline of the running timer (see snapshot_file.h)
+  MachineSnapshot snapshot() const {
+    MachineSnapshot snap{snapshot_no_deadline, get_instance(), static_cast<std::uint8_t>(current_state), timer_running, 0};
+    if (timer_running)
+      snap.deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(active_state().deadline().time_since_epoch()).count();
+    return snap;
+  }
+
+  /* warm restart, instead of start(): continue in the state of the snapshot (without entry
+     actions). A running timer is re-armed at its original deadline, so chains of timeouts go on
+     without drift; a deadline that passed during the restart fires at once.
+     clock_offset_ns: see SnapshotReader::clock_offset_ns() */
+  void restore(const MachineSnapshot &snap, std::int64_t clock_offset_ns = 0) {
+    timer_running = (snap.timer_running != 0);
+    current_state = (snap.state < num_states) ? snap.state : 0;
+    const std::int64_t deadline_ns = (snap.deadline_ns == snapshot_no_deadline) ? snap.deadline_ns : snap.deadline_ns + clock_offset_ns;
+    const StateTime *active = &active_state();
+    std::apply([&](auto &... state) { (state.restore(timer_running, deadline_ns, *this, &state == active), ...); }, states);
+  }
+
+
+private:
+
+  static std::chrono::nanoseconds ping_pong_lifetime(const RingConfig &config, std::size_t phase) {
+    config.require_phases(0, num_states, "statePing, statePong");
+    return config.lifetime(0, phase);
+  }
+
+  // the active state (every state is a StateTime)
+  const StateTime &active_state() const {
+    return std::apply([this](const auto &... state) -> const StateTime & {
+        const StateTime *all[] = {&state...};
+        return *all[current_state];
+      }, states);
+  }
+
+  static constexpr std::size_t num_states = std::tuple_size<States>::value;
+
+  // position of State in the tuple States (compile-time)
+  template <typename State, std::size_t I = 0>
+  static constexpr std::size_t index_of() {
+    static_assert(I < num_states, "State is not part of StateMachine::States");
+    if constexpr (std::is_same<State, std::tuple_element_t<I, States>>::value)
+      return I;
+    else
+      return index_of<State, I + 1>();
+  }
+
+  template <typename Event>
+  using Dispatch = void (*)(StateMachine &, const Event &);
+
+  template <std::size_t I, typename Event>
+  static void entry_of(StateMachine &sm, const Event &event) { std::get<I>(sm.states).on_entry(event, sm); }
+
+  template <std::size_t I, typename Event>
+  static void exit_of(StateMachine &sm, const Event &event)  { std::get<I>(sm.states).on_exit(event, sm); }
+
+  template <typename Event, std::size_t... I>
+  static constexpr std::array<Dispatch<Event>, num_states> make_entry_table(std::index_sequence<I...>) { return {{ &entry_of<I, Event>... }}; }
+
+  template <typename Event, std::size_t... I>
+  static constexpr std::array<Dispatch<Event>, num_states> make_exit_table(std::index_sequence<I...>)  { return {{ &exit_of<I, Event>... }}; }
+
+  // dispatch tables: [current_state] -> on_entry / on_exit of that state, for a given Event
+  template <typename Event>
+  static constexpr std::array<Dispatch<Event>, num_states> entry_table = make_entry_table<Event>(std::make_index_sequence<num_states>{});
+
+  template <typename Event>
+  static constexpr std::array<Dispatch<Event>, num_states> exit_table  = make_exit_table<Event>(std::make_index_sequence<num_states>{});
+
+
+  template <typename Event>
+  void enter_state(const Event& event) {
+    entry_table<Event>[current_state](*this, event);
+  }
+
+  template <typename Event>
+  void leave_state(const Event& event) {
+    // leave old state
+    exit_table<Event>[current_state](*this, event);
+  }
+
+  friend class TransitionMatrix<StateMachine>;
+
+  bool timer_running;
+  States states;
+
+  std::size_t current_state;
+
+  TimerStats stats;
+
+};
+
+// the table, lowered (checked at compile time)
+static_assert(transition_matrix<StateMachine>[0][eidX].target == 1 && transition_matrix<StateMachine>[1][eidX].target == 0 &&
+              transition_matrix<StateMachine>[1][eidI].target == 0 && transition_matrix<StateMachine>[0][eidT].target == 0,
+              "StateMachine::transition_table");
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef TIMED_RING_H
+#define TIMED_RING_H
+
+#include <string>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"   // events, StateBase's logging
+#include "ring_config.h"
+
+
+
+////////////////
+// RingPhases: the phases of a RingConfig as TimedRing needs them, shared by all machines
+//
+// One flat array of log ids (AsyncLogger::register_state() of every phase name) next to the
+// flat lifetimes of the config. Build it once (per thread: register_state() takes a mutex).
+////////////////
+class RingPhases {
+public:
+  explicit RingPhases(const RingConfig &config_ = RingConfig::current()) : config{config_} {
+    log_ids.reserve(config.all_phase_names().size());
+    for (const std::string &name : config.all_phase_names())
+      log_ids.push_back(AsyncLogger::instance().register_state(name));
+  }
+
+  std::size_t num_rings() const { return config.num_rings(); }
+  std::size_t num_phases(std::size_t ring) const { return config.num_phases(ring); }
+  std::chrono::nanoseconds lifetime(std::size_t ring, std::size_t phase) const { return config.lifetime(ring, phase); }
+  std::uint16_t log_id(std::size_t ring, std::size_t phase) const { return log_ids[config.first(ring) + phase]; }
+
+private:
+  RingConfig config;
+  std::vector<std::uint16_t> log_ids;  // flat, as the lifetimes of config
+};
+
+
+
+////////////////
+// TimedRing: StateTime generalized to a whole ring of phases (see ring_config.h)
+//
+// One machine, one timer, any number of phases: the current phase is an index and the
+// lifetimes are looked up in the shared RingPhases, so a ring of 64 phases costs what one of 2
+// costs. The lifetime-timer is re-armed on every transition; a timeout goes on to the next
+// phase with zero drift (the next deadline is the expired one + lifetime, see DEventTimeout).
+//
+//   DEventTimeout, EventX    phase -> next phase (after the last: phase 0)
+//   EventI                   phase -> phase 0
+//   EventO                   phase -> phase 1
+//   EventT                   timer on / off (no transition)
+//   EventQ                   leave the current phase
+//
+// Entries and exits are logged and traced as the states of StateMachine do. TimerStats are
+// optional and may be shared by many rings (set_timer_stats()).
+////////////////
+class TimedRing {
+public:
+  TimedRing(boost::asio::io_service &io_service, const RingPhases &phases_, std::uint16_t ring_ = 0, std::uint32_t instance_ = 0) :
+    phases{phases_}, timer{io_service}, instance{instance_}, ring{ring_}, phase{0}, timer_running{true}, waiting{false}
+  {
+    if (ring >= phases.num_rings())
+      throw std::runtime_error{"TimedRing: no ring " + std::to_string(ring) + " in the ring config"};
+  }
+
+  TimedRing(const TimedRing &) = delete;
+  TimedRing &operator=(const TimedRing &) = delete;
+
+  // enter phase 0
+  void start() { enter(0, LogRecord::no_event, PluggableClock::now()); }
+
+  void stop() { leave(LogRecord::no_event); }
+
+  void process_event(const EventI &)                { change_to(0, eidI, PluggableClock::now()); }
+  void process_event(const EventO &)                { change_to(1 % num_phases(), eidO, PluggableClock::now()); }
+  void process_event(const EventX &)                { change_to(next(), eidX, PluggableClock::now()); }
+  void process_event(const DEventTimeout &event)    { change_to(next(), eidTimeout, event.data.time_point); }
+  void process_event(const EventQ &)                { stop(); }
+
+  void process_event(const EventT &) {
+    timer_running = !timer_running;
+    if (timer_running)
+      arm(PluggableClock::now() + lifetime());
+    else
+      disarm();
+  }
+
+  void process_event(const TaggedEvent &event) {
+    switch (event.eid) {
+    case eidI:       process_event(EventI{}); break;
+    case eidO:       process_event(EventO{}); break;
+    case eidX:       process_event(EventX{}); break;
+    case eidT:       process_event(EventT{}); break;
+    case eidQ:       process_event(EventQ{}); break;
+    case eidTimeout: process_event(DEventTimeout{event.data}); break;
+    default:         break;
+    }
+  }
+
+  std::size_t   get_phase() const { return phase; }
+  std::uint16_t get_ring()  const { return ring; }
+  std::size_t   num_phases() const { return phases.num_phases(ring); }
+  bool is_timer_running() const { return timer_running; }
+
+  // deadline of the lifetime-timer (while it is running)
+  std::chrono::steady_clock::time_point deadline() const { return expiry; }
+
+  void set_timer_stats(TimerStats *stats_) { stats = stats_; }
+
+private:
+  static std::int64_t to_ns(std::chrono::steady_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+  }
+
+  std::chrono::nanoseconds lifetime() const { return phases.lifetime(ring, phase); }
+
+  std::uint8_t next() const {
+    const std::size_t p = phase + std::size_t{1};
+    return static_cast<std::uint8_t>((p == num_phases()) ? 0 : p);
+  }
+
+  // base: when the lifetime of the new phase starts (the expired deadline, after a timeout)
+  void change_to(std::size_t p, std::uint8_t event, std::chrono::steady_clock::time_point base) {
+    leave(event);
+    enter(p, event, base);
+  }
+
+  void enter(std::size_t p, std::uint8_t event, std::chrono::steady_clock::time_point base) {
+    phase = static_cast<std::uint8_t>(p);
+    if (timer_running)
+      arm(base + lifetime(), event == eidTimeout);
+    record(LogRecord::entry, event);
+  }
+
+  void leave(std::uint8_t event) {
+    disarm();
+    record(LogRecord::exit, event);
+  }
+
+  void record(LogRecord::Kind kind, std::uint8_t event) const {
+    const std::uint64_t now = static_cast<std::uint64_t>(to_ns(PluggableClock::now()));
+    if (TraceRecorder *trace = TraceRecorder::current())
+      trace->record(now, kind, phases.log_id(ring, phase), event, instance);
+    AsyncLogger::instance().log(kind, phases.log_id(ring, phase), event, instance, now);
+  }
+
+  void arm(std::chrono::steady_clock::time_point expiry_, bool from_timeout = false) {
+    if (stats) {
+      if (from_timeout)
+        stats->rearmed(std::chrono::duration_cast<std::chrono::nanoseconds>(lifetime()).count());
+      else
+        stats->armed(to_ns(expiry_));
+    }
+    expiry = expiry_;
+    timer.expires_at(expiry);
+    waiting = true;
+    timer.async_wait(make_recycling_handler(handler_memory,  // no heap allocation per wait
+                                            std::bind(&TimedRing::timeout, this, std::placeholders::_1)));
+  }
+
+  void disarm() {
+    if (waiting) {
+      timer.cancel();
+      waiting = false;
+    }
+  }
+
+  // (a stale completion, after disarm() or a re-arm: see StateTime::timeout())
+  void timeout(const boost::system::error_code &err) {
+    if (err == boost::system::errc::success && waiting && expiry <= PluggableClock::now()) {
+      waiting = false;
+      if (stats)
+        stats->fired(to_ns(expiry), to_ns(PluggableClock::now()));
+      process_event(DEventTimeout{{expiry}});
+    }
+  }
+
+  const RingPhases &phases;
+  PluggableTimer timer;                          // the only timer, whatever the number of phases
+  std::chrono::steady_clock::time_point expiry;  // of the running timer
+  TimerStats *stats = nullptr;
+  std::uint32_t instance;
+  std::uint16_t ring;
+  std::uint8_t  phase;
+  bool timer_running;
+  bool waiting;                                  // async_wait outstanding
+
+  HandlerMemory handler_memory;                  // for the completion handlers of timer
+};
+
+#endif
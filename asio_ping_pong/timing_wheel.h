@@ -0,0 +1,324 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+
+
+////////////////
+// TimingWheel
+//
+// Hierarchical timing wheel (4 levels of 256 slots, like the classic kernel timer wheel) for
+// timers addressed by id [0, capacity). arm / cancel are O(1); entries further away than
+// 256 ticks are cascaded down level by level as time advances.
+//
+// Timers fire at tick granularity (never early, at most one tick late), but the callback
+// receives the exact deadline that was armed: so the next deadline can be computed as
+// deadline + max_lifetime, and there is *no* drift (see DEventTimeout).
+////////////////
+class TimingWheel {
+public:
+  using clock      = std::chrono::steady_clock;
+  using time_point = clock::time_point;
+  using duration   = clock::duration;
+  using TimerID    = std::uint32_t;
+
+  static constexpr unsigned    slot_bits  = 8;
+  static constexpr unsigned    num_slots  = 1u << slot_bits;   // per level
+  static constexpr unsigned    num_levels = 4;
+  static constexpr TimerID     nil        = ~TimerID{0};
+
+  TimingWheel(std::size_t capacity, duration tick_ = std::chrono::milliseconds(1), time_point origin_ = clock::now()) :
+    tick{tick_}, origin{origin_}, next_tick{0}, count{0},
+    expiry(capacity), deadline(capacity), next(capacity, nil), prev(capacity, nil), list(capacity, unlinked)
+  {
+    head.fill(nil);
+    for (auto &level : occupied)
+      level.fill(0);
+  }
+
+  // (re)arm timer id to fire at deadline_
+  void arm(TimerID id, time_point deadline_) {
+    if (list[id] != unlinked)
+      unlink(id);
+    else
+      ++count;
+    deadline[id] = deadline_;
+    expiry[id]   = to_tick_ceil(deadline_);
+    place(id);
+    if (on_earlier && deadline_ < scheduled)
+      on_earlier(deadline_);
+  }
+
+  void cancel(TimerID id) {
+    if (list[id] != unlinked) {
+      unlink(id);
+      --count;
+    }
+  }
+
+  bool is_armed(TimerID id) const { return list[id] != unlinked; }
+
+  std::size_t size()     const { return count; }
+  std::size_t capacity() const { return list.size(); }
+
+  /* fire every timer whose tick is due at now: fire(id, deadline)
+     fire() may arm / cancel any timer (also the one that fires, or one due with it: the due ones
+     wait in a list of their own, a cancelled one is not fired). Returns number of timers fired */
+  template <typename Fire>
+  std::size_t advance(time_point now, Fire &&fire) {
+    const std::uint64_t now_tick = to_tick_floor(now);
+    std::size_t fired = 0;
+    while (next_tick <= now_tick) {
+      if (count == 0) {
+        next_tick = now_tick + 1; // empty wheel: nothing to cascade, jump
+        break;
+      }
+      const std::uint64_t skip = ticks_to_next_event();
+      if (skip > 0) {
+        next_tick += std::min<std::uint64_t>(skip, now_tick + 1 - next_tick);
+        continue;
+      }
+
+      const unsigned idx = next_tick & (num_slots - 1);
+      if (idx == 0)
+        cascade(1);
+
+      make_due(slot_index(0, idx));
+      ++next_tick;
+      for (TimerID id; (id = head[due_list]) != nil; ) {
+        unlink(id);
+        --count;
+        ++fired;
+        fire(id, deadline[id]);
+      }
+    }
+    return fired;
+  }
+
+  /* time at which advance() has work to do next (time_point::max() if the wheel is empty):
+     the earliest armed timer, or an earlier cascade point of the upper levels */
+  time_point next_expiry() const {
+    if (count == 0)
+      return time_point::max();
+    return tick_time(next_tick + ticks_to_next_event());
+  }
+
+  time_point tick_time(std::uint64_t tick_no) const { return origin + static_cast<duration::rep>(tick_no) * tick; }
+
+  // called when a timer is armed earlier than the time given to set_scheduled() (e.g. to re-arm an asio timer)
+  void set_on_earlier(std::function<void(time_point)> f) { on_earlier = std::move(f); }
+  void set_scheduled(time_point t) { scheduled = t; }
+
+private:
+  static constexpr std::uint32_t unlinked = ~std::uint32_t{0};
+  static constexpr std::uint32_t due_list = num_slots * num_levels;  // (after the slots: no bit in occupied)
+
+  static constexpr std::uint32_t slot_index(unsigned level, unsigned idx) { return level * num_slots + idx; }
+
+  std::uint64_t to_tick_ceil(time_point t) const {
+    if (t <= origin)
+      return 0;
+    const auto d = (t - origin).count();
+    return static_cast<std::uint64_t>((d + tick.count() - 1) / tick.count());
+  }
+
+  std::uint64_t to_tick_floor(time_point t) const {
+    if (t <= origin)
+      return 0;
+    return static_cast<std::uint64_t>((t - origin).count() / tick.count());
+  }
+
+  // put armed timer id into the slot matching its expiry (relative to next_tick)
+  void place(TimerID id) {
+    std::uint64_t e = expiry[id];
+    if (e < next_tick)
+      e = next_tick;          // already due: fire with the next tick
+    const std::uint64_t delta = e - next_tick;
+
+    unsigned level = 0;
+    while (level + 1 < num_levels && delta >= (std::uint64_t{1} << (slot_bits * (level + 1))))
+      ++level;
+    unsigned idx;
+    if (delta >= (std::uint64_t{1} << (slot_bits * num_levels)))
+      idx = ((next_tick >> (slot_bits * level)) - 1) & (num_slots - 1); // beyond range: park in last slot of top level
+    else
+      idx = (e >> (slot_bits * level)) & (num_slots - 1);
+
+    push(id, slot_index(level, idx));
+  }
+
+  void push(TimerID id, std::uint32_t s) {
+    const TimerID h = head[s];
+    next[id] = h;
+    prev[id] = nil;
+    if (h != nil)
+      prev[h] = id;
+    head[s] = id;
+    list[id] = s;
+    set_bit(s);
+  }
+
+  void unlink(TimerID id) {
+    const std::uint32_t s = list[id];
+    if (prev[id] != nil) next[prev[id]] = next[id];
+    else                 head[s]        = next[id];
+    if (next[id] != nil) prev[next[id]] = prev[id];
+    list[id] = unlinked;
+    if (head[s] == nil && s != due_list)
+      clear_bit(s);
+  }
+
+  // take the whole list of slot s (entries keep list[] until handled by the caller)
+  TimerID detach(std::uint32_t s) {
+    const TimerID h = head[s];
+    head[s] = nil;
+    clear_bit(s);
+    return h;
+  }
+
+  // move the whole list of slot s to the due list (empty: advance() fires it till empty)
+  void make_due(std::uint32_t s) {
+    for (TimerID id = head[s]; id != nil; id = next[id])
+      list[id] = due_list;
+    head[due_list] = head[s];
+    head[s] = nil;
+    clear_bit(s);
+  }
+
+  // move the entries of the current slot of level (and above, at wrap-around) one level down
+  void cascade(unsigned level) {
+    if (level >= num_levels)
+      return;
+    const unsigned idx = (next_tick >> (slot_bits * level)) & (num_slots - 1);
+    if (idx == 0)
+      cascade(level + 1);
+    TimerID id = detach(slot_index(level, idx));
+    while (id != nil) {
+      const TimerID following = next[id];
+      place(id);
+      id = following;
+    }
+  }
+
+  void set_bit(std::uint32_t s)   { occupied[s / num_slots][(s % num_slots) / 64] |=  (std::uint64_t{1} << (s % 64)); }
+  void clear_bit(std::uint32_t s) { occupied[s / num_slots][(s % num_slots) / 64] &= ~(std::uint64_t{1} << (s % 64)); }
+
+  bool upper_levels_empty() const {
+    for (unsigned level = 1; level < num_levels; ++level)
+      for (auto word : occupied[level])
+        if (word)
+          return false;
+    return true;
+  }
+
+  /* number of ticks from next_tick that advance() can skip: no occupied level-0 slot
+     and (if the upper levels hold entries) no cascade point in between */
+  std::uint64_t ticks_to_next_event() const {
+    const unsigned idx = next_tick & (num_slots - 1);
+    std::uint64_t skip = num_slots;
+    if (!upper_levels_empty())
+      skip = (num_slots - idx) & (num_slots - 1);   // distance to the next wrap-around of level 0
+    for (std::uint64_t i = 0; i < skip; ) {
+      const unsigned s = (idx + i) & (num_slots - 1);
+      const std::uint64_t word = occupied[0][s / 64] >> (s % 64);
+      if (word)
+        return std::min<std::uint64_t>(skip, i + __builtin_ctzll(word));
+      i += 64 - (s % 64);
+    }
+    return skip;
+  }
+
+  duration      tick;
+  time_point    origin;
+  std::uint64_t next_tick;  // next tick to be processed by advance()
+  std::size_t   count;      // armed timers
+
+  // per timer (indexed by TimerID)
+  std::vector<std::uint64_t> expiry;    // tick
+  std::vector<time_point>    deadline;  // exact, as armed
+  std::vector<TimerID>       next;      // intrusive doubly linked slot-list
+  std::vector<TimerID>       prev;
+  std::vector<std::uint32_t> list;      // slot-list the timer is in (or unlinked)
+
+  std::array<TimerID, num_slots * num_levels + 1>                head;      // (+ due_list)
+  std::array<std::array<std::uint64_t, num_slots / 64>, num_levels> occupied; // non-empty slots
+
+  std::function<void(time_point)> on_earlier;
+  time_point scheduled = time_point::max();
+};
+
+
+
+////////////////
+// AsioTimingWheel
+//
+// Drives a TimingWheel with a single boost::asio::steady_timer: the asio timer always waits for
+// the earliest armed entry of the wheel, whatever the number of timers in the wheel.
+////////////////
+class AsioTimingWheel {
+public:
+  using time_point = TimingWheel::time_point;
+  using Fire       = std::function<void(TimingWheel::TimerID, time_point)>;
+
+  AsioTimingWheel(boost::asio::io_service &io_service, TimingWheel &wheel_, Fire fire_) :
+    wheel{wheel_}, timer{io_service}, fire{std::move(fire_)}, waiting{false}, stopped{false}
+  {
+    wheel.set_on_earlier([this](time_point t) { schedule(t); });
+  }
+
+  ~AsioTimingWheel() { wheel.set_on_earlier(nullptr); }
+
+  // (re)start waiting for the earliest armed timer; call after arming timers while the io_service was not running
+  void start() {
+    stopped = false;
+    schedule(wheel.next_expiry());
+  }
+
+  void stop() {
+    stopped = true;  // (a completion already queued cannot be cancelled: it must not re-arm)
+    timer.cancel();
+    waiting = false;
+    wheel.set_scheduled(time_point::min()); // no more wakeups
+  }
+
+private:
+  void schedule(time_point t) {
+    if (t == time_point::max() || stopped)
+      return;
+    if (waiting && timer.expires_at() <= t)
+      return;
+    timer.expires_at(t);
+    wheel.set_scheduled(t);
+    waiting = true;
+    timer.async_wait([this](const boost::system::error_code &err) {
+        if (err == boost::system::errc::success && !stopped)
+          timeout();
+      });
+  }
+
+  void timeout() {
+    waiting = false;
+    wheel.set_scheduled(time_point::min()); // no on_earlier() for timers armed by fire(): we reschedule below
+    wheel.advance(TimingWheel::clock::now(), fire);
+    wheel.set_scheduled(time_point::max());
+    schedule(wheel.next_expiry());
+  }
+
+  TimingWheel &wheel;
+  boost::asio::steady_timer timer;
+  Fire fire;
+  bool waiting;
+  bool stopped;
+};
+
+#endif
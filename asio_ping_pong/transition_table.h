@@ -0,0 +1,168 @@
+#ifndef TRANSITION_TABLE_H
+#define TRANSITION_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+
+////////////////
+// Transition table (declarative, like MSM's transition_table, but without Boost)
+//
+//   using transition_table = TransitionTable<
+//     //  Source     Event   Target     Action
+//     Row<StatePing, EventX, StatePong>,
+//     Row<AnyState,  EventI, StatePing>,
+//     Row<AnyState,  EventT, NoTarget,  ToggleTimer>
+//   >;
+//
+// Source AnyState: the row applies in every state (a self-transition in Target itself: exit
+// and entry actions run). Target NoTarget: internal transition (only the Action runs). Rows
+// are searched in order; the first one that matches a state and event is taken.
+//
+// TransitionMatrix<FSM> lowers the table at compile time into transition_matrix<FSM>, a dense
+// [state][event] array of cells {target index, action pointer}: dispatch is one indexed load
+// and one indirect call. Every cell has its own action function with source, target, event-type and Action
+// built in (exit of the source, Action, entry of the target: the order of MSM).
+//
+// FSM provides:
+//   States                  std::tuple of the states (member states of that type)
+//   Events                  std::tuple of the event-types, column i = event id i
+//   Tagged                  runtime event (id + data)
+//   transition_table        TransitionTable<Row...>
+//   untag<Event>(tagged)    static: the Event of a Tagged
+//   current_state           index into States
+// and befriends TransitionMatrix<FSM>.
+////////////////
+struct AnyState {};
+
+struct NoTarget {};
+
+struct NoAction {
+  template <typename FSM, typename Event>
+  void operator()(FSM &, const Event &) const {}
+};
+
+template <typename Source_, typename Event_, typename Target_, typename Action_ = NoAction>
+struct Row {
+  using Source = Source_;
+  using Event  = Event_;
+  using Target = Target_;
+  using Action = Action_;
+
+  template <typename S, typename E>
+  static constexpr bool matches = (std::is_same<Source, S>::value || std::is_same<Source, AnyState>::value) &&
+                                  std::is_same<Event_, E>::value;
+};
+
+template <typename... Rows>
+struct TransitionTable {};
+
+
+namespace transition_detail {
+
+// first row of Rows... matching State and Event (void: none)
+template <typename State, typename Event, typename... Rows>
+struct find_row { using type = void; };
+
+template <typename State, typename Event, typename R, typename... Rows>
+struct find_row<State, Event, R, Rows...> {
+  using type = std::conditional_t<R::template matches<State, Event>, R, typename find_row<State, Event, Rows...>::type>;
+};
+
+template <typename State, typename Event, typename Table>
+struct find_in_table;
+
+template <typename State, typename Event, typename... Rows>
+struct find_in_table<State, Event, TransitionTable<Rows...>> : find_row<State, Event, Rows...> {};
+
+// position of T in the tuple Tuple
+template <typename T, typename Tuple, std::size_t I = 0>
+constexpr std::size_t index_in() {
+  static_assert(I < std::tuple_size<Tuple>::value, "type is not part of the tuple");
+  if constexpr (std::is_same<T, std::tuple_element_t<I, Tuple>>::value)
+    return I;
+  else
+    return index_in<T, Tuple, I + 1>();
+}
+
+} // namespace transition_detail
+
+
+
+template <typename FSM>
+class TransitionMatrix {
+public:
+  using States = typename FSM::States;
+  using Events = typename FSM::Events;
+  using Tagged = typename FSM::Tagged;
+
+  static constexpr std::size_t num_states = std::tuple_size<States>::value;
+  static constexpr std::size_t num_events = std::tuple_size<Events>::value;
+  static_assert(num_states <= 256, "state index of a cell is 8 bits");
+
+  using Action = void (*)(FSM &, const Tagged &);
+
+  struct Cell {
+    std::uint8_t target;  // state after the event (the same state: internal transition or no row)
+    Action       action;
+  };
+
+  using Matrix = std::array<std::array<Cell, num_events>, num_states>;
+
+  // (see transition_matrix below)
+  static constexpr Matrix make() { return make(std::make_index_sequence<num_states>{}); }
+
+private:
+  template <std::size_t S>
+  using State = std::tuple_element_t<S, States>;
+
+  template <std::size_t E>
+  using Event = std::tuple_element_t<E, Events>;
+
+  static void ignore(FSM &, const Tagged &) {}
+
+  template <std::size_t S, typename R>
+  static void fire(FSM &fsm, const Tagged &tagged) {
+    using Action_ = typename R::Action;
+    const typename R::Event event = FSM::template untag<typename R::Event>(tagged);
+    if constexpr (std::is_same<typename R::Target, NoTarget>::value) {
+      Action_{}(fsm, event);
+    } else {
+      constexpr std::size_t T = transition_detail::index_in<typename R::Target, States>();
+      std::get<S>(fsm.states).on_exit(event, fsm);
+      Action_{}(fsm, event);
+      fsm.current_state = T;
+      std::get<T>(fsm.states).on_entry(event, fsm);
+    }
+  }
+
+  template <std::size_t S, std::size_t E>
+  static constexpr Cell make_cell() {
+    using R = typename transition_detail::find_in_table<State<S>, Event<E>, typename FSM::transition_table>::type;
+    if constexpr (std::is_void<R>::value)
+      return Cell{static_cast<std::uint8_t>(S), &ignore};
+    else if constexpr (std::is_same<typename R::Target, NoTarget>::value)
+      return Cell{static_cast<std::uint8_t>(S), &fire<S, R>};
+    else
+      return Cell{static_cast<std::uint8_t>(transition_detail::index_in<typename R::Target, States>()), &fire<S, R>};
+  }
+
+  template <std::size_t S, std::size_t... E>
+  static constexpr std::array<Cell, num_events> make_row(std::index_sequence<E...>) { return {{ make_cell<S, E>()... }}; }
+
+  template <std::size_t... S>
+  static constexpr Matrix make(std::index_sequence<S...>) {
+    return {{ make_row<S>(std::make_index_sequence<num_events>{})... }};
+  }
+};
+
+// [current state][event id] -> cell (callers check event id < num_events)
+template <typename FSM>
+inline constexpr typename TransitionMatrix<FSM>::Matrix transition_matrix = TransitionMatrix<FSM>::make();
+
+#endif
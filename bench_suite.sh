@@ -0,0 +1,82 @@
+#!/bin/sh
+# Cross-framework benchmark suite: one comparable report for all realizations
+#
+# usage: ./bench_suite.sh [num_events] [num_instances]
+#
+# For every realization (asio, msm, and the Qt ones if qmake is found):
+#   compile_s       wall time to compile and link ping_pong from scratch (Release)
+#   binary_bytes    size of the ping_pong executable (text_bytes: its code, from size(1))
+#   events/s, p50/p99/p99.9 ns, rss/instance
+#                   from bench_headless (same synthetic event stream everywhere, see common/headless_bench.h)
+#
+# Builds go to $BUILD_DIR (default: ./_bench_suite), compiler output to $BUILD_DIR/build.log .
+
+set -e
+
+N=${1:-1000000}
+K=${2:-10000}
+ROOT=$(cd "$(dirname "$0")" && pwd)
+BUILD_DIR=${BUILD_DIR:-$ROOT/_bench_suite}
+RESULTS=$BUILD_DIR/results.txt
+LOG=$BUILD_DIR/build.log
+
+mkdir -p "$BUILD_DIR"
+: > "$RESULTS"
+: > "$LOG"
+
+now() { date +%s.%N; }
+
+text_bytes() {
+  if command -v size > /dev/null 2>&1; then size "$1" | awk 'NR == 2 { print $1 }'; else echo "-"; fi
+}
+
+# name compile_s binary_bytes text_bytes, then the bench_headless line
+record() {
+  printf '%s compile_s=%s binary_bytes=%s text_bytes=%s ' "$1" "$2" "$(stat -c %s "$3")" "$(text_bytes "$3")" >> "$RESULTS"
+  "$4" "$N" "$K" | grep '^bench_headless' >> "$RESULTS"
+}
+
+cmake_realization() {
+  name=$1; dir=$2; build=$BUILD_DIR/$name
+  echo "== $name" >&2
+  cmake -S "$ROOT/$dir" -B "$build" -DCMAKE_BUILD_TYPE=Release >> "$LOG" 2>&1
+  cmake --build "$build" --target clean >> "$LOG" 2>&1
+  t0=$(now)
+  cmake --build "$build" --target ping_pong >> "$LOG" 2>&1
+  t1=$(now)
+  cmake --build "$build" --target bench_headless >> "$LOG" 2>&1
+  record "$name" "$(awk "BEGIN { print $t1 - $t0 }")" "$build/ping_pong" "$build/bench_headless"
+}
+
+qmake_realization() {
+  name=$1; dir=$2; build=$BUILD_DIR/$name
+  echo "== $name" >&2
+  mkdir -p "$build/app" "$build/bench"
+  (cd "$build/app"   && qmake "$ROOT/$dir/project.pro"        >> "$LOG" 2>&1 && make clean >> "$LOG" 2>&1)
+  t0=$(now)
+  (cd "$build/app"   && make >> "$LOG" 2>&1)
+  t1=$(now)
+  (cd "$build/bench" && qmake "$ROOT/$dir/bench_headless.pro" >> "$LOG" 2>&1 && make >> "$LOG" 2>&1)
+  record "$name" "$(awk "BEGIN { print $t1 - $t0 }")" "$build/app/ping_pong" "$build/bench/bench_headless"
+}
+
+cmake_realization asio asio_ping_pong
+cmake_realization msm  msm/msm_ping_pong
+cmake_realization asio_coro asio_coro_ping_pong
+
+if command -v qmake > /dev/null 2>&1; then
+  qmake_realization qt                 qt_ping_pong1/qt_ping_pong
+  qmake_realization qt_event_templates qt_ping_pong1/qt_ping_pong_event_templates
+else
+  echo "== qt: qmake not found, skipped" >&2
+fi
+
+# the report
+echo
+echo "$N events, $K instances"
+awk '
+function val(key,   i, kv) { for (i = 2; i <= NF; ++i) { split($i, kv, "="); if (kv[1] == key) return kv[2] } return "-" }
+BEGIN { printf "%-20s %10s %12s %12s %12s %10s %10s %10s %14s\n", "realization", "compile_s", "binary_B", "text_B", "events/s", "p50_ns", "p99_ns", "p99.9_ns", "rss/instance_B" }
+{ printf "%-20s %10.1f %12s %12s %12s %10s %10s %10s %14s\n", $1, val("compile_s"), val("binary_bytes"), val("text_bytes"),
+         val("events_per_sec"), val("p50_ns"), val("p99_ns"), val("p99.9_ns"), val("rss_per_instance_bytes") }
+' "$RESULTS"
@@ -0,0 +1,269 @@
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <iostream>
+#include <string>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+
+
+/////////////////////////////////
+// LogRecord: what a state machine thread writes per entry / exit (fixed size, binary)
+/////////////////////////////////
+struct LogRecord {
+  enum Kind : std::uint8_t { entry, exit };
+
+  std::uint64_t timestamp_ns;  // steady_clock
+  std::uint32_t instance;      // machine instance id
+  std::uint16_t state;         // id from AsyncLogger::register_state()
+  std::uint8_t  event;         // event id of the implementation (no_event: none, e.g. start/stop)
+  Kind          kind;
+
+  static constexpr std::uint8_t no_event = 0xff;
+};
+
+
+/////////////////////////////////
+// AsyncLogger
+//
+// State machine threads never write to stdout themselves: log() copies a LogRecord into a
+// lock-free single-producer/single-consumer ring owned by the calling thread (no allocation
+// after the thread's first record). A background thread collects the records of all rings,
+// formats them ("Entering: statePing") and writes them in batches.
+//
+// After writing a batch the writer thread waits 1 ms for more records. If none came, it
+// sleeps on a condition variable until the next record wakes it (log() then takes the wake
+// mutex once; otherwise log() costs one more fence and load). So an idle logger does not
+// wake up, and a busy one writes a batch per ms without a system call in log().
+//
+// Drop policy: log() never blocks the machine. If the thread's ring is full (ring_capacity
+// records the writer has not caught up with), the record is dropped and counted, and the
+// writer reports "[log] N records dropped" in place of them.
+/////////////////////////////////
+class AsyncLogger {
+public:
+  static constexpr std::size_t ring_capacity = 4096; // records per thread (power of two)
+
+  static AsyncLogger &instance() {
+    static AsyncLogger logger;
+    return logger;
+  }
+
+  // register a state name (e.g. in the state's constructor); returns its id for LogRecord::state
+  std::uint16_t register_state(const std::string &name) {
+    std::lock_guard<std::mutex> lock{names_mutex};
+    auto it = state_ids.find(name);
+    if (it == state_ids.end()) {
+      it = state_ids.emplace(name, static_cast<std::uint16_t>(state_names.size())).first;
+      state_names.push_back(name);
+    }
+    return it->second;
+  }
+
+  // name of a registered state ("?" if unknown)
+  std::string state_name(std::uint16_t state) {
+    std::lock_guard<std::mutex> lock{names_mutex};
+    return (state < state_names.size()) ? state_names[state] : std::string{"?"};
+  }
+
+  // the clock of LogRecord::timestamp_ns
+  static std::uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // hot path: wait-free
+  void log(LogRecord::Kind kind, std::uint16_t state, std::uint8_t event = LogRecord::no_event, std::uint32_t instance_id = 0,
+           std::uint64_t timestamp_ns = now_ns()) {
+    Ring &ring = thread_ring();
+    const std::size_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) == ring_capacity) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    LogRecord &r = ring.records[tail & (ring_capacity - 1)];
+    r.timestamp_ns = timestamp_ns;
+    r.instance     = instance_id;
+    r.state        = state;
+    r.event        = event;
+    r.kind         = kind;
+    ring.tail.store(tail + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);  // (tail before writer_sleeping: pairs with the writer's store of it before its last look at the rings)
+    if (writer_sleeping.load(std::memory_order_relaxed))
+      wake_writer();
+  }
+
+  // block until every record logged so far (by any thread) has been written (not once the logger is being destroyed)
+  void flush() {
+    const std::uint64_t target = requested.fetch_add(1) + 1;
+    wake_writer();
+    std::unique_lock<std::mutex> lock{wake_mutex};
+    flushed.wait(lock, [&]() { return completed.load(std::memory_order_acquire) >= target || !running.load(); }); // (the writer thread may be gone)
+  }
+
+  std::uint64_t dropped_records() const { return dropped.load(std::memory_order_relaxed); }
+
+  // where the writer thread writes to (default: std::cout); nullptr: records are consumed, but not written
+  void set_output(std::ostream *os) { flush(); output.store(os); }
+
+  ~AsyncLogger() {
+    running.store(false);
+    wake_writer();
+    if (writer.joinable())
+      writer.join();
+  }
+
+private:
+  struct Ring {
+    alignas(64) std::atomic<std::size_t> head{0}; // consumer (writer thread)
+    alignas(64) std::atomic<std::size_t> tail{0}; // producer (owning thread)
+    LogRecord records[ring_capacity];
+  };
+
+  /* a Ring is allocated with its alignment: plain new only honours alignas(64) since C++17 (the
+     Qt projects include this header as C++11 / C++14) */
+  struct RingDelete {
+    void operator()(Ring *ring) const {
+      ring->~Ring();
+      std::free(ring);
+    }
+  };
+
+  static Ring *new_ring() {
+    void *p = ::aligned_alloc(alignof(Ring), sizeof(Ring)); // (sizeof is a multiple of alignof)
+    if (!p)
+      throw std::bad_alloc{};
+    return new (p) Ring;
+  }
+
+  AsyncLogger() : output{&std::cout}, running{true}, writer_sleeping{false}, dropped{0}, requested{0}, completed{0} {
+    writer = std::thread([this]() { run(); });
+  }
+
+  Ring &thread_ring() {
+    thread_local Ring *ring = nullptr;
+    if (!ring) {
+      std::lock_guard<std::mutex> lock{rings_mutex};
+      rings.emplace_back(new_ring());
+      ring = rings.back().get();   // owned by the logger: survives the thread
+    }
+    return *ring;
+  }
+
+  void wake_writer() {
+    std::lock_guard<std::mutex> lock{wake_mutex};  // (so the wake cannot fall between the writer's last look and its wait)
+    wake.notify_one();
+  }
+
+  // anything for the writer thread to do?
+  bool pending() {
+    if (!running.load() || requested.load() != completed.load())
+      return true;
+    std::lock_guard<std::mutex> lock{rings_mutex};
+    for (auto &r : rings)
+      if (r->tail.load(std::memory_order_acquire) != r->head.load(std::memory_order_relaxed))
+        return true;
+    return false;
+  }
+
+  // writer thread
+  void run() {
+    std::string buffer;
+    std::uint64_t reported_dropped = 0;
+    for (;;) {
+      const std::uint64_t req = requested.load(std::memory_order_acquire);
+      const bool stop = !running.load();
+
+      const std::size_t n = collect(buffer);
+      const std::uint64_t d = dropped.load(std::memory_order_relaxed);
+      if (d != reported_dropped) {
+        buffer += "[log] " + std::to_string(d - reported_dropped) + " records dropped\n";
+        reported_dropped = d;
+      }
+      if (!buffer.empty()) {
+        if (std::ostream *os = output.load()) {
+          os->write(buffer.data(), buffer.size());
+          os->flush();
+        }
+        buffer.clear();
+      }
+      {
+        std::lock_guard<std::mutex> lock{wake_mutex};
+        completed.store(req, std::memory_order_release);
+      }
+      flushed.notify_all();
+
+      if (stop)
+        break;
+      std::unique_lock<std::mutex> lock{wake_mutex};
+      if (n == 0) { // idle: till a record (or flush(), the end) wakes it
+        writer_sleeping.store(true);
+        wake.wait(lock, [this]() { return pending(); });
+        writer_sleeping.store(false);
+      }
+      else          // busy: more records are likely, collect them as one batch a little later
+        wake.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !running.load() || requested.load() != completed.load(); });
+    }
+  }
+
+  // format everything available in all rings into buffer; returns number of records
+  std::size_t collect(std::string &buffer) {
+    snapshot.clear();
+    {
+      std::lock_guard<std::mutex> lock{rings_mutex};
+      for (auto &r : rings)
+        snapshot.push_back(r.get());
+    }
+    std::lock_guard<std::mutex> lock{names_mutex};
+    const bool format = (output.load() != nullptr);
+    std::size_t n = 0;
+    for (Ring *ring : snapshot) {
+      const std::size_t tail = ring->tail.load(std::memory_order_acquire);
+      std::size_t head = ring->head.load(std::memory_order_relaxed);
+      if (!format) {
+        n += tail - head;
+        head = tail;
+      }
+      for (; head != tail; ++head, ++n) {
+        const LogRecord &r = ring->records[head & (ring_capacity - 1)];
+        buffer += (r.kind == LogRecord::entry) ? "Entering: " : "Leaving : ";
+        buffer += (r.state < state_names.size()) ? state_names[r.state] : std::string{"?"};
+        buffer += '\n';
+      }
+      ring->head.store(head, std::memory_order_release);
+    }
+    return n;
+  }
+
+  std::mutex rings_mutex;   // only taken on a thread's first record and by the writer
+  std::vector<std::unique_ptr<Ring, RingDelete>> rings;
+  std::vector<Ring *> snapshot;  // writer thread only
+
+  std::mutex names_mutex;   // only taken when states are constructed and by the writer
+  std::vector<std::string> state_names;
+  std::map<std::string, std::uint16_t> state_ids;
+
+  std::atomic<std::ostream *> output;
+  std::atomic<bool>          running;
+  std::atomic<bool>          writer_sleeping;
+  std::atomic<std::uint64_t> dropped;
+  std::atomic<std::uint64_t> requested;  // flush() requests
+  std::atomic<std::uint64_t> completed;  // flush() requests served
+  std::mutex              wake_mutex;  // wake, flushed (not taken by log() while the writer is busy)
+  std::condition_variable wake;        // the writer thread sleeps on it
+  std::condition_variable flushed;     // flush() waits on it
+  std::thread writer;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef DESCRIPTOR_INPUT_H
+#define DESCRIPTOR_INPUT_H
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <boost/asio.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+#include "span.h"
+
+
+
+/////////////////////////////////
+// KeyClassifier: finds the keys (case-insensitive) in a buffer of characters
+//
+// keys: up to 16 lowercase ASCII letters, one byte each (the constructor throws otherwise):
+// matching case-insensitively by | 0x20 only works for letters. scan() calls f(index of the key in keys) for every key
+// in the buffer, in order, skipping everything else (whitespace, newlines, ...). With SSE2
+// a block of 16 characters is classified at once: lowercase (| 0x20), compare against
+// every key, one movemask -> a bitmask of the keys in the block; blocks without keys (e.g.
+// padding) cost a few instructions. The rest is done one character at a time.
+/////////////////////////////////
+class KeyClassifier {
+public:
+  static constexpr std::uint8_t none = 0xff;
+  static constexpr std::size_t max_keys = 16;
+
+  explicit KeyClassifier(const char *keys_) : num_keys{std::strlen(keys_)} {
+    if (num_keys > max_keys)
+      throw std::runtime_error{"KeyClassifier: more than 16 keys"};
+    for (std::size_t k = 0; k < num_keys; ++k)
+      if (keys_[k] < 'a' || keys_[k] > 'z')
+        throw std::runtime_error{"KeyClassifier: key " + std::string{keys_[k]} + " is not a lowercase letter"};
+    index.fill(std::uint8_t{none});
+    for (std::size_t k = 0; k < num_keys; ++k) {
+      const unsigned char c = static_cast<unsigned char>(keys_[k]);
+      index[c]          = static_cast<std::uint8_t>(k);
+      index[c & ~0x20u] = static_cast<std::uint8_t>(k); // uppercase
+      keys[k] = keys_[k];
+    }
+  }
+
+  // f(key index) -> false: stop (returns the position after that key); else returns end
+  template <typename F>
+  const char *scan(const char *begin, const char *end, F f) const {
+    const char *p = begin;
+#if defined(__SSE2__)
+    __m128i key_vec[max_keys];
+    for (std::size_t k = 0; k < num_keys; ++k)
+      key_vec[k] = _mm_set1_epi8(keys[k]);
+    const __m128i lower = _mm_set1_epi8(0x20);
+
+    for (; end - p >= 16; p += 16) {
+      const __m128i block = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), lower);
+      __m128i hit = _mm_setzero_si128();
+      for (std::size_t k = 0; k < num_keys; ++k)
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, key_vec[k]));
+      for (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit)); mask; mask &= mask - 1) {
+        const char *c = p + __builtin_ctz(mask);
+        if (!f(index[static_cast<unsigned char>(*c)]))
+          return c + 1;
+      }
+    }
+#endif
+    for (; p != end; ++p) {
+      const std::uint8_t k = index[static_cast<unsigned char>(*p)];
+      if (k != none && !f(k))
+        return p + 1;
+    }
+    return end;
+  }
+
+private:
+  std::size_t num_keys;
+  char keys[max_keys];
+  std::array<std::uint8_t, 256> index; // character -> key index (or none)
+};
+
+
+
+/////////////////////////////////
+// DescriptorInput: keyboard-style input from a file descriptor (stdin, a pipe, a file, ...),
+// read on the io_service
+//
+// Reads chunks of up to chunk_size bytes (posix::stream_descriptor::async_read_some: no extra
+// thread, no per-character synchronization), converts each chunk into events in one pass
+// (KeyClassifier) and hands them to handler as one batch on the io_service's thread.
+// keys[i] is the event events[i]; input ends after the key stop_key (its event is the last
+// one delivered), or at end of file / on error (then the event of stop_key is delivered).
+/////////////////////////////////
+template <typename Event>
+class DescriptorInput {
+public:
+  using Handler = std::function<void(Span<const Event>)>;
+
+  DescriptorInput(boost::asio::io_service &io_service, int fd, const char *keys, const Event *events_, char stop_key,
+                  Handler handler_, std::size_t chunk_size = 64 * 1024)
+    : descriptor{io_service, fd}, classifier{keys}, events(events_, events_ + std::strlen(keys)),
+      stop{static_cast<std::size_t>(std::strchr(keys, stop_key) - keys)}, handler{std::move(handler_)}, buffer(chunk_size)
+  {
+    batch.reserve(chunk_size);
+    read();
+  }
+
+  // stop reading (the stop event is not delivered)
+  void cancel() {
+    boost::system::error_code ignored;
+    descriptor.cancel(ignored);
+  }
+
+private:
+  void read() {
+    descriptor.async_read_some(boost::asio::buffer(buffer), [this](const boost::system::error_code &err, std::size_t n) {
+        if (err == boost::asio::error::operation_aborted)
+          return;
+        batch.clear();
+        bool stopped = false;
+        classifier.scan(buffer.data(), buffer.data() + n, [this, &stopped](std::uint8_t k) {
+            batch.push_back(events[k]);
+            if (k != stop)
+              return true;
+            stopped = true;
+            return false;
+          });
+        if (err && !stopped) { // end of file
+          batch.push_back(events[stop]);
+          stopped = true;
+        }
+        if (!batch.empty())
+          handler(Span<const Event>{batch.data(), batch.size()});
+        if (!stopped)
+          read();
+      });
+  }
+
+  boost::asio::posix::stream_descriptor descriptor;
+  KeyClassifier      classifier;
+  std::vector<Event> events;   // of the keys
+  std::size_t        stop;     // index of stop_key
+  Handler            handler;
+  std::vector<char>  buffer;
+  std::vector<Event> batch;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef EVENT_INGRESS_H
+#define EVENT_INGRESS_H
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include "event_ring.h"
+
+
+
+/////////////////////////////////
+// EventIngress: hands events from any thread to a handler running on an io_service
+//
+// Instead of one io_service.post() per event (a handler allocation and the scheduler's mutex
+// every time), producers push into a lock-free EventRing. Only when the ring goes from empty
+// to non-empty is a drain-handler posted to the io_service; it then handles events in batches
+// of batch_size, re-posting itself between batches so that timers are not starved.
+/////////////////////////////////
+template <typename T, std::size_t Capacity = 1024>
+class EventIngress {
+public:
+  using Handler = std::function<void(const T &)>; // called on the io_service's thread
+
+  EventIngress(boost::asio::io_service &io_service_, Handler handler_, std::size_t batch_size_ = 64) :
+    io_service{io_service_}, handler{std::move(handler_)}, batch_size{batch_size_} {}
+
+  // thread-safe. If the ring is full, the producer waits (back-pressure)
+  void post(const T &event) {
+    bool wakeup;
+    while (!ring.push(event, wakeup))
+      std::this_thread::yield();
+    if (wakeup)
+      boost::asio::post(io_service, [this]() { drain(); });
+  }
+
+private:
+  void drain() {
+    for (;;) {
+      if (ring.drain(handler, batch_size) == batch_size) {
+        boost::asio::post(io_service, [this]() { drain(); }); // more to come: give others a turn
+        return;
+      }
+      if (ring.try_idle())
+        return;
+    }
+  }
+
+  boost::asio::io_service &io_service;
+  Handler handler;
+  std::size_t batch_size;
+  EventRing<T, Capacity> ring;
+};
+
+#endif
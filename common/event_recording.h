@@ -0,0 +1,153 @@
+#ifndef EVENT_RECORDING_H
+#define EVENT_RECORDING_H
+
+#include <string>
+#include <vector>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+
+
+/////////////////////////////////
+// event recording file format
+//
+//   char[8] magic  "PPEVREC1"
+//   records back to back:
+//     varint  delta_ns   to the previous record (first record: to the start of the recording)
+//     uint8   event id   (EventID)
+//
+// varint: LEB128 (7 bits per byte, low bits first, bit 7 set on all but the last byte)
+// Keyboard-paced input costs 3-5 bytes per event.
+/////////////////////////////////
+constexpr char event_recording_magic[8] = {'P', 'P', 'E', 'V', 'R', 'E', 'C', '1'};
+
+
+// one recorded event: time since the start of the recording, and its id
+struct RecordedEvent {
+  std::uint64_t time_ns;
+  std::uint8_t  eid;
+};
+
+
+
+/////////////////////////////////
+// EventRecorder: appends every input event (with a steady_clock timestamp) to a recording file
+//
+// Buffered (stdio); the file is complete after flush() or destruction.
+// Single writer: call record() from one thread (the one producing the input).
+/////////////////////////////////
+class EventRecorder {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  explicit EventRecorder(const std::string &path) : file{std::fopen(path.c_str(), "wb")}, start{clock_type::now()} {
+    if (!file)
+      throw std::runtime_error{"EventRecorder: cannot open " + path};
+    std::setvbuf(file, nullptr, _IOFBF, 64 * 1024);
+    std::fwrite(event_recording_magic, 1, sizeof(event_recording_magic), file);
+  }
+
+  EventRecorder(const EventRecorder &) = delete;
+  EventRecorder &operator=(const EventRecorder &) = delete;
+
+  ~EventRecorder() {
+    std::fclose(file);
+  }
+
+  void record(std::uint8_t eid) {
+    const std::uint64_t now_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+    unsigned char buf[10 + 1];
+    unsigned char *out = buf;
+    std::uint64_t v = now_ns - last_ns;
+    while (v >= 0x80) {
+      *out++ = static_cast<unsigned char>(v) | 0x80;
+      v >>= 7;
+    }
+    *out++ = static_cast<unsigned char>(v);
+    *out++ = eid;
+    std::fwrite(buf, 1, static_cast<std::size_t>(out - buf), file);
+    last_ns = now_ns;
+  }
+
+  void flush() {
+    std::fflush(file);
+  }
+
+private:
+  std::FILE *file;
+  clock_type::time_point start;
+  std::uint64_t last_ns = 0;
+};
+
+
+
+// the events of a recording file (throws std::runtime_error if it is not one; a truncated last record is dropped)
+inline std::vector<RecordedEvent> load_event_recording(const std::string &path)
+{
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    throw std::runtime_error{"load_event_recording: cannot open " + path};
+  std::vector<unsigned char> bytes;
+  unsigned char buf[64 * 1024];
+  for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), file)) > 0; )
+    bytes.insert(bytes.end(), buf, buf + n);
+  std::fclose(file);
+
+  if (bytes.size() < sizeof(event_recording_magic) || std::memcmp(bytes.data(), event_recording_magic, sizeof(event_recording_magic)) != 0)
+    throw std::runtime_error{"load_event_recording: not an event recording: " + path};
+
+  std::vector<RecordedEvent> events;
+  const unsigned char *in = bytes.data() + sizeof(event_recording_magic);
+  const unsigned char *end = bytes.data() + bytes.size();
+  std::uint64_t time_ns = 0;
+  while (in != end) {
+    std::uint64_t delta = 0;
+    bool complete = false;
+    for (unsigned shift = 0; in != end && shift < 64; shift += 7) {
+      const unsigned char byte = *in++;
+      delta |= std::uint64_t{byte & 0x7fu} << shift;
+      if (!(byte & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete || in == end)
+      break;
+    time_ns += delta;
+    events.push_back(RecordedEvent{time_ns, *in++});
+  }
+  return events;
+}
+
+
+
+// feed events to deliver(eid): at their original pacing (relative to now), or as fast as deliver() returns
+// stop (optional): once set, the replay ends before the next event (a paced wait sees it within 100 ms)
+template <typename Deliver>
+void replay_events(const std::vector<RecordedEvent> &events, bool paced, Deliver deliver, const std::atomic<bool> *stop = nullptr)
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (const RecordedEvent &e : events) {
+    if (paced) {
+      const std::chrono::steady_clock::time_point due = start + std::chrono::nanoseconds(e.time_ns);
+      if (stop)
+        while (!stop->load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < due)
+          std::this_thread::sleep_until(std::min(due, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+      else
+        std::this_thread::sleep_until(due);
+    }
+    if (stop && stop->load(std::memory_order_relaxed))
+      return;
+    deliver(e.eid);
+  }
+}
+
+#endif
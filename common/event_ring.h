@@ -0,0 +1,106 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+
+
+/////////////////////////////////
+// EventRing: bounded lock-free multi-producer / single-consumer ring
+//
+// Producers claim a slot with one CAS on the tail and publish it with a release-store of the
+// slot's sequence number (D. Vyukov's bounded queue); the single consumer reads without any RMW.
+// T should be small and trivially copyable (a tagged event: an id plus maybe a little data).
+//
+// Wakeup protocol: push() reports whether the ring went from "empty/idle" to "non-empty";
+// only then does the producer have to wake the consumer. The consumer calls drain() until it
+// returns 0 and then goes idle with try_idle() (which re-checks for a racing push).
+/////////////////////////////////
+template <typename T, std::size_t Capacity = 1024>
+class EventRing {
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(std::is_trivially_copyable<T>::value, "EventRing holds trivially copyable events");
+
+public:
+  EventRing() : tail{0}, head{0}, consumer_busy{false} {
+    for (std::size_t i = 0; i < Capacity; ++i)
+      slots[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  EventRing(const EventRing &) = delete;
+  EventRing &operator=(const EventRing &) = delete;
+
+  /* multi-producer: returns false if the ring is full.
+     wakeup is set to true if the consumer was idle and has to be woken up */
+  bool push(const T &event, bool &wakeup) {
+    std::size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slots[pos & (Capacity - 1)];
+      const std::size_t seq = slot.seq.load(std::memory_order_acquire);
+      const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        wakeup = false;
+        return false; // full
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    Slot &slot = slots[pos & (Capacity - 1)];
+    slot.event = event;
+    slot.seq.store(pos + 1, std::memory_order_release);
+
+    // pairs with the fence in try_idle(): either we see the consumer idle, or it sees our event
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wakeup = !consumer_busy.load(std::memory_order_relaxed) && !consumer_busy.exchange(true, std::memory_order_acq_rel);
+    return true;
+  }
+
+  /* single consumer: hand up to max_events events to f(const T&), in order.
+     returns the number of events handled */
+  template <typename F>
+  std::size_t drain(F &&f, std::size_t max_events = Capacity) {
+    std::size_t n = 0;
+    while (n < max_events) {
+      Slot &slot = slots[head & (Capacity - 1)];
+      if (slot.seq.load(std::memory_order_acquire) != head + 1)
+        break; // empty (or the producer of this slot has not published yet)
+      const T event = slot.event;
+      slot.seq.store(head + Capacity, std::memory_order_release);
+      ++head;
+      ++n;
+      f(event);
+    }
+    return n;
+  }
+
+  /* single consumer: call when drain() returned 0. Returns true if the consumer may sleep;
+     false if an event slipped in meanwhile (then keep draining: no wakeup will come for it) */
+  bool try_idle() {
+    consumer_busy.store(false, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (slots[head & (Capacity - 1)].seq.load(std::memory_order_acquire) != head + 1)
+      return true;
+    // not empty: take the busy-flag back, unless a producer already did (and will wake us)
+    return consumer_busy.exchange(true, std::memory_order_acq_rel);
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<std::size_t> seq;
+    T event;
+  };
+
+  Slot slots[Capacity];
+  alignas(64) std::atomic<std::size_t> tail;          // producers
+  alignas(64) std::size_t              head;          // consumer only
+  alignas(64) std::atomic<bool>        consumer_busy; // false: consumer idle, next push has to wake it
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef FAST_SIGNAL_H
+#define FAST_SIGNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+
+/////////////////////////////////
+// InlineFunction: a std::function that never allocates
+//
+// The callable is stored in the object itself (up to Size bytes; a larger one does not compile:
+// capture a pointer instead). Calling it is one indirect call.
+/////////////////////////////////
+template <typename Signature, std::size_t Size = 32>
+class InlineFunction;
+
+template <typename R, typename... Args, std::size_t Size>
+class InlineFunction<R(Args...), Size> {
+public:
+  InlineFunction() = default;
+
+  template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+  InlineFunction(F &&f) {
+    using Fn = typename std::decay<F>::type;
+    static_assert(sizeof(Fn) <= Size, "callable too large for InlineFunction: capture less (e.g. a pointer)");
+    static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable over-aligned for InlineFunction");
+    new (storage) Fn(std::forward<F>(f));
+    invoke = [](void *fn, Args... args) -> R { return (*static_cast<Fn *>(fn))(std::forward<Args>(args)...); };
+    manage = [](void *dst, const void *src) {
+      if (src)
+        new (dst) Fn(*static_cast<const Fn *>(src)); // copy
+      else
+        static_cast<Fn *>(dst)->~Fn();               // destroy
+    };
+  }
+
+  InlineFunction(const InlineFunction &other) : invoke{other.invoke}, manage{other.manage} {
+    if (manage)
+      manage(storage, other.storage);
+  }
+
+  InlineFunction &operator=(const InlineFunction &other) {
+    if (this != &other) {
+      reset();
+      if (other.manage)
+        other.manage(storage, other.storage);
+      invoke = other.invoke;
+      manage = other.manage;
+    }
+    return *this;
+  }
+
+  ~InlineFunction() {
+    reset();
+  }
+
+  R operator()(Args... args) const {
+    return invoke(storage, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const { return invoke != nullptr; }
+
+private:
+  void reset() {
+    if (manage)
+      manage(storage, nullptr);
+    invoke = nullptr;
+    manage = nullptr;
+  }
+
+  alignas(std::max_align_t) mutable unsigned char storage[Size];
+  R (*invoke)(void *, Args...)             = nullptr;
+  void (*manage)(void *, const void *)     = nullptr;
+};
+
+
+
+/////////////////////////////////
+// Signal: publish / subscribe with the connect / emit semantics of boost::signals2::signal
+// (slots are called in the order they were connected; a Connection can disconnect its slot)
+//
+// Emission is wait-free: one atomic load of the current subscriber array, then a plain loop
+// of InlineFunction calls; no mutex, no reference counting. connect() / disconnect() copy the
+// array (copy-on-write, serialized by a mutex) and publish the copy. Old arrays may still be
+// in use by a concurrent emission, so they are only freed with the Signal: subscribing is
+// meant to happen at set-up, not per event.
+/////////////////////////////////
+template <typename Signature, std::size_t SlotSize = 32>
+class Signal;
+
+template <typename... Args, std::size_t SlotSize>
+class Signal<void(Args...), SlotSize> {
+public:
+  using Slot = InlineFunction<void(Args...), SlotSize>;
+
+  class Connection {
+  public:
+    Connection() = default;
+
+    void disconnect() {
+      if (signal)
+        signal->disconnect(id);
+      signal = nullptr;
+    }
+
+    bool connected() const { return signal != nullptr; }
+
+  private:
+    friend class Signal;
+    Connection(Signal *signal_, std::uint64_t id_) : signal{signal_}, id{id_} {}
+
+    Signal       *signal = nullptr;
+    std::uint64_t id     = 0;
+  };
+
+  Signal() = default;
+  Signal(const Signal &) = delete;
+  Signal &operator=(const Signal &) = delete;
+
+  template <typename F>
+  Connection connect(F &&f) {
+    std::lock_guard<std::mutex> lock{mutex};
+    std::unique_ptr<Slots> next{new Slots{current_slots()}};
+    next->push_back(Entry{++last_id, Slot{std::forward<F>(f)}});
+    publish(std::move(next));
+    return Connection{this, last_id};
+  }
+
+  void disconnect_all_slots() {
+    std::lock_guard<std::mutex> lock{mutex};
+    publish(std::unique_ptr<Slots>{new Slots{}});
+  }
+
+  std::size_t num_slots() const {
+    const Slots *slots = current.load(std::memory_order_acquire);
+    return slots ? slots->size() : 0;
+  }
+
+  bool empty() const { return num_slots() == 0; }
+
+  // emit
+  void operator()(Args... args) const {
+    const Slots *slots = current.load(std::memory_order_acquire);
+    if (slots)
+      for (const Entry &entry : *slots)
+        entry.slot(args...);
+  }
+
+private:
+  struct Entry {
+    std::uint64_t id;
+    Slot          slot;
+  };
+  using Slots = std::vector<Entry>;
+
+  void disconnect(std::uint64_t id) {
+    std::lock_guard<std::mutex> lock{mutex};
+    std::unique_ptr<Slots> next{new Slots{}};
+    for (const Entry &entry : current_slots())
+      if (entry.id != id)
+        next->push_back(entry);
+    publish(std::move(next));
+  }
+
+  // (mutex held)
+  const Slots &current_slots() const {
+    static const Slots none;
+    return arrays.empty() ? none : *arrays.back();
+  }
+
+  // (mutex held)
+  void publish(std::unique_ptr<Slots> next) {
+    current.store(next.get(), std::memory_order_release);
+    arrays.push_back(std::move(next));
+  }
+
+  std::atomic<const Slots *> current{nullptr};
+
+  std::mutex mutex;                           // connect / disconnect
+  std::vector<std::unique_ptr<Slots>> arrays; // every array published so far (the last one is current)
+  std::uint64_t last_id = 0;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef HANDLER_ALLOCATOR_H
+#define HANDLER_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+
+/////////////////////////////////
+// HandlerMemory: a few fixed-size blocks, recycled for asio completion handlers
+//
+// Every async_wait allocates an operation object (handler + bookkeeping). With this memory
+// attached to the handler (see make_recycling_handler) the operation lives in one of the
+// blocks here instead of the heap. There are several blocks, because a cancelled operation
+// keeps its block until its handler has run, while the timer may already have been re-armed.
+// If all blocks are in use (or the operation is too large) we fall back to operator new.
+//
+// Not thread-safe: use one HandlerMemory per timer (all on one io_service thread).
+/////////////////////////////////
+class HandlerMemory {
+public:
+  static constexpr std::size_t block_size = 256;
+  static constexpr std::size_t num_blocks = 4;
+
+  HandlerMemory() {
+    for (bool &used : in_use)
+      used = false;
+  }
+
+  // a moved-to HandlerMemory starts empty: only move while no operation is outstanding (e.g. during construction)
+  HandlerMemory(HandlerMemory &&) : HandlerMemory{} {}
+
+  HandlerMemory(const HandlerMemory &) = delete;
+  HandlerMemory &operator=(const HandlerMemory &) = delete;
+
+  void *allocate(std::size_t size) {
+    if (size <= block_size)
+      for (std::size_t i = 0; i < num_blocks; ++i)
+        if (!in_use[i]) {
+          in_use[i] = true;
+          return &blocks[i];
+        }
+    return ::operator new(size);
+  }
+
+  void deallocate(void *p) {
+    for (std::size_t i = 0; i < num_blocks; ++i)
+      if (p == &blocks[i]) {
+        in_use[i] = false;
+        return;
+      }
+    ::operator delete(p);
+  }
+
+private:
+  typename std::aligned_storage<block_size, alignof(std::max_align_t)>::type blocks[num_blocks];
+  bool in_use[num_blocks];
+};
+
+
+/////////////////////////////////
+// HandlerAllocator: standard allocator on top of HandlerMemory (asio's associated allocator)
+/////////////////////////////////
+template <typename T>
+class HandlerAllocator {
+public:
+  using value_type = T;
+
+  explicit HandlerAllocator(HandlerMemory &memory_) : memory{memory_} {}
+
+  template <typename U>
+  HandlerAllocator(const HandlerAllocator<U> &other) noexcept : memory{other.memory} {}
+
+  T *allocate(std::size_t n) const { return static_cast<T *>(memory.allocate(sizeof(T) * n)); }
+  void deallocate(T *p, std::size_t) const { memory.deallocate(p); }
+
+  bool operator==(const HandlerAllocator &other) const noexcept { return &memory == &other.memory; }
+  bool operator!=(const HandlerAllocator &other) const noexcept { return &memory != &other.memory; }
+
+private:
+  template <typename> friend class HandlerAllocator;
+  HandlerMemory &memory;
+};
+
+
+/////////////////////////////////
+// RecyclingHandler: wraps a completion handler, so that asio allocates from HandlerMemory
+/////////////////////////////////
+template <typename Handler>
+class RecyclingHandler {
+public:
+  using allocator_type = HandlerAllocator<Handler>;
+
+  RecyclingHandler(HandlerMemory &memory_, Handler handler_) : memory{memory_}, handler{std::move(handler_)} {}
+
+  allocator_type get_allocator() const noexcept { return allocator_type{memory}; }
+
+  template <typename... Args>
+  void operator()(Args &&... args) { handler(std::forward<Args>(args)...); }
+
+private:
+  HandlerMemory &memory;
+  Handler handler;
+};
+
+template <typename Handler>
+inline RecyclingHandler<typename std::decay<Handler>::type> make_recycling_handler(HandlerMemory &memory, Handler &&handler)
+{
+  return RecyclingHandler<typename std::decay<Handler>::type>{memory, std::forward<Handler>(handler)};
+}
+
+#endif
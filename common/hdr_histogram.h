@@ -0,0 +1,118 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+
+/////////////////////////////////
+// HdrHistogram: high-dynamic-range histogram of non-negative integers (e.g. nanoseconds)
+//
+// Values below 128 are counted exactly; above, every power-of-two range is split into 64
+// sub-buckets, so a recorded value is known to within 1/64 (~1.6 %) over the whole 64-bit
+// range. The counts (~30 KiB) are allocated on the first record(), so an idle histogram is
+// small; after that record() is a few instructions (no allocation, no floating point).
+/////////////////////////////////
+class HdrHistogram {
+public:
+  static constexpr unsigned    sub_bucket_bits = 7;
+  static constexpr std::size_t sub_buckets     = std::size_t{1} << sub_bucket_bits;  // 128
+  static constexpr std::size_t half            = sub_buckets / 2;                   // 64
+  static constexpr std::size_t num_counts      = (64 - sub_bucket_bits + 2) * half;  // up to 2^64-1
+
+  void record(std::uint64_t value) {
+    if (counts.empty())
+      counts.assign(std::size_t{num_counts}, 0);
+    ++counts[index_of(value)];
+    ++total;
+    if (value > max_value)
+      max_value = value;
+    if (value < min_value)
+      min_value = value;
+  }
+
+  void merge(const HdrHistogram &other) {
+    if (other.counts.empty())
+      return;
+    if (counts.empty())
+      counts.assign(std::size_t{num_counts}, 0);
+    for (std::size_t i = 0; i < num_counts; ++i)
+      counts[i] += other.counts[i];
+    total += other.total;
+    if (other.max_value > max_value)
+      max_value = other.max_value;
+    if (other.min_value < min_value)
+      min_value = other.min_value;
+  }
+
+  void reset() {
+    counts.assign(counts.size(), 0);
+    total     = 0;
+    max_value = 0;
+    min_value = UINT64_MAX;
+  }
+
+  std::uint64_t count() const { return total; }
+  std::uint64_t max()   const { return max_value; }
+  std::uint64_t min()   const { return total ? min_value : 0; }
+
+  // smallest recorded value v (to within the bucket's precision), so that percentile % of all values are <= v
+  std::uint64_t value_at_percentile(double percentile) const {
+    if (total == 0)
+      return 0;
+    std::uint64_t rank = static_cast<std::uint64_t>(percentile / 100.0 * total + 0.5);
+    if (rank < 1)
+      rank = 1;
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < num_counts; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        const std::uint64_t v = highest_equivalent(i);
+        return (v < max_value) ? v : max_value;
+      }
+    }
+    return max_value;
+  }
+
+  double mean() const {
+    if (total == 0)
+      return 0;
+    double sum = 0;
+    for (std::size_t i = 0; i < num_counts; ++i)
+      if (counts[i])
+        sum += counts[i] * (0.5 * lowest_equivalent(i) + 0.5 * highest_equivalent(i));
+    return sum / total;
+  }
+
+  static std::size_t index_of(std::uint64_t value) {
+    if (value < sub_buckets)
+      return static_cast<std::size_t>(value);
+    const unsigned msb   = 63 - __builtin_clzll(value);
+    const unsigned shift = msb - (sub_bucket_bits - 1);                  // >= 1
+    return shift * half + static_cast<std::size_t>(value >> shift);      // (value >> shift) in [64, 128)
+  }
+
+  static std::uint64_t lowest_equivalent(std::size_t index) {
+    if (index < sub_buckets)
+      return index;
+    const unsigned shift = static_cast<unsigned>(index / half) - 1;
+    return static_cast<std::uint64_t>(index % half + half) << shift;
+  }
+
+  static std::uint64_t highest_equivalent(std::size_t index) {
+    if (index < sub_buckets)
+      return index;
+    const unsigned shift = static_cast<unsigned>(index / half) - 1;
+    return lowest_equivalent(index) + ((std::uint64_t{1} << shift) - 1);
+  }
+
+private:
+  std::vector<std::uint64_t> counts;
+  std::uint64_t total     = 0;
+  std::uint64_t max_value = 0;
+  std::uint64_t min_value = UINT64_MAX;
+};
+
+#endif
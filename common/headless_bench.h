@@ -0,0 +1,121 @@
+#ifndef HEADLESS_BENCH_H
+#define HEADLESS_BENCH_H
+
+#include <fstream>
+#include <ostream>
+#include <string>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <unistd.h>
+
+#include "hdr_histogram.h"
+
+
+
+/////////////////////////////////
+// Headless benchmark of a realization (see bench_headless.cpp of each realization and
+// bench_suite.sh): every realization is driven by the same synthetic keyboard stream and
+// reports the same key=value line, so the realizations can be compared side by side.
+/////////////////////////////////
+
+
+// SyntheticInput: keyboard-like stream of 'x' (60 %), 'i' (20 %), 'o' (20 %); same seed -> same stream
+class SyntheticInput {
+public:
+  explicit SyntheticInput(std::uint64_t seed = 0x9e3779b97f4a7c15ull) : state{seed} {}
+
+  char next() {
+    state ^= state << 13;  // xorshift64
+    state ^= state >> 7;
+    state ^= state << 17;
+    const unsigned r = static_cast<unsigned>(state % 10);
+    return (r < 6) ? 'x' : (r < 8) ? 'i' : 'o';
+  }
+
+private:
+  std::uint64_t state;
+};
+
+
+// resident set size of this process
+inline std::size_t resident_bytes()
+{
+  std::ifstream statm{"/proc/self/statm"};
+  std::size_t size_pages = 0, resident_pages = 0;
+  statm >> size_pages >> resident_pages;
+  return resident_pages * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+
+// HeadlessBench: the measurements of one realization
+//
+//   rss_per_instance(k, make)  make() k times (keeping every instance alive) -> RSS growth / k
+//   throughput(n, deliver)     deliver(c) for n keys                          -> events/sec
+//   latency(n, deliver)        deliver(c) for n keys, each one timed          -> percentiles
+//
+// deliver(c) hands one key to the machine and lets it run to completion (including one turn
+// of its event loop, so that e.g. cancelled timers are cleaned up as in the real program).
+class HeadlessBench {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  explicit HeadlessBench(const std::string &framework_) : framework{framework_} {}
+
+  template <typename Container, typename Make>
+  void rss_per_instance(std::size_t k, Container &instances, Make make) {
+    instances.reserve(k);
+    const std::size_t before = resident_bytes();
+    for (std::size_t i = 0; i < k; ++i)
+      instances.push_back(make());
+    const std::size_t after = resident_bytes();
+    num_instances = k;
+    rss_bytes_per_instance = (after > before) ? (after - before) / k : 0;
+  }
+
+  template <typename Deliver>
+  void throughput(std::size_t n, Deliver deliver) {
+    SyntheticInput input;
+    const clock_type::time_point t0 = clock_type::now();
+    for (std::size_t i = 0; i < n; ++i)
+      deliver(input.next());
+    const double secs = std::chrono::duration<double>(clock_type::now() - t0).count();
+    num_events      = n;
+    events_per_sec  = (secs > 0) ? n / secs : 0;
+  }
+
+  template <typename Deliver>
+  void latency(std::size_t n, Deliver deliver) {
+    SyntheticInput input;
+    for (std::size_t i = 0; i < n; ++i) {
+      const char c = input.next();
+      const clock_type::time_point t0 = clock_type::now();
+      deliver(c);
+      latency_ns.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t0).count()));
+    }
+  }
+
+  void report(std::ostream &os) const {
+    os << "bench_headless framework=" << framework
+       << " events=" << num_events
+       << " events_per_sec=" << static_cast<std::uint64_t>(events_per_sec)
+       << " p50_ns=" << latency_ns.value_at_percentile(50)
+       << " p99_ns=" << latency_ns.value_at_percentile(99)
+       << " p99.9_ns=" << latency_ns.value_at_percentile(99.9)
+       << " max_ns=" << latency_ns.max()
+       << " instances=" << num_instances
+       << " rss_per_instance_bytes=" << rss_bytes_per_instance << '\n';
+  }
+
+private:
+  std::string  framework;
+  std::size_t  num_events             = 0;
+  double       events_per_sec         = 0;
+  HdrHistogram latency_ns;
+  std::size_t  num_instances          = 0;
+  std::size_t  rss_bytes_per_instance = 0;
+};
+
+#endif
@@ -0,0 +1,401 @@
+#ifndef NET_INGRESS_H
+#define NET_INGRESS_H
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <boost/asio.hpp>
+
+#include "span.h"
+
+
+
+/////////////////////////////////
+// network event frame (all integers little-endian, as written by the host)
+//
+//   char[4] magic  "PPNE"
+//   uint8   flags  bit 0: stamped
+//   uint8   reserved (0)
+//   uint16  count
+//   uint8   eid[count]          event ids (EventID)
+//   int64   sent_ns[count]      only if stamped: steady_clock of the sender (latency on the same host)
+//
+// Frames go back to back on a TCP stream; a UDP datagram carries one or more whole frames.
+/////////////////////////////////
+constexpr char net_frame_magic[4] = {'P', 'P', 'N', 'E'};
+
+constexpr std::size_t  net_frame_header_size = 8;
+constexpr std::size_t  net_frame_max_events  = 0xffff;
+constexpr std::uint8_t net_frame_stamped     = 0x01;
+
+inline std::size_t net_frame_size(std::size_t count, bool stamped) {
+  return net_frame_header_size + count * (stamped ? 1 + sizeof(std::int64_t) : 1);
+}
+
+// writes one frame of count events to out (net_frame_size() bytes); sent_ns: nullptr for an unstamped frame
+inline std::size_t write_net_frame(char *out, const std::uint8_t *eids, const std::int64_t *sent_ns, std::size_t count) {
+  const std::uint16_t n = static_cast<std::uint16_t>(count);
+  std::memcpy(out, net_frame_magic, sizeof(net_frame_magic));
+  out[4] = static_cast<char>(sent_ns ? net_frame_stamped : 0);
+  out[5] = 0;
+  std::memcpy(out + 6, &n, sizeof(n));
+  std::memcpy(out + net_frame_header_size, eids, count);
+  if (sent_ns)
+    std::memcpy(out + net_frame_header_size + count, sent_ns, count * sizeof(std::int64_t));
+  return net_frame_size(count, sent_ns != nullptr);
+}
+
+enum class NetProtocol { udp, tcp };
+
+// "udp:PORT" or "tcp:PORT" (false if it is neither)
+inline bool parse_net_endpoint(const char *s, NetProtocol &protocol, unsigned short &port) {
+  if (!std::strncmp(s, "udp:", 4))
+    protocol = NetProtocol::udp;
+  else if (!std::strncmp(s, "tcp:", 4))
+    protocol = NetProtocol::tcp;
+  else
+    return false;
+  char *end = nullptr;
+  const unsigned long p = std::strtoul(s + 4, &end, 10);
+  if (end == s + 4 || *end || p > 0xffff)
+    return false;
+  port = static_cast<unsigned short>(p);
+  return true;
+}
+
+
+
+/////////////////////////////////
+// NetIngress: event frames (see above) from a localhost UDP or TCP socket, read on the io_service
+//
+// UDP: when the socket becomes readable, one recvmmsg() takes up to num_slots datagrams (of up
+// to slot_size bytes) at once into buffers allocated up front: one system call per batch instead
+// of one per datagram.
+// TCP: one connection at a time (the next one is accepted when it closes), read in chunks of up
+// to num_slots * slot_size bytes (at least the largest frame, net_frame_max_events stamped
+// events); a frame split over two reads is moved to the front of the buffer and completed by the
+// next one.
+//
+// Every read is decoded in one pass straight into one batch of events (events[eid]: the event of a
+// wire id; ids past the table are dropped) and handed to handler on the io_service's thread, as
+// DescriptorInput does. Nothing is allocated after construction. stamps() are the send times of
+// the batch (0 for events of unstamped frames), valid within handler.
+//
+// Malformed frames (bad magic, truncated, oversized datagrams) are dropped and counted; on TCP a
+// malformed frame closes the connection (the stream has lost its framing).
+/////////////////////////////////
+template <typename Event>
+class NetIngress {
+public:
+  using Handler = std::function<void(Span<const Event>)>;
+
+  NetIngress(boost::asio::io_service &io_service, NetProtocol protocol_, unsigned short port, Span<const Event> events_,
+             Handler handler_, std::size_t num_slots = 64, std::size_t slot_size = 4096)
+    : protocol{protocol_}, events(events_.begin(), events_.end()), handler{std::move(handler_)},
+      udp{io_service}, acceptor{io_service}, tcp{io_service}, slots{num_slots}, slot_size{slot_size},
+      buffer(protocol_ == NetProtocol::tcp ? std::max(num_slots * slot_size, net_frame_size(net_frame_max_events, true))
+                                           : num_slots * slot_size)
+  {
+    const boost::asio::ip::address localhost = boost::asio::ip::address_v4::loopback();
+    if (protocol == NetProtocol::udp) {
+      udp.open(boost::asio::ip::udp::v4());
+      udp.set_option(boost::asio::socket_base::receive_buffer_size(8 * 1024 * 1024)); // bursts (capped by net.core.rmem_max)
+      udp.bind(boost::asio::ip::udp::endpoint{localhost, port});
+      udp.non_blocking(true);
+      headers.resize(slots);
+      iovecs.resize(slots);
+      for (std::size_t i = 0; i < slots; ++i) {
+        iovecs[i].iov_base = &buffer[i * slot_size];
+        iovecs[i].iov_len  = slot_size;
+      }
+    }
+    else {
+      acceptor.open(boost::asio::ip::tcp::v4());
+      acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+      acceptor.bind(boost::asio::ip::tcp::endpoint{localhost, port});
+      acceptor.listen();
+    }
+    batch.reserve(buffer.size()); // (an event takes at least one byte)
+    stamp.reserve(buffer.size());
+    if (protocol == NetProtocol::udp)
+      wait_udp();
+    else
+      accept();
+  }
+
+  NetIngress(const NetIngress &) = delete;
+  NetIngress &operator=(const NetIngress &) = delete;
+
+  // the bound port (port 0 at construction: chosen by the system)
+  unsigned short port() const {
+    return (protocol == NetProtocol::udp) ? udp.local_endpoint().port() : acceptor.local_endpoint().port();
+  }
+
+  // stop reading (also from within handler)
+  void cancel() {
+    cancelled = true;
+    boost::system::error_code ignored;
+    udp.cancel(ignored);
+    acceptor.cancel(ignored);
+    tcp.close(ignored);
+  }
+
+  Span<const std::int64_t> stamps() const { return Span<const std::int64_t>{stamp.data(), stamp.size()}; }
+
+  std::uint64_t frames()  const { return num_frames; }
+  std::uint64_t reads()   const { return num_reads; }   // recvmmsg() / read calls that returned data
+  std::uint64_t dropped() const { return num_dropped; } // malformed frames and unknown event ids
+
+private:
+  ////// UDP
+  void wait_udp() {
+    udp.async_wait(boost::asio::ip::udp::socket::wait_read, [this](const boost::system::error_code &err) {
+        if (err)
+          return;
+        read_udp();
+        if (!cancelled)
+          wait_udp();
+      });
+  }
+
+  void read_udp() {
+    for (std::size_t i = 0; i < slots; ++i) {
+      std::memset(&headers[i], 0, sizeof(headers[i]));
+      headers[i].msg_hdr.msg_iov    = &iovecs[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    const int n = ::recvmmsg(udp.native_handle(), headers.data(), static_cast<unsigned>(slots), MSG_DONTWAIT, nullptr);
+    if (n <= 0)
+      return; // EAGAIN: spurious wakeup
+    ++num_reads;
+    clear();
+    for (int i = 0; i < n; ++i) {
+      const char *p = &buffer[i * slot_size];
+      if (headers[i].msg_hdr.msg_flags & MSG_TRUNC) { // larger than a slot
+        ++num_dropped;
+        continue;
+      }
+      const std::size_t len = headers[i].msg_len;
+      if (decode(p, len) != len) // a datagram holds whole frames only
+        ++num_dropped;
+    }
+    deliver();
+  }
+
+  ////// TCP
+  void accept() {
+    acceptor.async_accept(tcp, [this](const boost::system::error_code &err) {
+        if (err)
+          return;
+        tcp.set_option(boost::asio::ip::tcp::no_delay(true));
+        pending = 0;
+        read_tcp();
+      });
+  }
+
+  void read_tcp() {
+    tcp.async_read_some(boost::asio::buffer(&buffer[pending], buffer.size() - pending), [this](const boost::system::error_code &err, std::size_t n) {
+        if (err == boost::asio::error::operation_aborted)
+          return;
+        if (n > 0) {
+          ++num_reads;
+          clear();
+          const std::size_t have = pending + n;
+          const std::size_t used = decode(buffer.data(), have);
+          pending = have - used;
+          std::memmove(buffer.data(), buffer.data() + used, pending); // the start of the next frame
+          deliver();
+          if (cancelled)
+            return;
+          if (pending == buffer.size() || (pending >= net_frame_header_size && !valid_header(buffer.data()))) {
+            ++num_dropped; // framing lost
+            boost::system::error_code ignored;
+            tcp.close(ignored);
+          }
+        }
+        if (err || !tcp.is_open()) { // closed by the peer (or by us): next connection
+          boost::system::error_code ignored;
+          tcp.close(ignored);
+          accept();
+          return;
+        }
+        read_tcp();
+      });
+  }
+
+  ////// decoding
+  static bool valid_header(const char *p) {
+    return !std::memcmp(p, net_frame_magic, sizeof(net_frame_magic));
+  }
+
+  // decodes the whole frames at the start of [p, p + len) into batch; returns the bytes used
+  std::size_t decode(const char *p, std::size_t len) {
+    std::size_t used = 0;
+    while (len - used >= net_frame_header_size) {
+      const char *frame = p + used;
+      if (!valid_header(frame))
+        break;
+      std::uint16_t count;
+      std::memcpy(&count, frame + 6, sizeof(count));
+      const bool stamped = (frame[4] & net_frame_stamped) != 0;
+      const std::size_t size = net_frame_size(count, stamped);
+      if (len - used < size)
+        break;
+
+      const unsigned char *eid = reinterpret_cast<const unsigned char *>(frame + net_frame_header_size);
+      const char *sent = frame + net_frame_header_size + count;
+      for (std::size_t i = 0; i < count; ++i) {
+        if (eid[i] >= events.size()) {
+          ++num_dropped;
+          continue;
+        }
+        batch.push_back(events[eid[i]]);
+        std::int64_t ns = 0;
+        if (stamped)
+          std::memcpy(&ns, sent + i * sizeof(ns), sizeof(ns));
+        stamp.push_back(ns);
+      }
+      ++num_frames;
+      used += size;
+    }
+    return used;
+  }
+
+  void clear() {
+    batch.clear();
+    stamp.clear();
+  }
+
+  void deliver() {
+    if (!batch.empty())
+      handler(Span<const Event>{batch.data(), batch.size()});
+  }
+
+  NetProtocol        protocol;
+  std::vector<Event> events;   // of the wire ids
+  Handler            handler;
+
+  boost::asio::ip::udp::socket   udp;
+  boost::asio::ip::tcp::acceptor acceptor;
+  boost::asio::ip::tcp::socket   tcp;
+
+  std::size_t slots;
+  std::size_t slot_size;
+  std::vector<char>           buffer;   // UDP: slots of slot_size; TCP: one stream buffer
+  std::vector<::mmsghdr>      headers;  // UDP
+  std::vector<::iovec>        iovecs;   // UDP
+  std::size_t                 pending = 0; // TCP: bytes of an incomplete frame at the start of buffer
+  bool                        cancelled = false;
+
+  std::vector<Event>        batch;
+  std::vector<std::int64_t> stamp;     // of batch
+
+  std::uint64_t num_frames  = 0;
+  std::uint64_t num_reads   = 0;
+  std::uint64_t num_dropped = 0;
+};
+
+
+
+/////////////////////////////////
+// NetSender: the other end (load generator, benchmark): event frames to a localhost NetIngress
+//
+// send() cuts the events into frames of up to events_per_frame; over UDP the datagrams of one
+// send() go out with sendmmsg() in groups of up to 64 (one frame per datagram; keep a frame
+// within the slot_size of the NetIngress), over TCP as one write. Blocking sockets: the sender
+// is slowed down to what the kernel takes.
+/////////////////////////////////
+class NetSender {
+public:
+  NetSender(NetProtocol protocol_, unsigned short port, std::size_t events_per_frame_ = 64)
+    : protocol{protocol_}, udp{io_service}, tcp{io_service}, events_per_frame{events_per_frame_ < net_frame_max_events ? events_per_frame_ : net_frame_max_events}
+  {
+    const boost::asio::ip::address localhost = boost::asio::ip::address_v4::loopback();
+    if (protocol == NetProtocol::udp) {
+      udp.open(boost::asio::ip::udp::v4());
+      udp.connect(boost::asio::ip::udp::endpoint{localhost, port});
+    }
+    else {
+      tcp.connect(boost::asio::ip::tcp::endpoint{localhost, port});
+      tcp.set_option(boost::asio::ip::tcp::no_delay(true));
+    }
+    buffer.resize(group * net_frame_size(events_per_frame, true));
+  }
+
+  NetSender(const NetSender &) = delete;
+  NetSender &operator=(const NetSender &) = delete;
+
+  // sent_ns: nullptr for unstamped frames
+  void send(const std::uint8_t *eids, const std::int64_t *sent_ns, std::size_t count) {
+    while (count > 0) {
+      std::size_t frames = 0, bytes = 0;
+      for (; frames < group && count > 0; ++frames) {
+        const std::size_t n = (count < events_per_frame) ? count : events_per_frame;
+        const std::size_t size = write_net_frame(&buffer[bytes], eids, sent_ns, n);
+        iovecs[frames].iov_base = &buffer[bytes];
+        iovecs[frames].iov_len  = size;
+        bytes += size;
+        eids  += n;
+        if (sent_ns)
+          sent_ns += n;
+        count -= n;
+      }
+      if (protocol == NetProtocol::udp)
+        send_udp(frames);
+      else
+        boost::asio::write(tcp, boost::asio::buffer(buffer.data(), bytes));
+    }
+  }
+
+  void close() {
+    boost::system::error_code ignored;
+    udp.close(ignored);
+    tcp.close(ignored);
+  }
+
+private:
+  static constexpr std::size_t group = 64; // datagrams per sendmmsg()
+
+  void send_udp(std::size_t frames) {
+    ::mmsghdr headers[group];
+    std::memset(headers, 0, sizeof(headers));
+    for (std::size_t i = 0; i < frames; ++i) {
+      headers[i].msg_hdr.msg_iov    = &iovecs[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (std::size_t sent = 0; sent < frames; ) {
+      const int n = ::sendmmsg(udp.native_handle(), headers + sent, static_cast<unsigned>(frames - sent), 0);
+      if (n < 0) {
+        if (errno == EINTR || errno == ENOBUFS)
+          continue;
+        if (errno == ECONNREFUSED) // nobody listens (yet / any more): lost, as datagrams are
+          return;
+        throw std::runtime_error{std::string{"NetSender: sendmmsg: "} + std::strerror(errno)};
+      }
+      sent += static_cast<std::size_t>(n);
+    }
+  }
+
+  NetProtocol protocol;
+  boost::asio::io_service        io_service; // (blocking sockets only)
+  boost::asio::ip::udp::socket   udp;
+  boost::asio::ip::tcp::socket   tcp;
+  std::size_t       events_per_frame;
+  std::vector<char> buffer;
+  ::iovec           iovecs[group];
+};
+
+#endif
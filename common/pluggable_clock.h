@@ -0,0 +1,252 @@
+#ifndef PLUGGABLE_CLOCK_H
+#define PLUGGABLE_CLOCK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+
+
+/////////////////////////////////
+// PluggableClock: std::chrono::steady_clock, or a virtual clock
+//
+// After VirtualTime::enable() now() returns virtual time, which only moves when
+// VirtualTime::run_until() jumps to the next deadline. Time points are steady_clock's
+// (same type and epoch), so TimeoutData and the rest of the code are unchanged.
+//
+// The mode is process-wide and must be chosen before any timer is armed; virtual time is
+// meant for single-threaded simulation.
+/////////////////////////////////
+struct PluggableClock {
+  using duration   = std::chrono::steady_clock::duration;
+  using rep        = duration::rep;
+  using period     = duration::period;
+  using time_point = std::chrono::steady_clock::time_point;
+  static constexpr bool is_steady = true;
+
+  static time_point now() { return is_virtual() ? virtual_now() : std::chrono::steady_clock::now(); }
+
+  static bool &is_virtual()        { static bool v = false; return v; }
+  static time_point &virtual_now() { static time_point t{}; return t; }
+};
+
+
+class PluggableTimer;
+
+
+/////////////////////////////////
+// VirtualTime: runs an io_service in virtual time
+//
+// Waits of PluggableTimers are kept in a min-heap (ties: in the order they were armed).
+// run_until() alternates between running all ready handlers (io_service.poll()) and
+// jumping to the earliest deadline, whose handler it then posts. So the same inputs always
+// give the same sequence of handlers and time points: deterministic, and as fast as the
+// handlers themselves.
+//
+// A timer waits in a slot (reused after the timer is gone) with a generation: cancelling,
+// re-arming or destroying the timer only bumps the generation, and run_until() skips the
+// waits of older generations when they come up (lazy deletion: everything is O(log n)
+// or O(1), also tearing down millions of machines).
+/////////////////////////////////
+class VirtualTime {
+public:
+  // switch to virtual time, starting at start
+  static void enable(PluggableClock::time_point start = PluggableClock::time_point{}) {
+    PluggableClock::is_virtual()  = true;
+    PluggableClock::virtual_now() = start;
+  }
+
+  static VirtualTime &instance() {
+    static VirtualTime vt;
+    return vt;
+  }
+
+  // run io_service in virtual time up to (and including) deadline until; returns the number of timeouts
+  std::size_t run_until(boost::asio::io_service &io_service, PluggableClock::time_point until);
+
+  std::size_t run_for(boost::asio::io_service &io_service, PluggableClock::duration d) {
+    return run_until(io_service, PluggableClock::now() + d);
+  }
+
+private:
+  friend class PluggableTimer;
+
+  static constexpr std::uint32_t no_slot = ~std::uint32_t{0};
+
+  struct Slot {
+    PluggableTimer *timer;       // nullptr: free
+    std::uint64_t   generation;  // (never reset: waits of a previous timer of the slot stay outdated)
+  };
+
+  struct Wait {
+    PluggableClock::time_point deadline;
+    std::uint64_t              seq;
+    std::uint32_t              slot;
+    std::uint64_t              generation;  // of the slot when armed: outdated waits are skipped
+
+    bool operator>(const Wait &other) const {
+      return (deadline != other.deadline) ? deadline > other.deadline : seq > other.seq;
+    }
+  };
+
+  std::uint32_t attach(PluggableTimer *timer) {
+    if (free_slots.empty()) {
+      slots.push_back(Slot{timer, 0});
+      return static_cast<std::uint32_t>(slots.size() - 1);
+    }
+    const std::uint32_t slot = free_slots.back();
+    free_slots.pop_back();
+    slots[slot].timer = timer;
+    return slot;
+  }
+
+  void moved(std::uint32_t slot, PluggableTimer *timer) { slots[slot].timer = timer; }
+
+  // outdates the waits of slot (cancel, re-arm)
+  void invalidate(std::uint32_t slot) { ++slots[slot].generation; }
+
+  void schedule(std::uint32_t slot, PluggableClock::time_point deadline) {
+    waits.push(Wait{deadline, next_seq++, slot, ++slots[slot].generation});
+  }
+
+  // the timer is gone: O(1), its waits are skipped when they come up
+  void forget(std::uint32_t slot) {
+    slots[slot].timer = nullptr;
+    ++slots[slot].generation;
+    free_slots.push_back(slot);
+  }
+
+  std::priority_queue<Wait, std::vector<Wait>, std::greater<Wait>> waits;
+  std::uint64_t next_seq = 0;
+  std::vector<Slot> slots;
+  std::vector<std::uint32_t> free_slots;
+};
+
+
+/////////////////////////////////
+// PluggableTimer: the part of boost::asio::steady_timer that StateTime uses
+//
+// In real time everything is forwarded to a steady_timer (no extra cost but a branch: the
+// handler, and so its recycled memory, is passed on untouched). In virtual time the wait is
+// registered with VirtualTime, and the handler is posted to the io_service when virtual
+// time reaches the deadline (or with operation_aborted on cancel()). There the handler is
+// kept in a std::function and posted in a lambda, which allocate: the allocation-free
+// steady state of the machines (see bench_alloc) holds in real time only.
+/////////////////////////////////
+class PluggableTimer {
+public:
+  explicit PluggableTimer(boost::asio::io_service &io_service_) : io_service{io_service_}, timer{io_service_} {}
+
+  // (e.g. during construction of the states; in virtual time an outstanding wait moves along)
+  PluggableTimer(PluggableTimer &&other)
+    : io_service{other.io_service}, timer{std::move(other.timer)}, deadline{other.deadline}, slot{other.slot}, pending{std::move(other.pending)} {
+    other.slot = VirtualTime::no_slot;
+    other.pending = nullptr;
+    if (slot != VirtualTime::no_slot)
+      VirtualTime::instance().moved(slot, this);
+  }
+
+  PluggableTimer(const PluggableTimer &) = delete;
+  PluggableTimer &operator=(const PluggableTimer &) = delete;
+
+  ~PluggableTimer() {
+    if (slot != VirtualTime::no_slot)
+      VirtualTime::instance().forget(slot);
+  }
+
+  // like steady_timer: setting the expiry cancels an outstanding wait
+  std::size_t expires_at(PluggableClock::time_point t) {
+    if (!PluggableClock::is_virtual())
+      return timer.expires_at(t);
+    const std::size_t n = cancel();
+    deadline = t;
+    return n;
+  }
+
+  PluggableClock::time_point expires_at() const {
+    return PluggableClock::is_virtual() ? deadline : timer.expires_at();
+  }
+
+  template <typename Handler>
+  void async_wait(Handler &&handler) {
+    if (!PluggableClock::is_virtual()) {
+      timer.async_wait(std::forward<Handler>(handler));
+      return;
+    }
+    cancel();  // (one wait at a time is all StateTime needs)
+    pending = std::forward<Handler>(handler);
+    if (slot == VirtualTime::no_slot)
+      slot = VirtualTime::instance().attach(this);
+    VirtualTime::instance().schedule(slot, deadline);
+  }
+
+  std::size_t cancel() {
+    if (!PluggableClock::is_virtual())
+      return timer.cancel();
+    if (slot != VirtualTime::no_slot)
+      VirtualTime::instance().invalidate(slot);
+    if (!pending)
+      return 0;
+    post(boost::asio::error::operation_aborted);
+    return 1;
+  }
+
+private:
+  friend class VirtualTime;
+
+  void fire() {
+    if (pending)
+      post(boost::system::error_code{});
+  }
+
+  void post(boost::system::error_code err) {
+    std::function<void(const boost::system::error_code &)> handler;
+    handler.swap(pending);
+    io_service.post([handler, err]() { handler(err); });
+  }
+
+  boost::asio::io_service &io_service;
+  boost::asio::steady_timer timer;
+
+  // virtual time
+  PluggableClock::time_point deadline;
+  std::uint32_t slot = VirtualTime::no_slot;  // with VirtualTime, once it waited
+  std::function<void(const boost::system::error_code &)> pending;
+};
+
+
+
+inline std::size_t VirtualTime::run_until(boost::asio::io_service &io_service, PluggableClock::time_point until)
+{
+  std::size_t timeouts = 0;
+  for (;;) {
+    if (io_service.stopped())
+      io_service.restart();
+    io_service.poll();
+
+    if (waits.empty() || waits.top().deadline > until)
+      break;
+    const Wait w = waits.top();
+    waits.pop();
+    const Slot &slot = slots[w.slot];
+    if (w.generation != slot.generation)
+      continue;  // cancelled, re-armed or destroyed meanwhile
+
+    if (w.deadline > PluggableClock::virtual_now())
+      PluggableClock::virtual_now() = w.deadline;
+    slot.timer->fire();
+    ++timeouts;
+  }
+  if (until > PluggableClock::virtual_now())
+    PluggableClock::virtual_now() = until;
+  return timeouts;
+}
+
+#endif
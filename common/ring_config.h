@@ -0,0 +1,244 @@
+#ifndef RING_CONFIG_H
+#define RING_CONFIG_H
+
+#include <string>
+#include <vector>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+
+
+constexpr char ring_config_magic[8] = {'P', 'P', 'R', 'I', 'N', 'G', '0', '1'};
+
+
+/////////////////////////////////
+// RingConfig: timed rings (cycles of phases, each with its lifetime), loaded at startup
+//
+// A ring is what ping-pong is with 2 phases: a phase lasts its lifetime, then the timeout moves
+// on to the next phase (after the last: the first). One ring per tenant; all machines of a
+// tenant share it. Lifetimes (and names) of all rings sit in one flat array: ring r has the
+// phases [first(r), first(r) + num_phases(r)). So a machine only keeps ring and phase index:
+// more phases add no objects and no timers per machine.
+//
+// text format (one ring per line; '#' starts a comment; lifetimes in ms unless suffixed
+// with ns, us, ms or s):
+//
+//   ping_pong  statePing=1000 statePong=2000
+//   traffic    red=30s green=25s yellow=5s
+//
+// binary format (all integers little-endian, as written by the host):
+//
+//   char[8] magic "PPRING01"
+//   uint32  num_rings, uint32 num_phases (all rings)
+//   uint32  first[num_rings + 1]
+//   int64   lifetime_ns[num_phases]
+//   names:  ring 0, its phases, ring 1, its phases, ... (each: uint8 length, chars)
+//
+// load() takes either (by the magic).
+/////////////////////////////////
+class RingConfig {
+public:
+  static constexpr std::size_t max_phases = 256; // per ring (a phase index is 8 bits)
+
+  // no rings (see add_ring(), add_phase())
+  RingConfig() : firsts(1, 0) {}
+
+  // the ping-pong ring: statePing, statePong
+  static RingConfig ping_pong(std::chrono::nanoseconds ping = std::chrono::milliseconds(1000),
+                              std::chrono::nanoseconds pong = std::chrono::milliseconds(2000)) {
+    RingConfig config;
+    config.add_ring("ping_pong");
+    config.add_phase("statePing", ping);
+    config.add_phase("statePong", pong);
+    return config;
+  }
+
+  // the configuration of this process: set once at startup (before any machine is built), else ping_pong()
+  static RingConfig &current() {
+    static RingConfig config = ping_pong();
+    return config;
+  }
+
+  static RingConfig load(const std::string &path) {
+    std::ifstream in{path, std::ios::binary};
+    if (!in)
+      throw std::runtime_error{"RingConfig: cannot open " + path};
+    const std::string bytes{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    RingConfig config = (bytes.compare(0, sizeof(ring_config_magic), ring_config_magic, sizeof(ring_config_magic)) == 0) ? parse_binary(bytes, path) : parse_text(bytes, path);
+    if (config.num_rings() == 0)
+      throw std::runtime_error{"RingConfig: no ring in " + path};
+    return config;
+  }
+
+  void save_binary(const std::string &path) const {
+    std::string bytes{ring_config_magic, sizeof(ring_config_magic)};
+    put(bytes, static_cast<std::uint32_t>(num_rings()));
+    put(bytes, static_cast<std::uint32_t>(lifetimes.size()));
+    for (std::uint32_t f : firsts)
+      put(bytes, f);
+    for (std::int64_t ns : lifetimes)
+      put(bytes, ns);
+    for (std::size_t r = 0; r < num_rings(); ++r) {
+      put_name(bytes, ring_names[r]);
+      for (std::size_t p = 0; p < num_phases(r); ++p)
+        put_name(bytes, phase_names[first(r) + p]);
+    }
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    if (!out.write(bytes.data(), static_cast<std::streamsize>(bytes.size())))
+      throw std::runtime_error{"RingConfig: cannot write " + path};
+  }
+
+  std::size_t num_rings() const { return ring_names.size(); }
+  std::size_t num_phases(std::size_t ring) const { return firsts[ring + 1] - firsts[ring]; }
+
+  // position of phase 0 of ring in the flat arrays
+  std::size_t first(std::size_t ring) const { return firsts[ring]; }
+
+  std::chrono::nanoseconds lifetime(std::size_t ring, std::size_t phase) const {
+    return std::chrono::nanoseconds{lifetimes[firsts[ring] + phase]};
+  }
+
+  const std::string &ring_name(std::size_t ring) const { return ring_names[ring]; }
+  const std::string &phase_name(std::size_t ring, std::size_t phase) const { return phase_names[firsts[ring] + phase]; }
+
+  // for a machine of fixed states (lifetimes from ring): throws unless ring has num phases, one per state
+  void require_phases(std::size_t ring, std::size_t num, const std::string &states) const {
+    if (ring >= num_rings() || num_phases(ring) != num)
+      throw std::runtime_error{"RingConfig: ring " + std::to_string(ring) + " must have " + std::to_string(num) + " phases (" + states + ")"};
+  }
+
+  // index of the ring called name (num_rings() if there is none)
+  std::size_t find_ring(const std::string &name) const {
+    std::size_t r = 0;
+    while (r < num_rings() && ring_names[r] != name)
+      ++r;
+    return r;
+  }
+
+  // the flat arrays (all rings)
+  const std::vector<std::int64_t> &lifetimes_ns() const { return lifetimes; }
+  const std::vector<std::string>  &all_phase_names() const { return phase_names; }
+
+  // building (a ring gets the phases added after it)
+  void add_ring(const std::string &name) {
+    ring_names.push_back(name);
+    firsts.push_back(firsts.back());
+  }
+
+  void add_phase(const std::string &name, std::chrono::nanoseconds lifetime) {
+    if (ring_names.empty())
+      throw std::runtime_error{"RingConfig: phase " + name + " outside of a ring"};
+    if (num_phases(num_rings() - 1) == max_phases)
+      throw std::runtime_error{"RingConfig: more than 256 phases in ring " + ring_names.back()};
+    if (lifetime.count() <= 0)
+      throw std::runtime_error{"RingConfig: lifetime of phase " + name + " is not positive"};
+    phase_names.push_back(name);
+    lifetimes.push_back(lifetime.count());
+    ++firsts.back();
+  }
+
+private:
+  static RingConfig parse_text(const std::string &text, const std::string &path) {
+    RingConfig config;
+    std::istringstream lines{text};
+    std::string line;
+    for (std::size_t line_no = 1; std::getline(lines, line); ++line_no) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream words{line};
+      std::string ring;
+      if (!(words >> ring))
+        continue;
+      config.add_ring(ring);
+      for (std::string phase; words >> phase; ) {
+        const std::size_t eq = phase.find('=');
+        std::chrono::nanoseconds lifetime{0};
+        if (eq == std::string::npos || !parse_duration(phase.substr(eq + 1), lifetime))
+          throw std::runtime_error{"RingConfig: " + path + ":" + std::to_string(line_no) + ": expected phase=lifetime, got " + phase};
+        config.add_phase(phase.substr(0, eq), lifetime);
+      }
+      if (config.num_phases(config.num_rings() - 1) == 0)
+        throw std::runtime_error{"RingConfig: " + path + ":" + std::to_string(line_no) + ": ring " + ring + " has no phases"};
+    }
+    return config;
+  }
+
+  // "1500" (ms), "250us", "2s", ...
+  static bool parse_duration(const std::string &s, std::chrono::nanoseconds &d) {
+    char *end = nullptr;
+    const double v = std::strtod(s.c_str(), &end);
+    if (end == s.c_str())
+      return false;
+    const std::string unit{end};
+    double scale;
+    if      (unit == "ns")                scale = 1;
+    else if (unit == "us")                scale = 1e3;
+    else if (unit == "ms" || unit == "")  scale = 1e6;
+    else if (unit == "s")                 scale = 1e9;
+    else                                  return false;
+    const double ns = v * scale + 0.5;
+    if (!(std::fabs(ns) < 9.2e18)) // nan, inf, or beyond int64_t (strtod takes them all)
+      return false;
+    d = std::chrono::nanoseconds{static_cast<std::int64_t>(ns)};
+    return true;
+  }
+
+  static RingConfig parse_binary(const std::string &bytes, const std::string &path) {
+    std::size_t pos = sizeof(ring_config_magic);
+    const auto need = [&](std::size_t n) {
+      if (bytes.size() - pos < n)
+        throw std::runtime_error{"RingConfig: truncated " + path};
+    };
+    const auto get32 = [&]() { need(4); std::uint32_t v; std::memcpy(&v, bytes.data() + pos, 4); pos += 4; return v; };
+    const auto get64 = [&]() { need(8); std::int64_t  v; std::memcpy(&v, bytes.data() + pos, 8); pos += 8; return v; };
+    const auto name  = [&]() { need(1); const std::size_t n = static_cast<unsigned char>(bytes[pos++]); need(n); pos += n; return bytes.substr(pos - n, n); };
+
+    const std::uint32_t num_rings  = get32();
+    const std::uint32_t num_phases = get32();
+    need((num_rings + std::size_t{1}) * 4 + std::size_t{num_phases} * 8); // (before allocating by the counts)
+    std::vector<std::uint32_t> first(num_rings + std::size_t{1});
+    for (std::uint32_t &f : first)
+      f = get32();
+    std::vector<std::int64_t> lifetime(num_phases);
+    for (std::int64_t &ns : lifetime)
+      ns = get64();
+    if (first.front() != 0 || first.back() != num_phases)
+      throw std::runtime_error{"RingConfig: inconsistent " + path};
+    for (std::uint32_t r = 0; r < num_rings; ++r)  // (so every ring's phases are within lifetime[])
+      if (first[r + 1] < first[r] || first[r + 1] > num_phases)
+        throw std::runtime_error{"RingConfig: inconsistent " + path};
+
+    RingConfig config;
+    for (std::uint32_t r = 0; r < num_rings; ++r) {
+      config.add_ring(name());
+      for (std::uint32_t p = first[r]; p < first[r + 1]; ++p)
+        config.add_phase(name(), std::chrono::nanoseconds{lifetime[p]});
+    }
+    return config;
+  }
+
+  template <typename T>
+  static void put(std::string &bytes, T v) { bytes.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+
+  static void put_name(std::string &bytes, const std::string &name) {
+    const std::size_t n = (name.size() < 255) ? name.size() : 255;
+    bytes.push_back(static_cast<char>(n));
+    bytes.append(name, 0, n);
+  }
+
+  std::vector<std::string>   ring_names;
+  std::vector<std::uint32_t> firsts;       // per ring, plus one past the last: phase i of ring r is at firsts[r] + i
+  std::vector<std::int64_t>  lifetimes;    // ns, flat (all rings)
+  std::vector<std::string>   phase_names;  // flat (all rings)
+};
+
+#endif
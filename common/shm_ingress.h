@@ -0,0 +1,291 @@
+#ifndef SHM_INGRESS_H
+#define SHM_INGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+
+#include "event_ring.h"
+#include "span.h"
+
+
+
+// one event from another process: its id (EventID) and, optionally, when it was sent
+// (steady_clock: the same clock in every process of the host; 0: not stamped)
+struct ShmEventRecord {
+  std::int64_t sent_ns;
+  std::uint8_t eid;
+};
+
+constexpr char shm_ring_magic[8] = {'P', 'P', 'S', 'H', 'M', 'R', '0', '1'};
+
+
+
+/////////////////////////////////
+// ShmEventRing: an EventRing of ShmEventRecords in a POSIX shared memory segment
+//
+// The consumer create()s the segment (/dev/shm/<name>, removed again by its destructor);
+// producers in other processes attach() to it by name. The segment holds
+//
+//   magic "PPSHMR01", record size and capacity (checked on attach)
+//   wake   32-bit futex word
+//   ring   EventRing<ShmEventRecord, capacity> (lock-free atomics are address-free, so they
+//          work between processes)
+//
+// The wakeup protocol is the one of EventRing: only the push that finds the consumer idle
+// increments wake and FUTEX_WAKEs it (one system call per wakeup, none per event while the
+// consumer is busy). A producer that dies between claiming and publishing a slot stalls the
+// ring at that slot.
+/////////////////////////////////
+class ShmEventRing {
+public:
+  static constexpr std::size_t capacity = 4096;
+  using Ring = EventRing<ShmEventRecord, capacity>;
+
+  static_assert(std::atomic<std::size_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+                "the ring is shared between processes: its atomics must be lock-free");
+
+  static ShmEventRing create(const std::string &name) { return ShmEventRing{name, true}; }
+  static ShmEventRing attach(const std::string &name) { return ShmEventRing{name, false}; }
+
+  ShmEventRing(ShmEventRing &&other) : name{std::move(other.name)}, shared{other.shared}, owner{other.owner} {
+    other.shared = nullptr;
+  }
+
+  ShmEventRing(const ShmEventRing &) = delete;
+  ShmEventRing &operator=(const ShmEventRing &) = delete;
+
+  ~ShmEventRing() {
+    if (!shared)
+      return;
+    if (owner) {
+      shared->~Shared();
+      ::shm_unlink(name.c_str());
+    }
+    ::munmap(shared, sizeof(Shared));
+  }
+
+  ////// producer (any process, any thread)
+
+  // waits (yields) while the ring is full
+  void push(const ShmEventRecord &record) {
+    bool wakeup;
+    while (!shared->ring.push(record, wakeup))
+      std::this_thread::yield();
+    if (wakeup) {
+      shared->wake.fetch_add(1, std::memory_order_release);
+      futex(FUTEX_WAKE, 1);
+    }
+  }
+
+  ////// consumer (the process that created the ring, one thread)
+
+  Ring &ring() { return shared->ring; }
+
+  std::uint32_t wake_count() const { return shared->wake.load(std::memory_order_acquire); }
+
+  // sleeps until wake_count() is no longer seen (returns at once if it already changed)
+  void wait(std::uint32_t seen) { futex(FUTEX_WAIT, seen); }
+
+  // wakes wait() without an event (e.g. to stop)
+  void interrupt() {
+    shared->wake.fetch_add(1, std::memory_order_release);
+    futex(FUTEX_WAKE, INT_MAX);
+  }
+
+private:
+  struct Shared {
+    char          magic[8];
+    std::uint32_t record_size;
+    std::uint32_t ring_capacity;
+    alignas(64) std::atomic<std::uint32_t> wake;
+    Ring ring;
+  };
+
+  ShmEventRing(const std::string &name_, bool create_) : name{name_.empty() || name_[0] != '/' ? "/" + name_ : name_}, owner{create_} {
+    const int fd = ::shm_open(name.c_str(), owner ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+    if (fd < 0) {
+      const int err = errno;
+      throw std::runtime_error{std::string{"ShmEventRing: cannot "} + (owner ? "create " : "attach to ") + name + ": " + std::strerror(err) +
+                               ((owner && err == EEXIST) ? " (another consumer, or left behind by one that crashed: if none runs, rm /dev/shm" + name + ")" : "")};
+    }
+    struct ::stat st;
+    if ((owner && ::ftruncate(fd, sizeof(Shared)) != 0) || ::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Shared)) {
+      ::close(fd);
+      if (owner)
+        ::shm_unlink(name.c_str());
+      throw std::runtime_error{"ShmEventRing: wrong size of " + name};
+    }
+    void *p = ::mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      if (owner)
+        ::shm_unlink(name.c_str());
+      throw std::runtime_error{"ShmEventRing: cannot map " + name};
+    }
+    if (owner) {
+      shared = new (p) Shared{};
+      shared->record_size   = sizeof(ShmEventRecord);
+      shared->ring_capacity = capacity;
+      std::atomic_thread_fence(std::memory_order_release);
+      std::memcpy(shared->magic, shm_ring_magic, sizeof(shm_ring_magic)); // (last: attach() checks it)
+    }
+    else {
+      shared = static_cast<Shared *>(p);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (std::memcmp(shared->magic, shm_ring_magic, sizeof(shm_ring_magic)) != 0 || shared->record_size != sizeof(ShmEventRecord) ||
+          shared->ring_capacity != capacity) {
+        ::munmap(p, sizeof(Shared));
+        shared = nullptr;
+        throw std::runtime_error{"ShmEventRing: " + name + " is not an event ring (of this version)"};
+      }
+    }
+  }
+
+  void futex(int op, std::uint32_t val) {
+    // not FUTEX_PRIVATE_FLAG: waiter and wakers are in different processes
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&shared->wake), op, val, nullptr, nullptr, 0);
+  }
+
+  std::string name;
+  Shared *shared = nullptr;
+  bool    owner;
+};
+
+
+
+/////////////////////////////////
+// ShmIngress: events from other processes (ShmEventRing) handed to a handler on an io_service
+//
+// The cross-process counterpart of EventIngress. A waiter thread sleeps on the futex of the ring;
+// when a producer wakes it, it posts a drain to the io_service, which hands the events in batches
+// (events[eid]: the event of an id; ids past the table are dropped) to handler, re-posting itself
+// between batches so that timers are not starved. Before going idle, the drain keeps polling the
+// ring for spin (again by re-posting itself): producers then find the consumer busy and deliver
+// with no system call at all, at the price of a busy core. spin 0: idle at once.
+// stamps() are the sent_ns of the batch, valid within handler.
+/////////////////////////////////
+template <typename Event>
+class ShmIngress {
+public:
+  using Handler = std::function<void(Span<const Event>)>;
+
+  ShmIngress(boost::asio::io_service &io_service_, const std::string &name, Span<const Event> events_, Handler handler_,
+             std::chrono::nanoseconds spin_ = std::chrono::nanoseconds{0}, std::size_t batch_size_ = 256)
+    : io_service{io_service_}, shm{ShmEventRing::create(name)}, events(events_.begin(), events_.end()),
+      handler{std::move(handler_)}, spin{spin_}, batch_size{batch_size_}
+  {
+    batch.reserve(batch_size);
+    stamp.reserve(batch_size);
+    waiter = std::thread{[this]() { wait(); }};
+  }
+
+  ShmIngress(const ShmIngress &) = delete;
+  ShmIngress &operator=(const ShmIngress &) = delete;
+
+  ~ShmIngress() { cancel(); }
+
+  // stop waking the io_service (pending drains return without handling anything)
+  void cancel() {
+    if (!waiter.joinable())
+      return;
+    stopped.store(true, std::memory_order_relaxed);
+    shm.interrupt();
+    waiter.join();
+  }
+
+  Span<const std::int64_t> stamps() const { return Span<const std::int64_t>{stamp.data(), stamp.size()}; }
+
+  std::uint64_t wakeups() const { return num_wakeups.load(std::memory_order_relaxed); }
+  std::uint64_t dropped() const { return num_dropped; } // unknown event ids
+
+private:
+  // waiter thread: one drain per wakeup of a producer
+  void wait() {
+    std::uint32_t seen = shm.wake_count();
+    while (!stopped.load(std::memory_order_relaxed)) {
+      shm.wait(seen);
+      const std::uint32_t now = shm.wake_count();
+      if (now != seen && !stopped.load(std::memory_order_relaxed)) {
+        seen = now;
+        num_wakeups.fetch_add(1, std::memory_order_relaxed);
+        boost::asio::post(io_service, [this]() { idle_since = std::chrono::steady_clock::now(); drain(); });
+      }
+    }
+  }
+
+  // (cancel() stops it: at the start of a drain that was posted before, and after every handler call)
+  void drain() {
+    for (;;) {
+      if (stopped.load(std::memory_order_relaxed))
+        return;
+      batch.clear();
+      stamp.clear();
+      const std::size_t n = shm.ring().drain([this](const ShmEventRecord &record) {
+          if (record.eid >= events.size()) {
+            ++num_dropped;
+            return;
+          }
+          batch.push_back(events[record.eid]);
+          stamp.push_back(record.sent_ns);
+        }, batch_size);
+      if (!batch.empty())
+        handler(Span<const Event>{batch.data(), batch.size()});
+      if (stopped.load(std::memory_order_relaxed)) // (e.g. the handler quit)
+        return;
+      if (n == batch_size) { // more to come: give others a turn
+        boost::asio::post(io_service, [this]() { drain(); });
+        return;
+      }
+      if (n > 0) {
+        idle_since = std::chrono::steady_clock::now();
+        continue;
+      }
+      if (spin.count() > 0 && std::chrono::steady_clock::now() - idle_since < spin) {
+        std::this_thread::yield(); // (a producer may be waiting for this core)
+        boost::asio::post(io_service, [this]() { drain(); }); // keep polling (producers need no wakeup meanwhile)
+        return;
+      }
+      if (shm.ring().try_idle())
+        return;
+    }
+  }
+
+  boost::asio::io_service &io_service;
+  ShmEventRing shm;
+  std::vector<Event> events;  // of the ids
+  Handler handler;
+  std::chrono::nanoseconds spin;
+  std::size_t batch_size;
+
+  std::vector<Event>        batch;
+  std::vector<std::int64_t> stamp;  // of batch
+  std::chrono::steady_clock::time_point idle_since;  // last event (for spin)
+  std::uint64_t num_dropped = 0;
+
+  std::atomic<bool>          stopped{false};
+  std::atomic<std::uint64_t> num_wakeups{0};
+  std::thread waiter;
+};
+
+#endif
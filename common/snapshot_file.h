@@ -0,0 +1,199 @@
+#ifndef SNAPSHOT_FILE_H
+#define SNAPSHOT_FILE_H
+
+#include <string>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "span.h"
+
+
+
+/////////////////////////////////
+// snapshot file format (all integers little-endian, as written by the host)
+//
+//   SnapshotHeader                      (snapshot_header_size bytes)
+//   MachineSnapshot[count]              (one per machine / instance, 16 bytes each)
+//
+// state: 0 = statePing, 1 = statePong (the same in every realization, so a snapshot of one
+// can be restored into another); in a timed ring: the phase, and ring the ring (see ring_config.h). deadline_ns: absolute steady_clock deadline of the running
+// lifetime-timer, snapshot_no_deadline if there is none. steady_clock is CLOCK_MONOTONIC,
+// which keeps running across restarts of the process (not across a reboot: see clock_offset_ns()).
+/////////////////////////////////
+struct MachineSnapshot {
+  std::int64_t  deadline_ns;
+  std::uint32_t instance;
+  std::uint8_t  state;
+  std::uint8_t  timer_running;
+  std::uint16_t ring;          // 0 for ping-pong
+};
+
+struct SnapshotHeader {
+  char          magic[8];
+  std::uint32_t record_size;   // sizeof(MachineSnapshot)
+  std::uint32_t reserved;
+  std::uint64_t count;
+  std::int64_t  steady_ns;     // steady_clock and system_clock when the snapshot was taken
+  std::int64_t  system_ns;
+  char          boot_id[40];   // /proc/sys/kernel/random/boot_id (steady_clock restarts with the system)
+};
+
+constexpr char         snapshot_magic[8]     = {'P', 'P', 'S', 'N', 'A', 'P', '0', '1'};
+constexpr std::size_t  snapshot_header_size  = (sizeof(SnapshotHeader) + 63) & ~std::size_t{63};
+constexpr std::int64_t snapshot_no_deadline  = std::numeric_limits<std::int64_t>::max();
+
+
+namespace snapshot_detail {
+
+inline std::int64_t ns(std::chrono::steady_clock::time_point tp) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+inline std::int64_t ns(std::chrono::system_clock::time_point tp) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+inline void read_boot_id(char (&boot_id)[40]) {
+  std::memset(boot_id, 0, sizeof(boot_id));
+  std::ifstream in{"/proc/sys/kernel/random/boot_id"};
+  in.read(boot_id, sizeof(boot_id) - 1);
+}
+
+} // namespace snapshot_detail
+
+
+
+/////////////////////////////////
+// SnapshotWriter: writes count records straight into a memory-mapped file
+//
+// The snapshot goes to <path>.tmp; commit() syncs it and renames it to path, so a crash while
+// writing never leaves a half-written snapshot behind.
+/////////////////////////////////
+class SnapshotWriter {
+public:
+  SnapshotWriter(const std::string &path_, std::size_t count_) : path{path_}, count{count_} {
+    const std::string tmp = path + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw std::runtime_error{"SnapshotWriter: cannot open " + tmp};
+    size = snapshot_header_size + count * sizeof(MachineSnapshot);
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      ::close(fd);
+      throw std::runtime_error{"SnapshotWriter: cannot resize " + tmp};
+    }
+    void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      throw std::runtime_error{"SnapshotWriter: cannot map " + tmp};
+    base = static_cast<unsigned char *>(p);
+
+    SnapshotHeader *header = reinterpret_cast<SnapshotHeader *>(base);
+    std::memcpy(header->magic, snapshot_magic, sizeof(snapshot_magic));
+    header->record_size = sizeof(MachineSnapshot);
+    header->count       = count;
+    header->steady_ns   = snapshot_detail::ns(std::chrono::steady_clock::now());
+    header->system_ns   = snapshot_detail::ns(std::chrono::system_clock::now());
+    snapshot_detail::read_boot_id(header->boot_id);
+  }
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  ~SnapshotWriter() {
+    if (base)
+      ::munmap(base, size);
+  }
+
+  Span<MachineSnapshot> records() {
+    return Span<MachineSnapshot>{reinterpret_cast<MachineSnapshot *>(base + snapshot_header_size), count};
+  }
+
+  void commit() {
+    ::msync(base, size, MS_SYNC);
+    ::munmap(base, size);
+    base = nullptr;
+    if (std::rename((path + ".tmp").c_str(), path.c_str()) != 0)
+      throw std::runtime_error{"SnapshotWriter: cannot rename to " + path};
+  }
+
+private:
+  std::string path;
+  std::size_t count;
+  std::size_t size = 0;
+  unsigned char *base = nullptr;
+};
+
+
+
+/////////////////////////////////
+// SnapshotReader: maps a snapshot read-only (sequential read-ahead); records() are read in place
+/////////////////////////////////
+class SnapshotReader {
+public:
+  explicit SnapshotReader(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error{"SnapshotReader: cannot open " + path};
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < snapshot_header_size) {
+      ::close(fd);
+      throw std::runtime_error{"SnapshotReader: not a snapshot: " + path};
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      throw std::runtime_error{"SnapshotReader: cannot map " + path};
+    base = static_cast<const unsigned char *>(p);
+    ::madvise(const_cast<unsigned char *>(base), size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+    const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader *>(base);
+    if (std::memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0 || header->record_size != sizeof(MachineSnapshot) ||
+        snapshot_header_size + header->count * sizeof(MachineSnapshot) > size) {
+      ::munmap(const_cast<unsigned char *>(base), size);
+      throw std::runtime_error{"SnapshotReader: not a snapshot: " + path};
+    }
+    count = header->count;
+
+    // after a reboot steady_clock starts again from 0: carry the deadlines over via system_clock
+    char boot_id[40];
+    snapshot_detail::read_boot_id(boot_id);
+    if (std::memcmp(boot_id, header->boot_id, sizeof(boot_id)) != 0)
+      offset_ns = (snapshot_detail::ns(std::chrono::steady_clock::now()) - snapshot_detail::ns(std::chrono::system_clock::now()))
+                - (header->steady_ns - header->system_ns);
+  }
+
+  SnapshotReader(const SnapshotReader &) = delete;
+  SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+  ~SnapshotReader() {
+    ::munmap(const_cast<unsigned char *>(base), size);
+  }
+
+  Span<const MachineSnapshot> records() const {
+    return Span<const MachineSnapshot>{reinterpret_cast<const MachineSnapshot *>(base + snapshot_header_size), count};
+  }
+
+  // add to a deadline_ns of records() to get a deadline on this system's steady_clock (0 unless rebooted since)
+  std::int64_t clock_offset_ns() const { return offset_ns; }
+
+private:
+  std::size_t size = 0;
+  const unsigned char *base = nullptr;
+  std::size_t count = 0;
+  std::int64_t offset_ns = 0;
+};
+
+#endif
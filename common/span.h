@@ -0,0 +1,37 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cstddef>
+
+
+
+/////////////////////////////////
+// Span: non-owning view of contiguous elements (the part of C++20's std::span we need)
+/////////////////////////////////
+template <typename T>
+class Span {
+public:
+  constexpr Span() : ptr{nullptr}, count{0} {}
+  constexpr Span(T *ptr_, std::size_t count_) : ptr{ptr_}, count{count_} {}
+
+  template <std::size_t N>
+  constexpr Span(T (&array)[N]) : ptr{array}, count{N} {}
+
+  template <typename Container> // std::vector, std::array, ...
+  constexpr Span(Container &c) : ptr{c.data()}, count{c.size()} {}
+
+  constexpr T          *data()  const { return ptr; }
+  constexpr std::size_t size()  const { return count; }
+  constexpr bool        empty() const { return count == 0; }
+  constexpr T          *begin() const { return ptr; }
+  constexpr T          *end()   const { return ptr + count; }
+  constexpr T &operator[](std::size_t i) const { return ptr[i]; }
+
+  constexpr Span subspan(std::size_t offset, std::size_t n) const { return Span{ptr + offset, n}; }
+
+private:
+  T *ptr;
+  std::size_t count;
+};
+
+#endif
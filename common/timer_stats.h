@@ -0,0 +1,87 @@
+#ifndef TIMER_STATS_H
+#define TIMER_STATS_H
+
+#include <ostream>
+
+#include <cstdint>
+
+#include "hdr_histogram.h"
+
+
+
+/////////////////////////////////
+// TimerStats: accuracy of the lifetime-timers of one machine
+//
+// lateness   : actual fire - scheduled deadline of every timeout (HDR histogram; a timer that
+//              fires early counts as 0 and is counted in early())
+// phase error: a chain of timeouts (each timer armed from the previous deadline: DEventTimeout)
+//              should fire at chain start + sum of lifetimes. phase = actual fire - that ideal
+//              time point, computed here independently of the timers. With zero drift it stays
+//              at the lateness of the last timeout; if error accumulates, it grows with the chain.
+//
+// All times in nanoseconds (any epoch, but the same for deadlines and fire times).
+// Not thread-safe: owned by the machine, used on its thread.
+/////////////////////////////////
+class TimerStats {
+public:
+  // timer armed relative to now: a new chain starts
+  void armed(std::int64_t deadline_ns) {
+    ideal_ns     = deadline_ns;
+    chain_length = 0;
+    in_chain     = true;
+  }
+
+  // timer armed from the deadline of the timeout that just fired: the chain continues
+  void rearmed(std::int64_t lifetime_ns) {
+    if (in_chain)
+      ideal_ns += lifetime_ns;
+  }
+
+  void fired(std::int64_t deadline_ns, std::int64_t now_ns) {
+    const std::int64_t late = now_ns - deadline_ns;
+    if (late < 0)
+      ++num_early;
+    lateness.record(late < 0 ? 0 : static_cast<std::uint64_t>(late));
+
+    if (in_chain) {
+      phase_ns = now_ns - ideal_ns;
+      const std::int64_t abs_phase = (phase_ns < 0) ? -phase_ns : phase_ns;
+      if (abs_phase > max_abs_phase_ns)
+        max_abs_phase_ns = abs_phase;
+      if (++chain_length > longest_chain)
+        longest_chain = chain_length;
+    }
+  }
+
+  const HdrHistogram &lateness_ns() const { return lateness; }
+  std::uint64_t early() const             { return num_early; }
+  std::int64_t  phase_error_ns() const    { return phase_ns; }
+  std::int64_t  max_phase_error_ns() const { return max_abs_phase_ns; }
+  std::uint64_t longest_chain_length() const { return longest_chain; }
+
+  // one line per metric, "key value" pairs (easy to grep / scrape)
+  void report(std::ostream &os, const char *name = "timer") const {
+    os << name << " lateness_ns count " << lateness.count() << " early " << num_early
+       << " min " << lateness.min()
+       << " p50 " << lateness.value_at_percentile(50)
+       << " p90 " << lateness.value_at_percentile(90)
+       << " p99 " << lateness.value_at_percentile(99)
+       << " p99.9 " << lateness.value_at_percentile(99.9)
+       << " max " << lateness.max() << '\n'
+       << name << " phase_error_ns current " << phase_ns << " max_abs " << max_abs_phase_ns
+       << " longest_chain " << longest_chain << '\n';
+  }
+
+private:
+  HdrHistogram lateness;
+  std::uint64_t num_early = 0;
+
+  bool          in_chain         = false;
+  std::int64_t  ideal_ns         = 0;   // where the next timeout of the chain should fire
+  std::int64_t  phase_ns         = 0;   // of the last timeout
+  std::int64_t  max_abs_phase_ns = 0;
+  std::uint64_t chain_length     = 0;
+  std::uint64_t longest_chain    = 0;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <string>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "async_logger.h"
+
+
+
+/////////////////////////////////
+// trace file format (all integers little-endian, as written by the host)
+//
+//   TraceFileHeader                                   (trace_header_size bytes)
+//   block[0] .. block[num_blocks-1]                   (block_size bytes each)
+//
+// The blocks form a ring: when a block is full, recording continues in the next one
+// (overwriting the oldest), so the file never grows beyond its initial size. Every block
+// starts with a TraceBlockHeader; its records follow back to back:
+//
+//   varint  delta_ns   to the previous record of the block (first record: to base_ns)
+//   uint8   state      id from AsyncLogger::register_state(), name in the file header
+//   uint8   kind/event bit 7: 1 = exit, 0 = entry; bits 0-6: event id (0x7f: none)
+//   varint  instance
+//
+// varint: LEB128 (7 bits per byte, low bits first, bit 7 set on all but the last byte)
+/////////////////////////////////
+struct TraceFileHeader {
+  static constexpr std::uint32_t max_states = 255;  // state ids >= max_states are recorded as max_states (no name)
+  static constexpr std::size_t   name_size  = 32;
+
+  char          magic[8];
+  std::uint32_t block_size;
+  std::uint32_t num_blocks;
+  std::uint32_t num_states;    // names[0 .. num_states-1] are valid
+  std::uint32_t reserved;
+  char          names[max_states][name_size];  // 0-terminated (truncated) state names
+};
+
+struct TraceBlockHeader {
+  std::uint64_t seq;           // 0: block unused; otherwise 1, 2, 3, ... in recording order
+  std::uint64_t base_ns;       // steady_clock
+  std::uint32_t used;          // bytes of records after this header
+  std::uint32_t num_records;
+};
+
+constexpr char          trace_magic[8]    = {'P', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr std::size_t   trace_header_size = (sizeof(TraceFileHeader) + 4095) & ~std::size_t{4095};
+constexpr std::uint8_t  trace_exit_bit    = 0x80;
+constexpr std::uint8_t  trace_no_event    = 0x7f;
+constexpr std::size_t   trace_max_record  = 10 + 1 + 1 + 5;  // varint64 + state + kind/event + varint32
+
+
+
+/////////////////////////////////
+// TraceRecorder: always-on recording of entries / exits into a memory-mapped trace file
+//
+// record() only encodes a few bytes into the mapping (no system call, no allocation); the
+// kernel writes the pages back, so the trace survives a crash of the process. The trace of
+// the previous run (an existing file) is kept as <path>.1 .
+//
+// Single writer: one TraceRecorder per thread (see current()).
+/////////////////////////////////
+class TraceRecorder {
+public:
+  static constexpr std::uint32_t default_block_size = 64 * 1024;
+
+  // max_bytes: size of the file (rolling limit)
+  TraceRecorder(const std::string &path, std::size_t max_bytes = 16 * 1024 * 1024, std::uint32_t block_size_ = default_block_size)
+    : block_size{block_size_}
+  {
+    const std::size_t blocks = (max_bytes > trace_header_size) ? (max_bytes - trace_header_size) / block_size : 0;
+    num_blocks = static_cast<std::uint32_t>((blocks < 2) ? 2 : blocks);
+    size = trace_header_size + std::size_t{num_blocks} * block_size;
+
+    ::rename(path.c_str(), (path + ".1").c_str());  // fails harmlessly if there is no previous trace
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw std::runtime_error{"TraceRecorder: cannot open " + path};
+    if (::ftruncate(fd, size) != 0) {
+      ::close(fd);
+      throw std::runtime_error{"TraceRecorder: cannot resize " + path};
+    }
+    void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error{"TraceRecorder: cannot map " + path};
+    }
+    base   = static_cast<unsigned char *>(p);
+    header = reinterpret_cast<TraceFileHeader *>(base);
+
+    // the file is all zeros (blocks unused, no state names yet)
+    std::memcpy(header->magic, trace_magic, sizeof(trace_magic));
+    header->block_size = block_size;
+    header->num_blocks = num_blocks;
+  }
+
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+  ~TraceRecorder() {
+    ::munmap(base, size);
+    ::close(fd);
+  }
+
+  // the recorder of the calling thread (nullptr: no recording)
+  static TraceRecorder *&current() {
+    static thread_local TraceRecorder *recorder = nullptr;
+    return recorder;
+  }
+
+  // hot path
+  void record(std::uint64_t timestamp_ns, LogRecord::Kind kind, std::uint16_t state, std::uint8_t event, std::uint32_t instance) {
+    if (state >= states_named)
+      name_states(state);
+    if (!block || block->used + trace_max_record > block_size - sizeof(TraceBlockHeader))
+      next_block(timestamp_ns);
+
+    unsigned char *out = reinterpret_cast<unsigned char *>(block + 1) + block->used;
+    unsigned char *const begin = out;
+    out = put_varint(out, timestamp_ns - last_ns);
+    *out++ = static_cast<std::uint8_t>((state < TraceFileHeader::max_states) ? state : TraceFileHeader::max_states);
+    *out++ = static_cast<std::uint8_t>(((kind == LogRecord::exit) ? trace_exit_bit : 0) | ((event < trace_no_event) ? event : trace_no_event));
+    out = put_varint(out, instance);
+
+    last_ns = timestamp_ns;
+    ++block->num_records;
+    block->used += static_cast<std::uint32_t>(out - begin);
+  }
+
+  static unsigned char *put_varint(unsigned char *out, std::uint64_t v) {
+    while (v >= 0x80) {
+      *out++ = static_cast<unsigned char>(v) | 0x80;
+      v >>= 7;
+    }
+    *out++ = static_cast<unsigned char>(v);
+    return out;
+  }
+
+private:
+  TraceBlockHeader *block_header(std::uint32_t b) {
+    return reinterpret_cast<TraceBlockHeader *>(base + trace_header_size + std::size_t{b} * block_size);
+  }
+
+  void next_block(std::uint64_t timestamp_ns) {
+    ++seq;
+    block = block_header(static_cast<std::uint32_t>((seq - 1) % num_blocks));
+    block->seq         = 0;  // invalid while it is being reset
+    block->base_ns     = timestamp_ns;
+    block->used        = 0;
+    block->num_records = 0;
+    block->seq         = seq;
+    last_ns            = timestamp_ns;
+  }
+
+  // slow path: once per state (copy its name into the file header)
+  void name_states(std::uint16_t state) {
+    if (state >= TraceFileHeader::max_states)
+      return;  // not named; the decoder prints its id
+    for (; states_named <= state; ++states_named) {
+      const std::string name = AsyncLogger::instance().state_name(states_named);
+      char *dst = header->names[states_named];
+      std::memset(dst, 0, TraceFileHeader::name_size);
+      std::memcpy(dst, name.data(), std::min(name.size(), TraceFileHeader::name_size - 1));
+    }
+    if (header->num_states < states_named)
+      header->num_states = states_named;
+  }
+
+  std::uint32_t block_size;
+  std::uint32_t num_blocks;
+  std::size_t size;
+  int fd;
+  unsigned char *base;
+  TraceFileHeader *header;
+
+  TraceBlockHeader *block = nullptr;  // current block
+  std::uint64_t seq = 0;              // of the current block
+  std::uint64_t last_ns = 0;          // timestamp of the previous record
+  std::uint32_t states_named = 0;
+};
+
+#endif
@@ -0,0 +1,60 @@
+// benchmark: process_events() adapter for msm::back::state_machine<StateMachine_> at batch sizes 1, 16, 256 and 4096
+//
+// usage: bench_batch [num_events]
+//
+// Timers are running (so that the amortized re-arming of timers shows up) and the log goes
+// to /dev/null.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "statemachine.h"
+
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+
+  std::ofstream devnull{"/dev/null"};
+  AsyncLogger::instance().set_output(&devnull);
+
+  // synthetic stream: mostly xchange, now and then ping / pong
+  std::vector<TaggedEvent> events(n);
+  for (std::size_t i = 0; i < n; ++i)
+    events[i] = TaggedEvent{(i % 7 == 0) ? eidI : (i % 11 == 0) ? eidO : eidX, {}};
+
+  std::vector<std::pair<std::size_t, double>> results;
+  for (std::size_t batch : {1, 16, 256, 4096}) {
+    boost::asio::io_service io_service;
+    StateMachine sm{"StateMachine", io_service};
+    sm.start();
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < n; i += batch) {
+      process_events(sm, Span<const TaggedEvent>{events}.subspan(i, std::min(batch, n - i)));
+      io_service.poll(); // the handlers of cancelled timers are part of the cost
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    results.emplace_back(batch, secs);
+
+    sm.stop();
+    io_service.poll();
+  }
+
+  AsyncLogger::instance().set_output(nullptr);
+
+  for (const auto &r : results)
+    std::cerr << "batch " << r.first << ": " << static_cast<long>(n / r.second) << " events/sec ("
+              << r.second * 1e9 / n << " ns/event)\n";
+
+  return 0;
+}
@@ -0,0 +1,367 @@
+// benchmark: compile time, compiler memory, code size and dispatch speed of MSM against the size of the transition table
+//
+// usage: bench_compile [--work DIR] [--time-limit SECS] [N M ...]
+//        bench_compile --generate N M back|favor_compile_time|back11   (the source to stdout)
+//
+// The ping pong table scaled up: N states S0..SN-1 and M events E0..EM-1, every state has a
+// row for every event (N x M rows, Si --Ej--> S(i+j+1)%N with an action). The table of
+// StateMachine_ has 10 rows. Default sizes: 2x4, 10x10, 10x20, 20x25 (500 rows, 50 times ours).
+//
+// Per size and back-end
+//   msm::back::state_machine                       (the default compile policy: dispatch tables)
+//   msm::back::state_machine<.., favor_compile_time>
+//   msm::back11::state_machine                     (Boost >= 1.77; reported as failed otherwise)
+// the generated source is compiled (-c, with the flags of this build) in DIR (default:
+// bench_compile_work), then linked and run:
+//   compile_s   wall time of the compiler
+//   rss_MB      peak memory of the compiler (wait4())
+//   object_B    size of the object file
+//   ns/event    process_event() of 10M random events (the event picked with a switch, as process_event(StateMachine &, TaggedEvent))
+// The compiler output goes to DIR/*.log; a failed compile reports its first error. A compile is
+// killed after SECS (default 300), and every compiler process is limited to the memory free at
+// start (no thrashing): a size over the limits reports "over the time limit" or "out of memory".
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef BENCH_CXX
+#define BENCH_CXX "c++"
+#endif
+#ifndef BENCH_CXX_FLAGS
+#define BENCH_CXX_FLAGS "-O3 -DNDEBUG"
+#endif
+#ifndef BENCH_INCLUDE
+#define BENCH_INCLUDE ""
+#endif
+
+
+
+enum class Backend { back, favor_compile_time, back11 };
+
+static const char *name(Backend backend)
+{
+  switch (backend) {
+  case Backend::back:               return "back";
+  case Backend::favor_compile_time: return "favor_compile_time";
+  default:                          return "back11";
+  }
+}
+
+static bool parse_backend(const std::string &s, Backend &backend)
+{
+  for (Backend b : {Backend::back, Backend::favor_compile_time, Backend::back11})
+    if (s == name(b)) {
+      backend = b;
+      return true;
+    }
+  return false;
+}
+
+
+////////////////
+// the generator
+//
+// mpl::vector takes at most 50 elements: the table is built from vectors of 50 rows with
+// insert_range (as a hand-written table of that size would have to be).
+////////////////
+static void generate(std::ostream &out, int n, int m, Backend backend)
+{
+  const int rows_per_chunk = 50;
+  const int rows = n * m;
+
+  out << "// generated by bench_compile --generate " << n << ' ' << m << ' ' << name(backend) << "\n"
+      << "// " << n << " states, " << m << " events, " << rows << " rows\n\n";
+  if (backend == Backend::back11)
+    out << "#if __has_include(<boost/msm/back11/state_machine.hpp>)\n\n";
+  out << "#define BOOST_MPL_CFG_NO_PREPROCESSED_HEADERS\n"
+      << "#define BOOST_MPL_LIMIT_VECTOR_SIZE " << rows_per_chunk << "\n\n"
+      << "#include <chrono>\n#include <cstdint>\n#include <cstdio>\n#include <vector>\n\n"
+      << "#include <boost/mpl/insert_range.hpp>\n"
+      << "#include <boost/mpl/vector.hpp>\n"
+      << "#include <boost/msm/front/state_machine_def.hpp>\n"
+      << "#include <boost/msm/front/functor_row.hpp>\n";
+  switch (backend) {
+  case Backend::back:
+    out << "#include <boost/msm/back/state_machine.hpp>\n";
+    break;
+  case Backend::favor_compile_time:
+    out << "#include <boost/msm/back/state_machine.hpp>\n"
+        << "#include <boost/msm/back/favor_compile_time.hpp>\n";
+    break;
+  case Backend::back11:
+    out << "#include <boost/msm/back11/state_machine.hpp>\n";
+    break;
+  }
+  out << "\nnamespace msm = boost::msm;\nnamespace mpl = boost::mpl;\nusing msm::front::Row;\n\n";
+
+  for (int j = 0; j < m; ++j)
+    out << "struct E" << j << " {};\n";
+  out << '\n';
+  for (int i = 0; i < n; ++i)
+    out << "struct S" << i << " : msm::front::state<> {};\n";
+
+  out << "\nstruct Count {\n"
+      << "  template <class EVT, class FSM, class SourceState, class TargetState>\n"
+      << "  void operator()(const EVT &, FSM &fsm, SourceState &, TargetState &) { ++fsm.transitions; }\n"
+      << "};\n\n"
+      << "struct Machine_ : public msm::front::state_machine_def<Machine_> {\n"
+      << "  std::uint64_t transitions = 0;\n"
+      << "  typedef S0 initial_state;\n\n";
+  int chunk = 0;
+  for (int row = 0; row < rows; row += rows_per_chunk, ++chunk) {
+    out << "  typedef mpl::vector<\n";
+    for (int r = row; r < rows && r < row + rows_per_chunk; ++r) {
+      const int i = r / m, j = r % m;
+      out << "    Row<S" << i << ", E" << j << ", S" << (i + j + 1) % n << ", Count>"
+          << (r + 1 < rows && r + 1 < row + rows_per_chunk ? ",\n" : "\n");
+    }
+    out << "  > rows" << chunk << ";\n";
+    if (chunk == 0)
+      out << "  typedef rows0 table0;\n";
+    else
+      out << "  typedef mpl::insert_range<table" << chunk - 1 << ", mpl::end<table" << chunk - 1 << ">::type, rows" << chunk
+          << ">::type table" << chunk << ";\n";
+  }
+  out << "  typedef table" << chunk - 1 << " transition_table;\n\n"
+      << "  template <class FSM, class Event>\n"
+      << "  void no_transition(const Event &, FSM &, int) {}\n"
+      << "};\n\n";
+
+  switch (backend) {
+  case Backend::back:
+    out << "typedef msm::back::state_machine<Machine_> Machine;\n";
+    break;
+  case Backend::favor_compile_time:
+    out << "typedef msm::back::state_machine<Machine_, msm::back::favor_compile_time> Machine;\n"
+        << "BOOST_MSM_BACK_GENERATE_PROCESS_EVENT(Machine)\n";
+    break;
+  case Backend::back11:
+    out << "typedef msm::back11::state_machine<Machine_> Machine;\n";
+    break;
+  }
+
+  out << "\nstatic void process_event(Machine &sm, unsigned eid)\n{\n  switch (eid) {\n";
+  for (int j = 0; j < m; ++j)
+    out << "  case " << j << ": sm.process_event(E" << j << "{}); break;\n";
+  out << "  }\n}\n\n"
+      << "int main()\n{\n"
+      << "  const std::size_t n = 10000000;\n"
+      << "  std::vector<unsigned char> eids(n);\n"
+      << "  std::uint64_t x = 1;\n"
+      << "  for (auto &eid : eids) {\n"
+      << "    x = x * 6364136223846793005ULL + 1442695040888963407ULL;\n"
+      << "    eid = static_cast<unsigned char>((x >> 33) % " << m << ");\n"
+      << "  }\n"
+      << "  Machine sm;\n"
+      << "  sm.start();\n"
+      << "  const auto t0 = std::chrono::steady_clock::now();\n"
+      << "  for (unsigned char eid : eids)\n"
+      << "    process_event(sm, eid);\n"
+      << "  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();\n"
+      << "  std::printf(\"ns_per_event %g transitions %llu\\n\", ns / n, static_cast<unsigned long long>(sm.transitions));\n"
+      << "  return sm.transitions == n ? 0 : 1;\n"
+      << "}\n";
+  if (backend == Backend::back11)
+    out << "\n#else\n#error \"no back11 back-end in this Boost (it needs Boost >= 1.77)\"\n#endif\n";
+}
+
+
+
+////////////////
+// the measurements
+////////////////
+struct Run {
+  bool   ok;
+  double secs;
+  long   max_rss_kb;   // of the process and its children (cc1plus)
+  bool   timed_out;
+};
+
+// a compile that does not fit is given up instead of thrashing for hours
+struct Limits {
+  double secs;        // wall time of the compiler (then its process group is killed)
+  rlim_t memory_B;    // address space of every compiler process (default: the memory free at start)
+};
+
+// runs args with stdout and stderr to log (within limits, if any)
+static Run run(const std::vector<std::string> &args, const std::string &log, const Limits *limits = nullptr)
+{
+  std::vector<char *> argv;
+  for (const std::string &arg : args)
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    ::setpgid(0, 0); // (the compiler driver and cc1plus: killed together)
+    const int fd = ::open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      ::dup2(fd, 1);
+      ::dup2(fd, 2);
+    }
+    if (limits) {
+      const struct ::rlimit memory{limits->memory_B, limits->memory_B};
+      ::setrlimit(RLIMIT_AS, &memory);
+    }
+    ::execvp(argv[0], argv.data());
+    ::_exit(127);
+  }
+  if (pid < 0)
+    return Run{false, 0, 0, false};
+
+  int status = 0;
+  struct ::rusage usage;
+  std::memset(&usage, 0, sizeof(usage));
+  bool timed_out = false;
+  for (;;) {
+    const pid_t done = ::wait4(pid, &status, limits ? WNOHANG : 0, &usage);
+    if (done == pid)
+      break;
+    if (done < 0)
+      return Run{false, 0, 0, false};
+    if (!timed_out && std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() > limits->secs) {
+      timed_out = true;
+      ::kill(-pid, SIGKILL);
+    }
+    ::usleep(100000);
+  }
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return Run{!timed_out && WIFEXITED(status) && WEXITSTATUS(status) == 0, secs, usage.ru_maxrss, timed_out};
+}
+
+static std::vector<std::string> split(const std::string &s)
+{
+  std::istringstream in{s};
+  std::vector<std::string> words;
+  for (std::string word; in >> word; )
+    words.push_back(word);
+  return words;
+}
+
+static std::string first_error(const std::string &log)
+{
+  std::ifstream in{log};
+  for (std::string line; std::getline(in, line); )
+    if (line.find("error") != std::string::npos || line.find("out of memory") != std::string::npos ||
+        line.find("memory exhausted") != std::string::npos)
+      return line.size() > 160 ? line.substr(0, 160) + " ..." : line;
+  return "(see " + log + ")";
+}
+
+static long file_size(const std::string &path)
+{
+  struct ::stat st;
+  return ::stat(path.c_str(), &st) == 0 ? static_cast<long>(st.st_size) : -1;
+}
+
+static void measure(const std::string &dir, int n, int m, Backend backend, const Limits &limits)
+{
+  const std::string base = dir + "/scaled_" + std::to_string(n) + "x" + std::to_string(m) + "_" + name(backend);
+  {
+    std::ofstream src{base + ".cpp"};
+    generate(src, n, m, backend);
+  }
+
+  std::vector<std::string> cxx{BENCH_CXX, "-std=c++17"};
+  for (const std::string &flag : split(BENCH_CXX_FLAGS))
+    cxx.push_back(flag);
+  for (const std::string &include : split(BENCH_INCLUDE))
+    cxx.push_back("-I" + include);
+
+  std::cerr.precision(3);
+  std::cerr << "  " << n << "x" << m << " (" << n * m << " rows) " << name(backend) << ": " << std::flush;
+
+  std::vector<std::string> compile = cxx;
+  for (const char *arg : {"-c", "-o"})
+    compile.push_back(arg);
+  compile.push_back(base + ".o");
+  compile.push_back(base + ".cpp");
+  const Run c = run(compile, base + ".log", &limits);
+  if (c.timed_out) {
+    std::cerr << "gave up after " << std::fixed << c.secs << " s (time limit)\n";
+    std::cerr.unsetf(std::ios::floatfield);
+    return;
+  }
+  if (!c.ok) {
+    std::cerr << "compile failed after " << std::fixed << c.secs << " s, " << c.max_rss_kb / 1024 << " MB: " << first_error(base + ".log") << '\n';
+    std::cerr.unsetf(std::ios::floatfield);
+    return;
+  }
+  std::cerr << "compile_s " << std::fixed << c.secs << ", rss_MB " << c.max_rss_kb / 1024 << ", object_B " << file_size(base + ".o");
+  std::cerr.unsetf(std::ios::floatfield);
+
+  std::vector<std::string> link = cxx;
+  link.push_back("-o");
+  link.push_back(base);
+  link.push_back(base + ".o");
+  if (!run(link, base + ".link.log").ok) {
+    std::cerr << ", link failed: " << first_error(base + ".link.log") << '\n';
+    return;
+  }
+  if (!run({base}, base + ".out").ok) {
+    std::cerr << ", run failed (see " << base << ".out)\n";
+    return;
+  }
+  std::ifstream out{base + ".out"};
+  std::string key;
+  double ns = 0;
+  out >> key >> ns;
+  std::cerr << ", ns/event " << ns << '\n';
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc == 5 && !std::strcmp(argv[1], "--generate")) {
+    Backend backend;
+    if (!parse_backend(argv[4], backend)) {
+      std::cerr << "unknown back-end " << argv[4] << " (back, favor_compile_time, back11)\n";
+      return 1;
+    }
+    generate(std::cout, std::atoi(argv[2]), std::atoi(argv[3]), backend);
+    return 0;
+  }
+
+  std::string dir = "bench_compile_work";
+  int arg = 1;
+  Limits limits{300, static_cast<rlim_t>(::sysconf(_SC_AVPHYS_PAGES)) * static_cast<rlim_t>(::sysconf(_SC_PAGE_SIZE))};
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    if (!std::strcmp(argv[arg], "--work"))
+      dir = argv[arg + 1];
+    else if (!std::strcmp(argv[arg], "--time-limit"))
+      limits.secs = std::atof(argv[arg + 1]);
+    else {
+      std::cerr << "unknown option " << argv[arg] << '\n';
+      return 1;
+    }
+  }
+  std::vector<std::pair<int, int>> sizes;
+  for (; arg + 1 < argc; arg += 2)
+    sizes.emplace_back(std::atoi(argv[arg]), std::atoi(argv[arg + 1]));
+  if (sizes.empty())
+    sizes = {{2, 4}, {10, 10}, {10, 20}, {20, 25}};
+  ::mkdir(dir.c_str(), 0755);
+
+  std::cerr << "compiler: " << BENCH_CXX << " -std=c++17 " << BENCH_CXX_FLAGS << ", limits: " << limits.secs << " s, "
+            << (limits.memory_B >> 20) << " MB, sources and logs in " << dir << "/\n";
+  for (const auto &size : sizes)
+    for (Backend backend : {Backend::back, Backend::favor_compile_time, Backend::back11})
+      measure(dir, size.first, size.second, backend, limits);
+  return 0;
+}
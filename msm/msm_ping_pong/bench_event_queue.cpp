@@ -0,0 +1,179 @@
+// benchmark: MSM's queued events under bursts, std::deque of boost::function against PooledEventQueue
+//
+// usage: bench_event_queue [num_bursts]
+//
+// message queue : an action sends a burst of B events into its own machine (process_event()
+//                 while processing: the back-end queues them and runs them after the action)
+// deferred      : B events sent while the machine is in a state that defers them, run on the
+//                 transition out of it
+// Per burst size B: ns per queued event, and heap allocations per queued event after a warmup,
+// for the default queue container (queue_container_deque) and queue_container_pool<64, 64>.
+// Then a burst over the capacity with queue_overflow_drop and queue_overflow_throw.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+
+#include <boost/msm/front/state_machine_def.hpp>
+#include <boost/msm/front/functor_row.hpp>
+#include <boost/msm/back/state_machine.hpp>
+
+#include "pooled_event_queue.h"
+
+
+
+static std::atomic<long> num_allocations{0};
+
+void *operator new(std::size_t size)
+{
+  ++num_allocations;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+
+namespace msm = boost::msm;
+namespace mpl = boost::mpl;
+
+using msm::front::Row;
+using msm::front::none;
+
+
+struct EventBurst {};  // Idle: send burst_size EventItems into the machine itself
+struct EventItem  {};  // counted (deferred in Busy)
+struct EventBusy  {};  // Idle <-> Busy
+
+struct Burst_ : public msm::front::state_machine_def<Burst_>
+{
+  struct Idle : msm::front::state<> {};
+  struct Busy : msm::front::state<> {
+    typedef mpl::vector<EventItem> deferred_events;
+  };
+
+  typedef Idle initial_state;
+
+  struct Send_Burst {
+    template <class EVT, class FSM, class SourceState, class TargetState>
+    void operator()(const EVT &, FSM &fsm, SourceState &, TargetState &) {
+      for (std::size_t i = 0; i < fsm.burst_size; ++i)
+        fsm.process_event(EventItem{});
+    }
+  };
+
+  struct Count {
+    template <class EVT, class FSM, class SourceState, class TargetState>
+    void operator()(const EVT &, FSM &fsm, SourceState &, TargetState &) { ++fsm.items; }
+  };
+
+  struct transition_table : mpl::vector<
+    Row<Idle, EventBurst, none, Send_Burst, none>,
+    Row<Idle, EventItem,  none, Count,      none>,
+    Row<Idle, EventBusy,  Busy>,
+    Row<Busy, EventBusy,  Idle>
+    >{};
+
+  template <class FSM, class Event>
+  void no_transition(const Event &, FSM &, int) {}
+
+  // (the back-end catches what an action throws, e.g. queue_overflow_throw)
+  template <class FSM, class Event>
+  void exception_caught(const Event &, FSM &, std::exception &e) { error = e.what(); }
+
+  std::size_t burst_size = 1;
+  std::size_t items = 0;
+  std::string error;
+};
+
+typedef msm::back::state_machine<Burst_>                                                         DequeMachine;
+typedef msm::back::state_machine<Burst_, queue_container_pool<64, 64>>                           PoolMachine;
+typedef msm::back::state_machine<Burst_, queue_container_pool<64, 64, 48, queue_overflow_drop>>  DropMachine;
+
+
+template <typename Machine>
+static void message_burst(Machine &sm)
+{
+  sm.process_event(EventBurst{});
+}
+
+template <typename Machine>
+static void deferred_burst(Machine &sm)
+{
+  sm.process_event(EventBusy{});
+  for (std::size_t i = 0; i < sm.burst_size; ++i)
+    sm.process_event(EventItem{});
+  sm.process_event(EventBusy{});
+}
+
+struct Result {
+  double ns_per_event;
+  double allocations_per_event;
+};
+
+template <typename Machine, typename Burst>
+static Result run(std::size_t burst_size, std::size_t num_bursts, Burst burst)
+{
+  Machine sm;
+  sm.burst_size = burst_size;
+  sm.start();
+  for (std::size_t i = 0; i < 100; ++i) // warmup
+    burst(sm);
+
+  const long before = num_allocations.load();
+  const std::size_t items = sm.items;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < num_bursts; ++i)
+    burst(sm);
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  const long allocations = num_allocations.load() - before;
+
+  const std::size_t queued = sm.items - items;
+  if (queued != burst_size * num_bursts)
+    std::cerr << "  (" << burst_size * num_bursts - queued << " events lost)\n";
+  return Result{ns / queued, static_cast<double>(allocations) / queued};
+}
+
+static void report(const char *name, Result deque, Result pool)
+{
+  std::cerr << "  " << name << ": deque " << deque.ns_per_event << " ns, " << deque.allocations_per_event << " allocations"
+            << " | pool " << pool.ns_per_event << " ns, " << pool.allocations_per_event << " allocations  (per queued event)\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t num_bursts = (argc > 1) ? std::atol(argv[1]) : 100000;
+
+  for (std::size_t burst_size : {1, 8, 64}) {
+    const std::size_t n = num_bursts * 8 / burst_size + 1;
+    std::cerr << "bursts of " << burst_size << " events\n";
+    report("message queue", run<DequeMachine>(burst_size, n, message_burst<DequeMachine>),
+                            run<PoolMachine>(burst_size, n, message_burst<PoolMachine>));
+    report("deferred     ", run<DequeMachine>(burst_size, n, deferred_burst<DequeMachine>),
+                            run<PoolMachine>(burst_size, n, deferred_burst<PoolMachine>));
+  }
+
+  std::cerr << "a burst of 100 events, capacity 64\n";
+  {
+    DropMachine sm;
+    sm.burst_size = 100;
+    sm.start();
+    sm.process_event(EventBurst{});
+    std::cerr << "  queue_overflow_drop : " << sm.items << " events run, " << sm.get_message_queue().dropped() << " dropped\n";
+  }
+  {
+    PoolMachine sm;
+    sm.burst_size = 100;
+    sm.start();
+    sm.process_event(EventBurst{});
+    std::cerr << "  queue_overflow_throw: " << sm.items << " events run, exception_caught(): " << sm.error << '\n';
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+// benchmark: scaling of ShardedRuntime (MSM machines, one io_service and pinned thread per shard)
+//
+// usage: bench_shards [max_shards] [num_machines] [num_events]
+//
+// Every shard processes its share of a synthetic event stream for its own machines, in batches
+// of 256 events (process_events(), timers running) posted to its io_service. Reported per
+// number of shards: events/sec in all, per shard, and speedup over 1 shard.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "sharded_runtime.h"
+
+
+
+static const std::size_t batch = 256;
+
+static double run(std::size_t num_shards, std::size_t num_machines, std::size_t num_events)
+{
+  ShardedRuntime runtime{num_shards, num_machines};
+  runtime.start();
+
+  const std::size_t per_shard = num_events / num_shards;
+  std::atomic<std::size_t> shards_done{0};
+  std::promise<void> all_done;
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (std::size_t s = 0; s < num_shards; ++s) {
+    // the shard keeps re-posting itself one batch at a time, so that its io_service (and timers) stay responsive
+    struct Generator {
+      std::size_t remaining;
+      std::uint64_t x;
+      std::atomic<std::size_t> *shards_done;
+      std::size_t num_shards;
+      std::promise<void> *all_done;
+      ShardedRuntime *runtime;
+      std::size_t s;
+      std::vector<TaggedEvent> events;
+
+      void operator()(ShardedRuntime::Shard &shard) {
+        // one batch for one machine at a time (as the input of a real machine arrives)
+        const std::size_t n = std::min(batch, remaining);
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        StateMachine &sm = *shard.machines[(x >> 33) % shard.machines.size()];
+        events.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+          x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+          events.push_back(TaggedEvent{static_cast<EventID>((x >> 20) % 3), {}}); // I, O, X
+        }
+        process_events(sm, events);
+        remaining -= n;
+        if (remaining > 0)
+          runtime->post_to_shard(s, std::move(*this));
+        else if (shards_done->fetch_add(1) + 1 == num_shards)
+          all_done->set_value();
+      }
+    };
+    runtime.post_to_shard(s, Generator{per_shard, s + 1, &shards_done, num_shards, &all_done, &runtime, s, {}});
+  }
+  all_done.get_future().wait();
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  runtime.stop();
+  return (per_shard * num_shards) / secs;
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t max_shards   = (argc > 1) ? std::atol(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t num_machines = (argc > 2) ? std::atol(argv[2]) : 10000;
+  const std::size_t num_events   = (argc > 3) ? std::atol(argv[3]) : 10000000;
+
+  AsyncLogger::instance().set_output(nullptr);
+  std::streambuf *cout_buf = std::cout.rdbuf(nullptr); // no "instantiating object ..."
+
+  std::cerr << "cores: " << std::thread::hardware_concurrency() << ", machines: " << num_machines
+            << ", events: " << num_events << "\n";
+
+  std::vector<std::size_t> shard_counts;
+  for (std::size_t shards = 1; shards < max_shards; shards *= 2)
+    shard_counts.push_back(shards);
+  shard_counts.push_back(max_shards);
+
+  double base = 0;
+  for (std::size_t shards : shard_counts) {
+    const double rate = run(shards, num_machines, num_events);
+    if (shards == 1)
+      base = rate;
+    std::cerr << "shards " << shards << ": " << static_cast<long>(rate) << " events/sec, "
+              << static_cast<long>(rate / shards) << " per shard, speedup " << rate / base << "x\n";
+  }
+
+  std::cout.rdbuf(cout_buf);
+  return 0;
+}
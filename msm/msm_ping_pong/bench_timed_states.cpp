@@ -0,0 +1,134 @@
+// benchmark: switching the timers of a machine with many timed states (see set_timers_running())
+//
+// usage: bench_timed_states [num_events]
+//
+// A ring of 64 StateTime states (EventX or a timeout: to the next one), EventT toggles the
+// timers in every state (one internal transition of the machine). The toggle either
+//   broadcast : visits every timed state (for_each_state_time()): the active one re-arms or
+//               stops its timer, every other one makes sure it has none (as Toggle_Timer did,
+//               state by state)
+//   active    : only the active state (active_state_time()); the others read the flag on entry
+// Reported: ns per EventT, and ns per event of a stream of 1 EventT to 4 EventX. The io_service
+// runs its ready handlers (cancelled waits) every 256 events.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <chrono>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/mpl/fold.hpp>
+#include <boost/mpl/push_back.hpp>
+#include <boost/mpl/range_c.hpp>
+
+#include "statemachine.h"
+
+
+
+static const int num_states = 64;
+
+template <int I>
+struct Timed : StateTime {
+  Timed() : StateTime{"Timed" + std::to_string(I), std::chrono::seconds(10)} {}
+};
+
+// Timed<I> --EventX / timeout--> Timed<I + 1>
+struct add_ring_rows {
+  template <typename Table, typename I>
+  struct apply {
+    typedef Timed<I::value> from;
+    typedef Timed<(I::value + 1) % num_states> to;
+    typedef typename mpl::push_back<typename mpl::push_back<Table, Row<from, EventX, to>>::type,
+                                    Row<from, DEventTimeout, to>>::type type;
+  };
+};
+
+struct Toggle_Timer_Broadcast
+{
+  template <class EVT, class FSM, class SourceState, class TargetState>
+  void operator()(const EVT &, FSM &fsm, SourceState &, TargetState &)
+  {
+    fsm.set_timer_running(!fsm.is_timer_running());
+    const StateTime *active = active_state_time(fsm);
+    for_each_state_time(fsm, [&](StateTime &state) { state.timer_running_changed(fsm, &state == active); });
+  }
+};
+
+struct Toggle
+{
+  template <class EVT, class FSM, class SourceState, class TargetState>
+  void operator()(const EVT &event, FSM &fsm, SourceState &source, TargetState &target)
+  {
+    if (fsm.broadcast)
+      Toggle_Timer_Broadcast{}(event, fsm, source, target);
+    else
+      Toggle_Timer{}(event, fsm, source, target);
+  }
+};
+
+struct Ring_ : public StateMachineBase<Ring_>, public TimedMachine
+{
+  Ring_(boost::asio::io_service &io_service_, bool broadcast_)
+    : StateMachineBase{"Ring"}, TimedMachine{io_service_}, broadcast{broadcast_} {}
+
+  typedef Timed<0> initial_state;
+
+  typedef mpl::fold<mpl::range_c<int, 0, num_states>, mpl::vector0<>, add_ring_rows>::type transition_table;
+
+  struct internal_transition_table : mpl::vector<
+    Internal<EventT, Toggle, none>
+    >{};
+
+  bool broadcast;
+};
+
+typedef msm::back::state_machine<Ring_> Ring;
+
+
+// ns per event of stream(i): eidT or eidX
+template <typename Stream>
+static double run(bool broadcast, std::size_t n, Stream stream)
+{
+  boost::asio::io_service io_service;
+  Ring sm{io_service, broadcast};
+  sm.start();
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < n; ++i) {
+    if (stream(i) == eidT)
+      sm.process_event(EventT{});
+    else
+      sm.process_event(EventX{});
+    if (i % 256 == 255)
+      io_service.poll();
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+  sm.stop();
+  io_service.poll();
+  return ns / n;
+}
+
+
+int main(int argc, char *argv[])
+{
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+
+  AsyncLogger::instance().set_output(nullptr);
+  std::streambuf *cout_buf = std::cout.rdbuf(nullptr); // no "instantiating object ..."
+
+  const auto toggles = [](std::size_t) { return eidT; };
+  const auto mixed   = [](std::size_t i) { return (i % 5 == 0) ? eidT : eidX; };
+
+  std::cerr << num_states << " timed states, " << n << " events\n";
+  for (bool broadcast : {true, false}) {
+    const double toggle_ns = run(broadcast, n, toggles);
+    const double mixed_ns  = run(broadcast, n, mixed);
+    std::cerr << "  " << (broadcast ? "broadcast" : "active   ") << ": EventT " << toggle_ns << " ns, 1 EventT to 4 EventX "
+              << mixed_ns << " ns/event\n";
+  }
+
+  std::cout.rdbuf(cout_buf);
+  return 0;
+}
@@ -1,268 +1,28 @@
 #include <iostream>
 #include <string>
 #include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <unistd.h>
 
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include <experimental/optional>
 
-#include <boost/msm/front/state_machine_def.hpp>
-#include <boost/msm/front/functor_row.hpp>
-#include <boost/msm/back/state_machine.hpp>
-
-
 #include <boost/asio.hpp>
-#include <boost/asio/steady_timer.hpp>
-#include <boost/signals2.hpp>
-
-
-namespace msm = boost::msm;
-namespace mpl = boost::mpl;
-
-using msm::front::Row;
-using msm::front::none;
-
-
-boost::asio::io_service io_service; // how can we avoid having this global?
-
-
-struct ASIO {
-  ASIO(boost::asio::io_service &io_service_) : io_service{io_service_} {}
-
-  boost::asio::io_service &io_service;
-};
-
-ASIO asio{io_service};              // still global. how can we avoid this?
-
-
-
-
-// Data for DEventTimeout
-struct TimeoutData {
-  std::chrono::steady_clock::time_point time_point;
-};
-
-//////////
-// events
-//////////
-struct EventI {};  // pIng    event: leave current state and go to ping state
-struct EventO {};  // pOng    event: leave current state and go to pong state
-struct EventX {};  // xchange event: change between ping and pong
-struct EventT {};  // toggle timer on/off
-struct DEventTimeout {
-  TimeoutData data;  /* Timeout Event
-                        This will be a DataEvent [DEvent] carrying the timestamp-of-timeout.
-                        Reason:
-                        if we timeout and enter a new state; and setup a new timer, there is a brief delay until that timer is running.
-                        This could cause timer drift.
-                        Therefore the timeout event carries the timestamp-of-timeout, so that the new timer can be
-                        setup (taking into consideration timestamp-of-timeout), leading to *no* timer drift!
-                     */
-};
-
-
-enum EventID {
-  eidI, // pIng
-  eidO, // pOng
-  eidX, // xchange
-  eidT, // toggle timer on/off
-  eidQ  // quit
-};
-
-
-
-
-// base to give states names
-struct NameBase {
-  NameBase(const std::string& name_) : name{name_} {}
-  
-  const std::string& get_name() const { return name; }
-  
-private:
-  const std::string name;
-};
-
-// base to print on_entry and on_exit messages
-struct StateBase : public msm::front::state<>, public NameBase
-{
-  StateBase(const std::string& name_) : NameBase{name_} { std::cout << "instantiating object " << get_name() << std::endl; }
-
-  template <class Event, class FSM>
-  void on_entry(const Event&, FSM&) {std::cout << "Entering: " << get_name() << std::endl;}
-  
-  template <class Event, class FSM>
-  void on_exit(const Event&,FSM&)   {std::cout << "Leaving : " << get_name() << std::endl;}
-};
-
-
-// state with lifetime-timers
-struct StateTime : StateBase
-{
-  StateTime(const std::string &name, std::chrono::milliseconds max_lifetime_, boost::asio::io_service &io_service_, bool timer_running_)
-    : StateBase{name}, max_lifetime{max_lifetime_}, timer{io_service_}, timer_running{timer_running_} {}
-  
-  template <class Event, class FSM>    // see overloads below
-  void on_entry(const Event &event, FSM &fsm)
-  {
-    if (timer_running) {
-      timer.expires_from_now(max_lifetime);
-      start_timer(fsm);
-    }
-    StateBase::on_entry(event, fsm);
-  }
-
-  template <class FSM>                 // overload: specializing Event to DEventTimeout
-  void on_entry(const DEventTimeout &event, FSM &fsm)
-  {
-    if (timer_running) {
-      timer.expires_at(event.data.time_point + max_lifetime);
-      start_timer(fsm);
-    }
-    StateBase::on_entry(event, fsm);
-  }
-  
-  template <typename FSM> // overload: specializing Event to EventT (toggle timer) -- this is currently not called (see set_timer_running() below)
-  void on_entry(const EventT &event, FSM &fsm) {
-    if (timer_running) {
-      timer.expires_from_now(max_lifetime);
-      start_timer(fsm);
-    } else {
-      timer.cancel();
-    }
-    // StateBase::on_entry(event, fsm); // don't call this line, or we would print entry to a state, in which we are already in
-  }
-  
-  template <typename Event, typename FSM>
-  void on_exit(const Event &event, FSM &fsm) {
-    timer.cancel();
-    StateBase::on_exit(event, fsm);
-  }
-  
-  template <typename FSM>
-  void set_timer_running(bool run, FSM &fsm, void *current_state) {
-    timer_running = run;
-    if (timer_running) {
-      if (current_state == this) {
-        /* because of the following, we don't send EventT into the state itself
-           (see overload specializing Event to EventT)
-        */
-        timer.expires_from_now(max_lifetime);
-        start_timer(fsm);
-      }
-    } else {
-      timer.cancel();
-    }
-  }
-  
-private:
-  template <typename FSM>
-  void timeout(const boost::system::system_error &err, FSM &fsm) {
-    if (err.code() == boost::system::errc::success)
-      fsm.process_event(DEventTimeout{{timer.expires_at()}});
-  }
-
-  template <typename FSM>
-  void start_timer(FSM &fsm) {
-    timer.async_wait(std::bind(&StateTime::timeout<FSM>, this, std::placeholders::_1, std::ref(fsm)));
-  }
-  
-  std::chrono::milliseconds max_lifetime;
-  boost::asio::steady_timer timer;
-  bool timer_running;
-};
-
-
-
-
-///////// Machine Base - VERION 0
-// struct StateTop_ : public msm::front::state_machine_def<StateTop_, StateBase>
-// {
-// public:
-//   StateTop_(const std::string& name_) {}
-
-
-
-///////// Machine Base - VERION 1
-template <typename Machine>
-struct StateMachineBase : public msm::front::state_machine_def<StateMachineBase<Machine>>, public NameBase
-{
-public:
-  StateMachineBase(const std::string& name_) : NameBase{name_} {}
-
-  template <class Event, class FSM>
-  void on_entry(const Event&, FSM&) {std::cout << "Entering: " << get_name() << std::endl;}
-  
-  template <class Event, class FSM>
-  void on_exit(const Event&,FSM&)   {std::cout << "Leaving : " << get_name() << std::endl;}
-
-};
-
-
-// front-end: define the FSM structure
-struct StateMachine_ : public StateMachineBase<StateMachine_>
-{
-  StateMachine_(const std::string& name_) : StateMachineBase{name_}, timer_running{true} {}
-
-
-  ////////////
-  // StatePing
-  ////////////
-  struct StatePing : StateTime {
-    StatePing() : StateTime("StatePing", std::chrono::milliseconds(1000), asio.io_service, true) {}
-  };
-
-  ////////////
-  // StatePong
-  ////////////
-  struct StatePong : StateTime {
-    //    StatePong() : StateTime("StatePong") {}
-    StatePong() : StateTime("StatePong", std::chrono::milliseconds(2000), asio.io_service, true) {}
-  };
-  
-
-  typedef StatePing initial_state;
-
-
-  struct Toggle_Timer
-  {
-    template <class EVT, class FSM, class SourceState, class TargetState>
-    void operator()(const EVT &, FSM &fsm, SourceState &state, TargetState &)
-    {
-      fsm.timer_running = !fsm.timer_running;
-      
-      StateMachine_::StatePing &pingState = static_cast<msm::back::state_machine<StateMachine_> &>(fsm).get_state<StateMachine_::StatePing &>();
-      StateMachine_::StatePong &pongState = static_cast<msm::back::state_machine<StateMachine_> &>(fsm).get_state<StateMachine_::StatePong &>();
-      pingState.set_timer_running(fsm.timer_running, fsm, &state);
-      pongState.set_timer_running(fsm.timer_running, fsm, &state);
-    }
-  };
-  
-  struct transition_table : mpl::vector<
-    _row<StatePing, EventX, StatePong>,
-    _row<StatePong, EventX, StatePing>,
-    
-    _row<StatePing, EventO, StatePong>, // next-state is StatePong in both lines. can we not group the start-states StatePing and StatePong together?
-    _row<StatePong, EventO, StatePong>,
-
-    _row<StatePing, EventI, StatePing>, // next-state is StatePing in both lines. can we not group the start-states StatePing and StatePong together?
-    _row<StatePong, EventI, StatePing>,
-
-    _row<StatePing, DEventTimeout, StatePong>,
-    _row<StatePong, DEventTimeout, StatePing>,
-    
-    Row<StatePing, EventT, none, Toggle_Timer, none>,
-    Row<StatePong, EventT, none, Toggle_Timer, none>
-    >{};
-
-private:
-  bool timer_running;
-};
-
-typedef msm::back::state_machine<StateMachine_> StateMachine;
-
 
+#include "statemachine.h"
+#include "event_ingress.h"
+#include "event_recording.h"
+#include "descriptor_input.h"
+#include "fast_signal.h"
+#include "snapshot_file.h"
 
 
 
@@ -277,19 +37,19 @@ public:
       switch (tolower(c)) {
       case 'i':
         //sm.process_event(EventI{}); // go to state ping
-        sig(eidI);
+        emit(eidI);
         break;
       case 'o':
         //sm.process_event(EventO{}); // go to state pong
-        sig(eidO);
+        emit(eidO);
         break;
       case 'x':
         //sm.process_event(EventX{}); // xchange state
-        sig(eidX);
+        emit(eidX);
         break;
       case 't':
         //sm.process_event(EventT{}); // toggle timer on/off
-        sig(eidT);
+        emit(eidT);
         break;
       case 'q':
         goto label_stop;
@@ -297,27 +57,114 @@ public:
       }
     }
   label_stop:
-    sig(eidQ);
+    emit(eidQ);
   }
 
-  void connect(std::function<void(T)> f) {
-    sig.connect(f);
+  // instead of std::cin: the events of a recording (paced: at their original pacing; else as fast as possible)
+  void replay(const std::vector<RecordedEvent> &events, bool paced) {
+    replay_events(events, paced, [this](std::uint8_t eid) {
+        if (eid != eidQ)
+          emit(static_cast<T>(eid));
+      });
+    emit(eidQ); // (also if the recording was cut short)
+  }
+
+  // every event from the interface is also recorded (nullptr: not recorded)
+  void set_recorder(EventRecorder *recorder_) {
+    recorder = recorder_;
+  }
+
+  template <typename F>
+  void connect(F f) {
+    sig.connect(std::move(f));
   }
   
   
   private:
-  boost::signals2::signal<void(T)> sig;
+  void emit(T eid) {
+    if (recorder)
+      recorder->record(eid);
+    sig(eid);
+  }
+
+  Signal<void(T)> sig; // (lock-free emission: see fast_signal.h)
+  EventRecorder *recorder = nullptr;
   boost::asio::io_service &io_service;
 };
 
 
-int main()
+static const char usage[] = "usage: ping_pong [--record file] [--replay file [--fast]] [--cin] [--snapshot file] [--ring file] [trace_file]\n";
+
+int main(int argc, char *argv[])
 {
+  const char *trace_path  = "ping_pong.trace";
+  const char *record_path = nullptr; // record the input events
+  const char *replay_path = nullptr; // input events from a recording instead of the keyboard
+  bool        fast        = false;   // replay as fast as the machine takes them
+  bool        cin_thread  = false;   // read std::cin char by char on a thread (instead of stdin in chunks on the io_service)
+  const char *snapshot_path = nullptr; // warm restart: state and timer deadline saved at exit, restored at start
+  const auto takes_value = [](const char *arg) {
+    for (const char *option : {"--record", "--replay", "--snapshot", "--ring"})
+      if (!std::strcmp(arg, option))
+        return true;
+    return false;
+  };
+  for (int i = 1; i < argc; ++i) {
+    if (takes_value(argv[i]) && i + 1 == argc) {
+      std::cerr << argv[i] << ": value missing\n" << usage;
+      return 1;
+    }
+    if (!std::strcmp(argv[i], "--record"))
+      record_path = argv[++i];
+    else if (!std::strcmp(argv[i], "--replay"))
+      replay_path = argv[++i];
+    else if (!std::strcmp(argv[i], "--fast"))
+      fast = true;
+    else if (!std::strcmp(argv[i], "--cin"))
+      cin_thread = true;
+    else if (!std::strcmp(argv[i], "--snapshot"))
+      snapshot_path = argv[++i];
+    else if (!std::strcmp(argv[i], "--ring")) {
+      try {
+        RingConfig::current() = RingConfig::load(argv[++i]); // lifetimes of statePing, statePong (see ring_config.h)
+        RingConfig::current().require_phases(0, 2, "statePing, statePong");
+      }
+      catch (const std::exception &e) {
+        std::cerr << e.what() << '\n' << usage;
+        return 1;
+      }
+    }
+    else if (!std::strncmp(argv[i], "--", 2)) {
+      std::cerr << argv[i] << ": unknown option\n" << usage;
+      return 1;
+    }
+    else
+      trace_path = argv[i];
+  }
+
+  // the keyboard: stdin, read on the io_service (see below), unless --replay or --cin
+  const int stdin_fd = (replay_path || cin_thread) ? -1 : ::dup(STDIN_FILENO);
+  if (!replay_path && !cin_thread && stdin_fd < 0) {
+    std::cerr << "stdin: " << std::strerror(errno) << " (no input)\n" << usage;
+    return 1;
+  }
+
+  std::vector<RecordedEvent> recording;
+  if (replay_path) {
+    try {
+      recording = load_event_recording(replay_path);
+    }
+    catch (const std::exception &e) {
+      std::cerr << e.what() << '\n';
+      return 1;
+    }
+  }
+
   std::cout <<
     "There are 2 states: statePing and statePong\n"
     "When timer running then:\n"
-    "Maximum lifetime of statePing is 1000 ms - it will then automatically transition to statePong;\n"
-    "Maximum lifetime of statePong is 2000 ms - it will then automatically transition to statePing.\n"
+    "Maximum lifetime of statePing is " << std::chrono::duration_cast<std::chrono::milliseconds>(RingConfig::current().lifetime(0, 0)).count() << " ms - it will then automatically transition to statePong;\n"
+    "Maximum lifetime of statePong is " << std::chrono::duration_cast<std::chrono::milliseconds>(RingConfig::current().lifetime(0, 1)).count() << " ms - it will then automatically transition to statePing.\n"
     "\n"
     "Keyboard-Input can cause transitions before the max-lifetime-timeouts:\n"
     "'x': xchange state\n"
@@ -328,9 +175,12 @@ int main()
     "\n"
     "...Hit Enter to start!" << std::flush;
 
-  std::cin.ignore();
+  if (!replay_path && (cin_thread || ::isatty(STDIN_FILENO))) // (std::cin would buffer more than a line of a pipe)
+    std::cin.ignore();
 
 
+  boost::asio::io_service io_service;
+
   //work to keep io_service busy
   std::experimental::optional<boost::asio::io_service::work> work(std::experimental::in_place, io_service);
   /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
@@ -338,47 +188,112 @@ int main()
   
   Interface interface{io_service};
 
-  
-  std::thread th(&Interface::run_statemachine, &interface);
 
-  StateMachine sm{"StateMachine"}; //, io_service};
-  sm.start();
+  // always-on trace of every entry / exit (see trace_recorder.h; decode with trace_decode)
+  TraceRecorder trace{trace_path};
+  TraceRecorder::current() = &trace; // the machine runs on this thread (io_service.run() below)
+
+  StateMachine sm{"StateMachine", io_service};
+  if (snapshot_path && ::access(snapshot_path, R_OK) == 0) { // warm restart (see snapshot_file.h)
+    SnapshotReader reader{snapshot_path};
+    if (reader.records().empty())
+      sm.start();
+    else
+      restore(sm, reader.records()[0], reader.clock_offset_ns());
+  }
+  else
+    sm.start();
   
-  interface.connect([&](EventID eid) {
+  // timer accuracy (lateness, phase error): reported on SIGUSR1 and at exit
+  boost::asio::signal_set report_signal{io_service, SIGUSR1};
+  std::function<void(const boost::system::error_code &, int)> on_report = [&](const boost::system::error_code &err, int) {
+      if (!err) {
+        sm.timer_stats().report(std::cerr);
+        report_signal.async_wait(on_report);
+      }
+    };
+  report_signal.async_wait(on_report);
+
+  /* events from the interface thread are handed over through a lock-free ring and
+     handled in batches on the io_service's thread (see event_ingress.h) */
+  const auto quit = [&]() {
+    if (snapshot_path) {        // for the warm restart
+      SnapshotWriter writer{snapshot_path, 1};
+      writer.records()[0] = snapshot(sm);
+      writer.commit();
+    }
+    sm.stop();                  // stop machine
+    work = std::experimental::nullopt; /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
+    report_signal.cancel();
+  };
+
+  EventIngress<EventID> ingress{io_service, [&](EventID eid) {
       switch (eid) {
       case eidI:
-        io_service.post(std::bind(static_cast<boost::msm::back::execute_return (StateMachine::*)(const EventI &event)>(&StateMachine::process_event),
-                                  &sm, EventI{})); // go to state ping
-        //sm.process_event(EventI{}); 
+        sm.process_event(EventI{}); // go to state ping
         break;
       case eidO:
-        io_service.post(std::bind(static_cast<boost::msm::back::execute_return (StateMachine::*)(const EventO &event)>(&StateMachine::process_event),
-                                  &sm, EventO{})); // go to state pong
-        //sm.process_event(EventO{});
+        sm.process_event(EventO{}); // go to state pong
         break;
       case eidX:
-        io_service.post(std::bind(static_cast<boost::msm::back::execute_return (StateMachine::*)(const EventX &event)>(&StateMachine::process_event),
-                                  &sm, EventX{})); // xchange state
-        //sm.process_event(EventX{});
+        sm.process_event(EventX{}); // xchange state
         break;
       case eidT:
-        io_service.post(std::bind(static_cast<boost::msm::back::execute_return (StateMachine::*)(const EventT &event)>(&StateMachine::process_event),
-                                  &sm, EventT{})); // toggle timer on/off
-        //sm.process_event(EventT{});
+        sm.process_event(EventT{}); // toggle timer on/off
         break;
       case eidQ:
-        io_service.post(std::bind(static_cast<void (StateMachine::*)()>(&StateMachine::stop), &sm)); // stop machine
-        work = std::experimental::nullopt; /* https://think-async.com/Asio/TipsAndTricks#Stopping_the_io_service_from_run */
+        quit();
         break;
       default:
         break;
       }
-    }
-    );
-  
+    }};
+
+  interface.connect([&](EventID eid) { ingress.post(eid); });
+
+  // input starts only now that it is connected (else early events, e.g. of a replay, are lost)
+  std::unique_ptr<EventRecorder> recorder;
+  if (record_path) {
+    recorder.reset(new EventRecorder{record_path});
+    interface.set_recorder(recorder.get());
+  }
+
+  const auto input_start = std::chrono::steady_clock::now();
+  std::thread th;
+  if (replay_path)
+    th = std::thread{[&]() { interface.replay(recording, !fast); }};
+  else if (cin_thread)
+    th = std::thread{&Interface::run_statemachine, &interface};
+
+  /* default: stdin is read in chunks on this thread, every chunk becomes one batch of events
+     (see descriptor_input.h) */
+  const TaggedEvent key_events[] = {{eidI, {}}, {eidO, {}}, {eidX, {}}, {eidT, {}}, {eidQ, {}}};
+  std::unique_ptr<DescriptorInput<TaggedEvent>> stdin_input;
+  if (stdin_fd >= 0)
+    stdin_input.reset(new DescriptorInput<TaggedEvent>{io_service, stdin_fd, "ioxtq", key_events, 'q',
+                                                       [&](Span<const TaggedEvent> events) {
+          if (recorder)
+            for (const TaggedEvent &event : events)
+              recorder->record(event.eid);
+          const bool last = (events[events.size() - 1].eid == eidQ);
+          process_events(sm, last ? events.subspan(0, events.size() - 1) : events);
+          if (last)
+            quit();
+        }});
+
   io_service.run();
-  
-  th.join();
+
+  if (th.joinable())
+    th.join();
+
+  if (replay_path) { // till the machine has handled the last event
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - input_start).count();
+    std::cerr << "replay " << recording.size() << " events in " << secs << " s ("
+              << static_cast<std::uint64_t>(recording.size() / secs) << " events/s)\n";
+  }
+
+  AsyncLogger::instance().flush(); // last "Leaving : ..."
+  sm.timer_stats().report(std::cerr);
   
   return 0;
 }
@@ -0,0 +1,259 @@
+#ifndef POOLED_EVENT_QUEUE_H
+#define POOLED_EVENT_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <boost/function.hpp>
+
+
+
+////////////////
+// queue_container_pool: MSM's message queue and deferred-event queue without heap allocations
+//
+// The back-end queues an event (process_event() while processing one, or a deferred event)
+// as boost::bind(&process_event_internal, this, event, source) in the container of its queue
+// container policy. By default that is a std::deque of boost::function: the bind object does not
+// fit boost::function's small buffer, so every queued event allocates, and so do the blocks of
+// the deque (even an unused deque allocates on construction).
+//
+//   msm::back::state_machine<Front, queue_container_pool<Capacity, DeferredCapacity, BufferSize, Overflow>>
+//
+// makes both queues a PooledEventQueue: a ring of Capacity (the deferred events:
+// DeferredCapacity) slots inside the machine, each one storing the bind object in place, in
+// BufferSize bytes (checked at compile time). Overflow (the ring is full) is
+//   queue_overflow_throw  std::runtime_error (inside an action, the back-end hands it to the
+//                         front-end's exception_caught(); the event is lost)
+//   queue_overflow_drop   the new event is lost, and counted (dropped())
+////////////////
+struct queue_overflow_throw {};
+struct queue_overflow_drop {};
+
+// the elements the back-end queues: boost::function<R ()>, or (deferred events) paired with their sequence number
+template <typename Element> struct queued_event_traits;
+
+template <typename R>
+struct queued_event_traits<boost::function<R ()>> {
+  typedef R result_type;
+  static constexpr bool with_sequence = false;
+};
+
+template <typename R>
+struct queued_event_traits<std::pair<boost::function<R ()>, char>> {
+  typedef R result_type;
+  static constexpr bool with_sequence = true;
+};
+
+
+
+/////////////////////////////////
+// PooledEventQueue: fixed-capacity ring of type-erased events (the container interface the
+// back-end uses: push_back, front, pop_front, empty, size, clear)
+//
+// front() hands out a QueuedEvent, a handle to the slot (small enough for boost::function's own
+// buffer: no allocation either). The back-end pops the event and then calls it, so a popped slot
+// stays taken till that call is done (events queued meanwhile go behind it); a slot is free once
+// every slot before it is. So Capacity counts the events queued plus the ones running.
+/////////////////////////////////
+template <typename Element, std::size_t Capacity, std::size_t BufferSize, typename Overflow>
+class PooledEventQueue {
+  typedef queued_event_traits<Element> traits;
+  typedef typename traits::result_type result_type;
+
+public:
+  static_assert(Capacity > 0, "PooledEventQueue: Capacity must be at least 1");
+
+  class QueuedEvent {
+  public:
+    QueuedEvent() = default;
+    QueuedEvent(PooledEventQueue *queue_, std::size_t index_) : queue{queue_}, index{index_} {}
+
+    // runs the event (once), then frees its slot
+    result_type operator()() const { return queue->run(index); }
+
+  private:
+    PooledEventQueue *queue = nullptr;
+    std::size_t index = 0;
+  };
+
+  typedef typename std::conditional<traits::with_sequence, std::pair<QueuedEvent, char>, QueuedEvent>::type value_type;
+  typedef value_type       &reference;
+  typedef const value_type &const_reference;
+  typedef std::size_t       size_type;
+
+  PooledEventQueue() = default;
+  PooledEventQueue(const PooledEventQueue &other) { copy_queued(other); }
+
+  PooledEventQueue &operator=(const PooledEventQueue &other) {
+    if (this != &other) {
+      clear();
+      copy_queued(other);
+    }
+    return *this;
+  }
+
+  ~PooledEventQueue() {
+    for (std::size_t i = first; i != tail; ++i)
+      if (slot(i).state != Slot::free)
+        slot(i).ops->destroy(slot(i).storage);
+  }
+
+  bool      empty() const { return head == tail; }
+  size_type size()  const { return tail - head; }
+  static constexpr size_type capacity() { return Capacity; }
+
+  std::uint64_t dropped() const { return num_dropped; } // (queue_overflow_drop)
+
+  // e: the bind object (message queue), or the pair of it and the sequence number (deferred events)
+  template <typename E>
+  void push_back(E &&e) {
+    if constexpr (traits::with_sequence)
+      emplace(std::forward<E>(e).first, e.second);
+    else
+      emplace(std::forward<E>(e), 0);
+  }
+
+  reference       front()       { return slot(head).value; }
+  const_reference front() const { return slot(head).value; }
+
+  void pop_front() {
+    slot(head).state = Slot::running;
+    ++head;
+  }
+
+  // the queued events (the running ones finish)
+  void clear() {
+    for (std::size_t i = head; i != tail; ++i) {
+      slot(i).ops->destroy(slot(i).storage);
+      slot(i).state = Slot::free;
+    }
+    tail = head;
+    reclaim();
+  }
+
+private:
+  struct Ops {
+    result_type (*invoke)(void *);
+    void (*destroy)(void *);
+    void (*clone)(const void *, void *);
+  };
+
+  template <typename F>
+  struct OpsOf {
+    static result_type invoke(void *f)                 { return (*static_cast<F *>(f))(); }
+    static void destroy(void *f)                       { static_cast<F *>(f)->~F(); }
+    static void clone(const void *from, void *to)      { new (to) F(*static_cast<const F *>(from)); }
+    static constexpr Ops ops{&invoke, &destroy, &clone};
+  };
+
+  struct Slot {
+    enum State : std::uint8_t { free, queued, running };
+
+    alignas(std::max_align_t) unsigned char storage[BufferSize];
+    const Ops *ops = nullptr;
+    value_type value;
+    State state = free;
+  };
+
+  Slot       &slot(std::size_t i)       { return slots[i % Capacity]; }
+  const Slot &slot(std::size_t i) const { return slots[i % Capacity]; }
+
+  template <typename F>
+  void emplace(F &&f, char sequence) {
+    typedef typename std::decay<F>::type Callable;
+    static_assert(sizeof(Callable) <= BufferSize, "PooledEventQueue: the queued event does not fit a slot (raise BufferSize)");
+    static_assert(alignof(Callable) <= alignof(std::max_align_t), "PooledEventQueue: the queued event is over-aligned");
+    if (tail - first == Capacity) {
+      overflow(Overflow{});
+      return;
+    }
+    Slot &s = slot(tail);
+    new (s.storage) Callable(std::forward<F>(f));
+    s.ops = &OpsOf<Callable>::ops;
+    set_value(s, tail, sequence);
+    s.state = Slot::queued;
+    ++tail;
+  }
+
+  void set_value(Slot &s, std::size_t index, char sequence) {
+    if constexpr (traits::with_sequence)
+      s.value = value_type{QueuedEvent{this, index}, sequence};
+    else {
+      (void)sequence;
+      s.value = QueuedEvent{this, index};
+    }
+  }
+
+  void overflow(queue_overflow_throw) {
+    throw std::runtime_error{"PooledEventQueue: full (" + std::to_string(Capacity) + " events queued or running)"};
+  }
+
+  void overflow(queue_overflow_drop) { ++num_dropped; }
+
+  result_type run(std::size_t index) {
+    struct Retire { // (also if the event throws)
+      PooledEventQueue &queue;
+      std::size_t index;
+      ~Retire() {
+        Slot &s = queue.slot(index);
+        s.ops->destroy(s.storage);
+        s.state = Slot::free;
+        queue.reclaim();
+      }
+    } retire{*this, index};
+    Slot &s = slot(index);
+    return s.ops->invoke(s.storage);
+  }
+
+  void reclaim() {
+    while (first != head && slot(first).state == Slot::free)
+      ++first;
+  }
+
+  // the queued events of other (not its running ones)
+  void copy_queued(const PooledEventQueue &other) {
+    for (std::size_t i = other.head; i != other.tail; ++i) {
+      if (tail - first == Capacity) {
+        overflow(Overflow{});
+        return;
+      }
+      const Slot &from = other.slot(i);
+      Slot &to = slot(tail);
+      from.ops->clone(from.storage, to.storage);
+      to.ops = from.ops;
+      if constexpr (traits::with_sequence)
+        set_value(to, tail, from.value.second);
+      else
+        set_value(to, tail, 0);
+      to.state = Slot::queued;
+      ++tail;
+    }
+  }
+
+  Slot slots[Capacity];
+  std::size_t first = 0;   // oldest slot not free
+  std::size_t head  = 0;   // front()
+  std::size_t tail  = 0;   // next push_back()
+  std::uint64_t num_dropped = 0;
+};
+
+
+
+template <std::size_t Capacity = 16, std::size_t DeferredCapacity = 16, std::size_t BufferSize = 48, typename Overflow = queue_overflow_throw>
+struct queue_container_pool
+{
+  typedef int queue_container_policy; // (how the back-end recognizes the policy)
+
+  template <class Element>
+  struct In
+  {
+    typedef PooledEventQueue<Element, queued_event_traits<Element>::with_sequence ? DeferredCapacity : Capacity, BufferSize, Overflow> type;
+  };
+};
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef SHARDED_RUNTIME_H
+#define SHARDED_RUNTIME_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <experimental/optional>
+
+#include <boost/asio.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "statemachine.h"
+
+
+
+////////////////
+// ShardedRuntime: many MSM machines in one process, one io_service per core
+//
+// N shards, each with its own io_service running on its own thread (pinned to a core) and its
+// own machines, constructed with that io_service (see StateMachine_): their timers run on it.
+// Machine id belongs to shard (id % N) and is machine (id / N) there. Events are routed by
+// machine id and posted to the owning shard, so a machine is only ever touched by one thread:
+// no locks in the state machines. Machines are constructed, started and stopped on their shard's
+// thread (their log records go to that thread's ring, see async_logger.h).
+////////////////
+class ShardedRuntime {
+public:
+  using MachineID = std::size_t;
+
+  struct Shard {
+    explicit Shard(std::size_t num_machines_) : work{std::experimental::in_place, io_service}, num_machines{num_machines_} {}
+
+    boost::asio::io_service io_service;
+    std::experimental::optional<boost::asio::io_service::work> work; // keep io_service.run() going
+    std::vector<std::unique_ptr<StateMachine>> machines;              // (filled on the shard's thread by start())
+    std::size_t num_machines;
+    std::thread thread;
+  };
+
+  ShardedRuntime(std::size_t num_shards, std::size_t num_machines, bool pin_threads = true) : pin{pin_threads} {
+    for (std::size_t s = 0; s < num_shards; ++s) {
+      // machines s, s+N, s+2N, ... live in shard s
+      const std::size_t local_machines = num_machines / num_shards + (s < num_machines % num_shards ? 1 : 0);
+      shards.emplace_back(new Shard{local_machines});
+    }
+  }
+
+  ~ShardedRuntime() { stop(); }
+
+  // start one thread per shard; every shard constructs and starts its machines on its own thread
+  void start() {
+    const unsigned num_cores = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t s = 0; s < shards.size(); ++s) {
+      Shard &shard = *shards[s];
+      const std::size_t num_shards = shards.size();
+      boost::asio::post(shard.io_service, [&shard, s, num_shards]() {
+          shard.machines.reserve(shard.num_machines);
+          for (std::size_t m = 0; m < shard.num_machines; ++m) {
+            const std::uint32_t id = static_cast<std::uint32_t>(s + m * num_shards); // (the MachineID: see shard_of())
+            shard.machines.emplace_back(new StateMachine{"StateMachine", shard.io_service, id});
+            shard.machines.back()->start();
+          }
+        });
+      shard.thread = std::thread([&shard]() { shard.io_service.run(); });
+      if (pin)
+        pin_to_core(shard.thread, s % num_cores);
+    }
+  }
+
+  // let every shard finish its queued events, stop its machines (their timers), then join the threads
+  void stop() {
+    for (auto &shard : shards) {
+      if (!shard->thread.joinable())
+        continue;
+      Shard *p = shard.get();
+      boost::asio::post(p->io_service, [p]() {
+          for (auto &sm : p->machines)
+            sm->stop();
+        });
+      p->work = std::experimental::nullopt;
+    }
+    for (auto &shard : shards)
+      if (shard->thread.joinable())
+        shard->thread.join();
+  }
+
+  std::size_t num_shards()              const { return shards.size(); }
+  std::size_t shard_of(MachineID id)    const { return id % shards.size(); }
+  std::size_t local_id(MachineID id)    const { return id / shards.size(); }
+  Shard      &shard(std::size_t s)            { return *shards[s]; }
+
+  // route event to machine id (thread-safe: runs on the owning shard's thread)
+  void post(MachineID id, TaggedEvent event) {
+    Shard &s = *shards[shard_of(id)];
+    const std::size_t local = local_id(id);
+    boost::asio::post(s.io_service, [&s, local, event]() { process_event(*s.machines[local], event); });
+  }
+
+  // run f(shard) on the thread of shard s
+  template <typename F>
+  void post_to_shard(std::size_t s, F &&f) {
+    Shard &sh = *shards[s];
+    boost::asio::post(sh.io_service, [&sh, f = std::forward<F>(f)]() mutable { f(sh); });
+  }
+
+private:
+  static void pin_to_core(std::thread &th, unsigned core) {
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    pthread_setaffinity_np(th.native_handle(), sizeof(cpu_set_t), &cpuset);
+#else
+    (void)th; (void)core;
+#endif
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  bool pin;
+};
+
+#endif
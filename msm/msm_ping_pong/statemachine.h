@@ -0,0 +1,539 @@
+#ifndef STATEMACHINE_H
+#define STATEMACHINE_H
+
+#include <iostream>
+#include <string>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+#include <boost/msm/front/state_machine_def.hpp>
+#include <boost/msm/front/functor_row.hpp>
+#include <boost/msm/back/state_machine.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/mpl/size.hpp>
+
+
+#include <experimental/optional>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "span.h"
+#include "handler_allocator.h"
+#include "async_logger.h"
+#include "trace_recorder.h"
+#include "timer_stats.h"
+#include "pluggable_clock.h"
+#include "snapshot_file.h"
+#include "ring_config.h"
+#include "pooled_event_queue.h"
+
+
+namespace msm = boost::msm;
+namespace mpl = boost::mpl;
+
+using msm::front::Row;
+using msm::front::Internal;
+using msm::front::none;
+
+
+// Data for DEventTimeout
+struct TimeoutData {
+  std::chrono::steady_clock::time_point time_point;
+};
+
+//////////
+// events
+//////////
+struct EventI {};  // pIng    event: leave current state and go to ping state
+struct EventO {};  // pOng    event: leave current state and go to pong state
+struct EventX {};  // xchange event: change between ping and pong
+struct EventT {};  // toggle timer on/off
+struct DEventTimeout {
+  TimeoutData data;  /* Timeout Event
+                        This will be a DataEvent [DEvent] carrying the timestamp-of-timeout.
+                        Reason:
+                        if we timeout and enter a new state; and setup a new timer, there is a brief delay until that timer is running.
+                        This could cause timer drift.
+                        Therefore the timeout event carries the timestamp-of-timeout, so that the new timer can be
+                        setup (taking into consideration timestamp-of-timeout), leading to *no* timer drift!
+                     */
+};
+
+
+enum EventID {
+  eidI, // pIng
+  eidO, // pOng
+  eidX, // xchange
+  eidT, // toggle timer on/off
+  eidQ, // quit
+  eidTimeout // DEventTimeout (not from the keyboard: carries TimeoutData)
+};
+
+// an event as a value: id plus (for eidTimeout) its data
+struct TaggedEvent {
+  EventID     eid;
+  TimeoutData data;
+};
+
+// EventID of an event-type (for logging)
+template <typename Event> struct event_id                { static constexpr std::uint8_t value = LogRecord::no_event; };
+template <>               struct event_id<EventI>        { static constexpr std::uint8_t value = eidI; };
+template <>               struct event_id<EventO>        { static constexpr std::uint8_t value = eidO; };
+template <>               struct event_id<EventX>        { static constexpr std::uint8_t value = eidX; };
+template <>               struct event_id<EventT>        { static constexpr std::uint8_t value = eidT; };
+template <>               struct event_id<DEventTimeout> { static constexpr std::uint8_t value = eidTimeout; };
+
+
+
+
+// base to give states names
+struct NameBase {
+  NameBase(const std::string& name_) : name{name_}, log_id{AsyncLogger::instance().register_state(name_)} {}
+  
+  const std::string& get_name() const { return name; }
+
+  // log entry or exit (asynchronously: see async_logger.h) and record it in the trace of this thread, if any
+  // (instance: of the machine, see StateMachineBase)
+  template <class Event>
+  void log(LogRecord::Kind kind, const Event&, std::uint32_t instance) const {
+    const std::uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(PluggableClock::now().time_since_epoch()).count();
+    if (TraceRecorder *trace = TraceRecorder::current())
+      trace->record(now, kind, log_id, event_id<Event>::value, instance);
+    AsyncLogger::instance().log(kind, log_id, event_id<Event>::value, instance, now);
+  }
+  
+private:
+  const std::string name;
+  const std::uint16_t log_id;
+};
+
+// base to log on_entry and on_exit
+struct StateBase : public msm::front::state<>, public NameBase
+{
+  StateBase(const std::string& name_) : NameBase{name_} { std::cout << "instantiating object " << get_name() << std::endl; }
+
+  // (the back-end constructs the states: the instance id is the machine's)
+  template <class Event, class FSM>
+  void on_entry(const Event& event, FSM& fsm) {log(LogRecord::entry, event, fsm.get_instance());}
+  
+  template <class Event, class FSM>
+  void on_exit(const Event& event, FSM& fsm)  {log(LogRecord::exit, event, fsm.get_instance());}
+};
+
+
+// state with lifetime-timers
+//
+// The back-end default-constructs its states, so a state cannot be handed the io_service of its
+// machine: the timer is bound to fsm.get_io_service() when it is started first (every timer
+// operation gets the fsm). So each machine runs on the io_service it was constructed with.
+//
+// While deferred (see process_events() below) the timer is not started on entry: only the
+// expiry is noted, and flush_timer() starts it at the end of the batch. So only the last
+// re-arm of a batch reaches the io_service.
+//
+// Whether the timers run is a flag of the machine (see TimedMachine), read on entry: switching
+// it only concerns the active state (see set_timers_running() below).
+struct StateTime : StateBase
+{
+  StateTime(const std::string &name, std::chrono::steady_clock::duration max_lifetime_)
+    : StateBase{name}, max_lifetime{max_lifetime_},
+      deferred{false}, pending{false}, waiting{false} {}
+  
+  template <class Event, class FSM>    // see overload below
+  void on_entry(const Event &event, FSM &fsm)
+  {
+    if (fsm.is_timer_running())
+      arm(PluggableClock::now() + max_lifetime, fsm);
+    StateBase::on_entry(event, fsm);
+  }
+
+  template <class FSM>                 // overload: specializing Event to DEventTimeout
+  void on_entry(const DEventTimeout &event, FSM &fsm)
+  {
+    if (fsm.is_timer_running())
+      arm(event.data.time_point + max_lifetime, fsm, true);
+    StateBase::on_entry(event, fsm);
+  }
+  
+  template <typename Event, typename FSM>
+  void on_exit(const Event &event, FSM &fsm) {
+    disarm();
+    StateBase::on_exit(event, fsm);
+  }
+  
+  /* fsm.is_timer_running() changed: the active state starts a full lifetime or stops its timer
+     (no entry: we don't leave the state). An inactive state has no timer to stop */
+  template <typename FSM>
+  void timer_running_changed(FSM &fsm, bool active = true) {
+    if (active && fsm.is_timer_running())
+      arm(PluggableClock::now() + max_lifetime, fsm);
+    else
+      disarm();
+  }
+
+  // batch mode: note expiries only; flush_timer() starts the timer (if still wanted)
+  void defer_timer(bool defer) { deferred = defer; }
+
+  // deadline of the lifetime-timer (valid in the active state, while the timer is running)
+  std::chrono::steady_clock::time_point deadline() const { return expiry; }
+
+  /* warm restart (see restore() below): no entry action; the active state re-arms its timer at
+     the deadline of the snapshot (snapshot_no_deadline: a full lifetime from now) */
+  template <typename FSM>
+  void restore(std::int64_t deadline_ns, FSM &fsm, bool active) {
+    disarm();
+    if (fsm.is_timer_running() && active)
+      arm((deadline_ns == snapshot_no_deadline) ? PluggableClock::now() + max_lifetime
+                                                : std::chrono::steady_clock::time_point{std::chrono::nanoseconds{deadline_ns}}, fsm);
+  }
+
+  template <typename FSM>
+  void flush_timer(FSM &fsm) {
+    if (pending) {
+      pending = false;
+      if (!timer)
+        timer.emplace(fsm.get_io_service());
+      timer->expires_at(expiry);
+      start_timer(fsm);
+    }
+  }
+  
+private:
+  static std::int64_t to_ns(std::chrono::steady_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+  }
+
+  // from_timeout: expiry_ is the previous deadline + max_lifetime (see TimerStats)
+  template <typename FSM>
+  void arm(std::chrono::steady_clock::time_point expiry_, FSM &fsm, bool from_timeout = false) {
+    if (from_timeout)
+      fsm.timer_stats().rearmed(std::chrono::duration_cast<std::chrono::nanoseconds>(max_lifetime).count());
+    else
+      fsm.timer_stats().armed(to_ns(expiry_));
+    expiry  = expiry_;
+    pending = true;
+    if (!deferred)
+      flush_timer(fsm);
+  }
+
+  void disarm() {
+    pending = false;
+    if (waiting) {
+      timer->cancel();
+      waiting = false;
+    }
+  }
+
+  /* a wait that expired just before it was cancelled completes with success all the same: after
+     disarm() (not waiting) or a re-arm (deadline ahead) it is outdated and ignored */
+  template <typename FSM>
+  void timeout(const boost::system::error_code &err, FSM &fsm) {
+    if (err == boost::system::errc::success && waiting && timer->expires_at() <= PluggableClock::now()) {
+      waiting = false;
+      fsm.timer_stats().fired(to_ns(timer->expires_at()), to_ns(PluggableClock::now()));
+      fsm.process_event(DEventTimeout{{timer->expires_at()}});
+    }
+  }
+
+  template <typename FSM>
+  void start_timer(FSM &fsm) {
+    waiting = true;
+    timer->async_wait(make_recycling_handler(handler_memory,  // no heap allocation per wait
+                                            std::bind(&StateTime::timeout<FSM>, this, std::placeholders::_1, std::ref(fsm))));
+  }
+  
+  std::chrono::steady_clock::duration max_lifetime;
+  std::experimental::optional<PluggableTimer> timer; // steady_timer, or virtual time (see pluggable_clock.h); on the fsm's io_service
+
+  bool deferred;                                // batch mode
+  bool pending;                                 // expiry noted, timer not started yet
+  bool waiting;                                 // async_wait outstanding
+  std::chrono::steady_clock::time_point expiry; // of the pending timer
+
+  HandlerMemory handler_memory;                 // for the completion handlers of timer
+};
+
+
+// front-end base of a machine with timed states: what StateTime needs of its fsm
+class TimedMachine {
+public:
+  TimedMachine(boost::asio::io_service &io_service_) : io_service{io_service_}, timer_running{true} {}
+
+  boost::asio::io_service &get_io_service() const { return io_service; }
+
+  // accuracy of the timeouts (see timer_stats.h)
+  TimerStats &timer_stats() { return stats; }
+
+  bool is_timer_running() const { return timer_running; }
+  void set_timer_running(bool run) { timer_running = run; } // (the flag only: see set_timers_running())
+
+private:
+  boost::asio::io_service &io_service;
+  bool timer_running;
+  TimerStats stats;
+};
+
+
+
+/////////////////////////////////
+// the timed states of a machine (FSM: the back-end)
+//
+// for_each_state_time(fsm, f) calls f(StateTime &) for every state of the machine that derives
+// from StateTime: unrolled at compile time, over the state list of the back-end.
+//
+// active_state_time(fsm) is the active state, if it is a StateTime (else nullptr): one lookup by
+// state id in a table built once per machine type.
+/////////////////////////////////
+template <typename FSM, typename F>
+struct StateTimeVisitor {
+  FSM &fsm;
+  F   &f;
+
+  template <typename State>
+  void operator()(msm::wrap<State>) const {
+    if constexpr (std::is_base_of<StateTime, State>::value)
+      f(static_cast<StateTime &>(fsm.template get_state<State &>()));
+  }
+};
+
+template <typename FSM, typename F>
+void for_each_state_time(FSM &fsm, F &&f)
+{
+  mpl::for_each<typename FSM::state_list, msm::wrap<mpl::placeholders::_1>>(StateTimeVisitor<FSM, F>{fsm, f});
+}
+
+template <typename FSM>
+class StateTimeTable {
+public:
+  static const StateTimeTable &instance() { static const StateTimeTable table; return table; }
+
+  StateTime *get(FSM &fsm, int id) const {
+    return (id >= 0 && static_cast<std::size_t>(id) < getters.size() && getters[id]) ? getters[id](fsm) : nullptr;
+  }
+
+  template <typename State>
+  void operator()(msm::wrap<State>) {
+    if constexpr (std::is_base_of<StateTime, State>::value)
+      getters[msm::back::get_state_id<typename FSM::stt, State>::value] =
+        [](FSM &fsm) { return static_cast<StateTime *>(&fsm.template get_state<State &>()); };
+  }
+
+private:
+  StateTimeTable() { mpl::for_each<typename FSM::state_list, msm::wrap<mpl::placeholders::_1>>(std::ref(*this)); }
+
+  std::array<StateTime *(*)(FSM &), mpl::size<typename FSM::state_list>::value> getters{}; // by state id
+};
+
+template <typename FSM>
+StateTime *active_state_time(FSM &fsm)
+{
+  return StateTimeTable<FSM>::instance().get(fsm, fsm.current_state()[0]); // (one region)
+}
+
+// switch the timers on/off: only the active state acts now, the others read the flag on entry
+template <typename FSM>
+void set_timers_running(FSM &fsm, bool run)
+{
+  fsm.set_timer_running(run);
+  if (StateTime *active = active_state_time(fsm))
+    active->timer_running_changed(fsm);
+}
+
+// action (for an internal transition of the machine: any state)
+struct Toggle_Timer
+{
+  template <class EVT, class FSM, class SourceState, class TargetState>
+  void operator()(const EVT &, FSM &fsm, SourceState &, TargetState &)
+  {
+    set_timers_running(fsm, !fsm.is_timer_running());
+  }
+};
+
+
+
+
+///////// Machine Base - VERION 0
+// struct StateTop_ : public msm::front::state_machine_def<StateTop_, StateBase>
+// {
+// public:
+//   StateTop_(const std::string& name_) {}
+
+
+
+///////// Machine Base - VERION 1
+template <typename Machine>
+struct StateMachineBase : public msm::front::state_machine_def<StateMachineBase<Machine>>, public NameBase
+{
+public:
+  // instance: id of the machine in the log and the trace (e.g. one of many in a ShardedRuntime)
+  StateMachineBase(const std::string& name_, std::uint32_t instance_ = 0) : NameBase{name_}, instance{instance_} {}
+
+  std::uint32_t get_instance() const { return instance; }
+
+  template <class Event, class FSM>
+  void on_entry(const Event& event, FSM&) {this->log(LogRecord::entry, event, instance);}
+  
+  template <class Event, class FSM>
+  void on_exit(const Event& event, FSM&)  {this->log(LogRecord::exit, event, instance);}
+
+private:
+  std::uint32_t instance;
+
+};
+
+
+// front-end: define the FSM structure
+struct StateMachine_ : public StateMachineBase<StateMachine_>, public TimedMachine
+{
+  // the timers of the states run on io_service (the back-end forwards its constructor arguments here)
+  StateMachine_(const std::string& name_, boost::asio::io_service &io_service_, std::uint32_t instance = 0)
+    : StateMachineBase{name_, instance}, TimedMachine{io_service_} {}
+
+  // lifetime of StatePing (phase 0) / StatePong (phase 1): from ring 0 of the ring config (see ring_config.h)
+  static std::chrono::nanoseconds ping_pong_lifetime(std::size_t phase) {
+    const RingConfig &config = RingConfig::current();
+    config.require_phases(0, 2, "statePing, statePong");
+    return config.lifetime(0, phase);
+  }
+
+
+  ////////////
+  // StatePing
+  ////////////
+  struct StatePing : StateTime {
+    StatePing() : StateTime("StatePing", ping_pong_lifetime(0)) {}
+  };
+
+  ////////////
+  // StatePong
+  ////////////
+  struct StatePong : StateTime {
+    //    StatePong() : StateTime("StatePong") {}
+    StatePong() : StateTime("StatePong", ping_pong_lifetime(1)) {}
+  };
+  
+
+  typedef StatePing initial_state;
+
+
+  struct transition_table : mpl::vector<
+    _row<StatePing, EventX, StatePong>,
+    _row<StatePong, EventX, StatePing>,
+    
+    _row<StatePing, EventO, StatePong>, // next-state is StatePong in both lines. can we not group the start-states StatePing and StatePong together?
+    _row<StatePong, EventO, StatePong>,
+
+    _row<StatePing, EventI, StatePing>, // next-state is StatePing in both lines. can we not group the start-states StatePing and StatePong together?
+    _row<StatePong, EventI, StatePing>,
+
+    _row<StatePing, DEventTimeout, StatePong>,
+    _row<StatePong, DEventTimeout, StatePing>
+    >{};
+
+  // in every state (a timed state added to the table needs no row of its own)
+  struct internal_transition_table : mpl::vector<
+    Internal<EventT, Toggle_Timer, none>
+    >{};
+};
+
+/* events sent into the machine while it processes one (e.g. from an action) queue in a ring
+   inside the machine: no allocation per event (see pooled_event_queue.h). No state defers events */
+typedef msm::back::state_machine<StateMachine_, queue_container_pool<8, 1>> StateMachine;
+
+
+
+// runtime-tagged event into the back-end
+inline void process_event(StateMachine &sm, const TaggedEvent &event)
+{
+  switch (event.eid) {
+  case eidI:       sm.process_event(EventI{}); break;
+  case eidO:       sm.process_event(EventO{}); break;
+  case eidX:       sm.process_event(EventX{}); break;
+  case eidT:       sm.process_event(EventT{}); break;
+  case eidTimeout: sm.process_event(DEventTimeout{event.data}); break;
+  case eidQ:       sm.stop(); break;
+  default:         break;
+  }
+}
+
+/* batch adapter for the back-end: every event runs to completion, in order. Across the batch,
+   timers are re-armed once (the last re-arm takes effect) */
+inline void process_events(StateMachine &sm, Span<const TaggedEvent> events)
+{
+  for_each_state_time(sm, [](StateTime &state) { state.defer_timer(true); });
+
+  for (const TaggedEvent &event : events)
+    process_event(sm, event);
+
+  for_each_state_time(sm, [&](StateTime &state) {
+      state.defer_timer(false);
+      state.flush_timer(sm);
+    });
+}
+
+
+
+
+/////////////////////////////////
+// snapshot / warm restart (see snapshot_file.h)
+//
+// The back-end keeps the active state in a private array; the one public way to set it is its
+// serialize() (for boost::serialization). StateIdArchive is an "archive" that only reads or
+// writes that array and skips everything else.
+/////////////////////////////////
+class StateIdArchive {
+public:
+  explicit StateIdArchive(int state_id_) : state_id{state_id_} {}
+
+  template <int N>
+  StateIdArchive &operator&(int (&states)[N]) {
+    states[0] = state_id;       // one region
+    return *this;
+  }
+
+  template <typename T>
+  StateIdArchive &operator&(T &&) { return *this; }
+
+private:
+  int state_id;
+};
+
+// snapshot state (0 = statePing, 1 = statePong) <-> state id of the back-end
+inline std::uint8_t snapshot_state(const StateMachine &sm)
+{
+  return (sm.current_state()[0] == msm::back::get_state_id<StateMachine::stt, StateMachine_::StatePong>::value) ? 1 : 0;
+}
+
+inline MachineSnapshot snapshot(StateMachine &sm)
+{
+  MachineSnapshot snap{snapshot_no_deadline, sm.get_instance(), snapshot_state(sm), sm.is_timer_running(), 0};
+  if (snap.timer_running)
+    if (const StateTime *active = active_state_time(sm))
+      snap.deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(active->deadline().time_since_epoch()).count();
+  return snap;
+}
+
+/* warm restart, instead of sm.start(): continue in the state of the snapshot (without entry
+   actions). A running timer is re-armed at its original deadline, so chains of timeouts go on
+   without drift; a deadline that passed during the restart fires at once.
+   clock_offset_ns: see SnapshotReader::clock_offset_ns() */
+inline void restore(StateMachine &sm, const MachineSnapshot &snap, std::int64_t clock_offset_ns = 0)
+{
+  const bool pong = (snap.state == 1);
+  StateIdArchive archive{pong ? static_cast<int>(msm::back::get_state_id<StateMachine::stt, StateMachine_::StatePong>::value)
+                              : static_cast<int>(msm::back::get_state_id<StateMachine::stt, StateMachine_::StatePing>::value)};
+  sm.serialize(archive, 0);
+
+  const std::int64_t deadline_ns = (snap.deadline_ns == snapshot_no_deadline) ? snap.deadline_ns : snap.deadline_ns + clock_offset_ns;
+  sm.set_timer_running(snap.timer_running != 0);
+  const StateTime *active = active_state_time(sm);
+  for_each_state_time(sm, [&](StateTime &state) { state.restore(deadline_ns, sm, &state == active); });
+}
+
+#endif
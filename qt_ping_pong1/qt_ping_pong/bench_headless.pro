@@ -0,0 +1,16 @@
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+TARGET = bench_headless
+
+QT += core
+
+INCLUDEPATH += ../../common
+
+HEADERS += usereventtransition.h statemachine.h
+
+HEADERS += userevents.h   tptimer.h
+SOURCES += userevents.cpp tptimer.cpp
+
+SOURCES += bench_headless.cpp
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <csignal>
+#include <cstring>
 #include <QCoreApplication>
 #include <QTimer>
 #include "interfacethread.h"
@@ -6,18 +8,46 @@
 #include "statemachine.h"
 #include "interlayer_connections.h"
 
+static volatile std::sig_atomic_t reportRequested = 0;
+
+static const char usage[] = "usage: ping_pong [--ring file] [trace_file]\n";
+
 int main(int argc, char *argv[])
 {
   QCoreApplication app{argc, argv};
 
+  const char *tracePath = "ping_pong.trace";
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--ring")) {
+      if (i + 1 == argc) {
+        std::cerr << argv[i] << ": value missing\n" << usage;
+        return 1;
+      }
+      try {
+        RingConfig::current() = RingConfig::load(argv[++i]); // lifetimes of statePing, statePong (see ring_config.h)
+        RingConfig::current().require_phases(0, 2, "statePing, statePong");
+      }
+      catch (const std::exception &e) {
+        std::cerr << e.what() << '\n' << usage;
+        return 1;
+      }
+    }
+    else if (!std::strncmp(argv[i], "--", 2)) {
+      std::cerr << argv[i] << ": unknown option\n" << usage;
+      return 1;
+    }
+    else
+      tracePath = argv[i];
+  }
+
   register_metatype_userevents();
 
 
   std::cout <<
     "There are 2 states: statePing and statePong\n"
     "When timer running then:\n"
-    "Maximum lifetime of statePing is 1000 ms - it will then automatically transition to statePong;\n"
-    "Maximum lifetime of statePong is 2000 ms - it will then automatically transition to statePing.\n"
+    "Maximum lifetime of statePing is " << std::chrono::duration_cast<std::chrono::milliseconds>(RingConfig::current().lifetime(0, 0)).count() << " ms - it will then automatically transition to statePong;\n"
+    "Maximum lifetime of statePong is " << std::chrono::duration_cast<std::chrono::milliseconds>(RingConfig::current().lifetime(0, 1)).count() << " ms - it will then automatically transition to statePing.\n"
     "\n"
     "Keyboard-Input can cause transitions before the max-lifetime-timeouts:\n"
     "'x': xchange state\n"
@@ -35,10 +65,30 @@ int main(int argc, char *argv[])
   th.start();
   publish_interface_to_interlayer(th);
 
+  // always-on trace of every entry / exit (see trace_recorder.h; decode with trace_decode)
+  TraceRecorder trace{tracePath};
+  TraceRecorder::current() = &trace; // the machine runs on this thread (app.exec() below)
+
   // statemachine (running in eventloop)
   StateMachine sm{"statemachine"};
   subscribe_statemachine_to_interlayer(sm);
   sm.start();
 
-  return app.exec();
+  // timer accuracy (lateness, phase error): reported on SIGUSR1 (polled in the eventloop) and at exit
+  std::signal(SIGUSR1, [](int) { reportRequested = 1; });
+  QTimer reportPoll;
+  QObject::connect(&reportPoll, &QTimer::timeout, [&]() {
+      if (reportRequested) {
+        reportRequested = 0;
+        sm.timerStats().report(std::cerr);
+      }
+    });
+  reportPoll.start(250);
+
+  const int ret = app.exec();
+
+  AsyncLogger::instance().flush(); // last "Leaving : ..."
+  sm.timerStats().report(std::cerr);
+
+  return ret;
 }
@@ -0,0 +1,65 @@
+// headless benchmark (same synthetic keyboard stream for every realization; see headless_bench.h)
+//
+// usage: bench_headless [num_events] [num_instances]
+//
+// Timers are running (every transition re-arms one); each event is posted to the machine and
+// the eventloop runs once (processEvents), which is where QStateMachine handles posted events.
+
+#include <iostream>
+#include <cstdlib>
+
+#include <memory>
+#include <vector>
+
+#include <QCoreApplication>
+
+#include "statemachine.h"
+#include "headless_bench.h"
+
+
+
+static QEvent *to_event(char c)
+{
+  switch (c) {
+  case 'i': return new UserEventI{};
+  case 'o': return new UserEventO{};
+  default:  return new UserEventX{};
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app{argc, argv};
+
+  const std::size_t n = (argc > 1) ? std::atol(argv[1]) : 1000000;
+  const std::size_t k = (argc > 2) ? std::atol(argv[2]) : 10000;
+
+  AsyncLogger::instance().set_output(nullptr);
+  HeadlessBench bench{"qt_ping_pong_event_templates"};
+
+  {
+    std::vector<std::unique_ptr<StateMachine>> instances;
+    bench.rss_per_instance(k, instances, [&]() {
+        std::unique_ptr<StateMachine> sm{new StateMachine{"statemachine"}};
+        sm->start();
+        QCoreApplication::processEvents();
+        return sm;
+      });
+  }
+
+  StateMachine sm{"statemachine"};
+  sm.start();
+  QCoreApplication::processEvents();
+
+  const auto deliver = [&](char c) {
+    sm.postEvent(to_event(c));
+    QCoreApplication::processEvents();
+  };
+  bench.throughput(n / 10, deliver); // warmup
+  bench.throughput(n, deliver);
+  bench.latency(n, deliver);
+
+  bench.report(std::cout);
+  return 0;
+}
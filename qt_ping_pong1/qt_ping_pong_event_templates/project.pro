@@ -5,7 +5,7 @@ TARGET = ping_pong
 
 QT += core
 
-INCLUDEPATH +=
+INCLUDEPATH += ../../common
 
 HEADERS += interfacethread.h usereventtransition.h statemachine.h
 
@@ -5,29 +5,49 @@
 #include <QState>
 #include <iostream>
 #include <string>
-
+#include <cstdint>
+#include <chrono>
+#include <stdexcept>
+
+#include "async_logger.h"
+#include "trace_recorder.h"
+#include "timer_stats.h"
+#include "ring_config.h"
 #include "userevents.h"
 #include "usereventtransition.h"
 #include "tptimer.h"
 
 /////////////
 // StateBase
-// (can print)
+// (logs entry and exit asynchronously: see async_logger.h; and records them in the trace of this thread, if any)
 /////////////
 class StateBase : public QState {
  public:
- StateBase(const std::string &name_, QState * parent = nullptr)                      : QState{parent},            name{name_} {}
- StateBase(const std::string &name_, ChildMode childMode, QState * parent = nullptr) : QState{childMode, parent}, name{name_} {}
+ StateBase(const std::string &name_, QState * parent = nullptr)                      : QState{parent},            logId{AsyncLogger::instance().register_state(name_)} {}
+ StateBase(const std::string &name_, ChildMode childMode, QState * parent = nullptr) : QState{childMode, parent}, logId{AsyncLogger::instance().register_state(name_)} {}
     
  protected:
-  void onEntry(QEvent */*event*/) {
-    std::cout << "Entering: " << name << std::endl;
+  void onEntry(QEvent *event) {
+    record(LogRecord::entry, eventId(event));
   }
-  void onExit(QEvent */*event*/) {
-    std::cout << "Leaving : " << name << std::endl;
+  void onExit(QEvent *event) {
+    record(LogRecord::exit, eventId(event));
   }
  private:
-  std::string name;
+  void record(LogRecord::Kind kind, std::uint8_t event) {
+    const std::uint64_t now = AsyncLogger::now_ns();
+    if (TraceRecorder *trace = TraceRecorder::current())
+      trace->record(now, kind, logId, event, 0);
+    AsyncLogger::instance().log(kind, logId, event, 0, now);
+  }
+
+  // user events are logged as their offset from QEvent::User, all others (e.g. start of the machine) as no_event
+  static std::uint8_t eventId(const QEvent *event) {
+    const int id = event ? static_cast<int>(event->type()) - QEvent::User : -1;
+    return (id >= 0 && id < LogRecord::no_event) ? static_cast<std::uint8_t>(id) : LogRecord::no_event;
+  }
+
+  std::uint16_t logId;
 };
 
 
@@ -53,10 +73,18 @@ class StateTime : public StateBase {
     if (!timerRunning) {
       timer.stop();
     } else {
-      if (active()) // setTimerRunning is called on statePing and statePong: only start the timer in the active state!
+      if (active()) { // setTimerRunning is called on statePing and statePong: only start the timer in the active state!
         timer.start(milliMaxLifetime);
+        if (timerStats)
+          timerStats->armed(timer.expiryTimePoint() * 1000000);
+      }
     }
   }
+
+  // accuracy of the timeouts is recorded here (see timer_stats.h)
+  void setTimerStats(TimerStats *stats) {
+    timerStats = stats;
+  }
   
  protected:
   void onEntry(QEvent *event) {
@@ -68,10 +96,14 @@ class StateTime : public StateBase {
           //std::cout << "prevExpiryTimestamp: " << prevExpiryTimestamp << std::endl;
           timer.startToTimePoint(prevExpiryTimestamp + milliMaxLifetime); // start timer
           //                      ^^ no drift!
+          if (timerStats)
+            timerStats->rearmed(qint64{milliMaxLifetime} * 1000000);
         }
         break;
       default:
         timer.start(milliMaxLifetime);
+        if (timerStats)
+          timerStats->armed(timer.expiryTimePoint() * 1000000);
         break;
       }
     }
@@ -100,8 +132,12 @@ class StateTime : public StateBase {
 
     connect(&timer, &TpTimer::timeout,
             /* fire UserDEventTimeout event */
-            [&]() { machine()->postEvent(new UserDEventTimeout{  TimeoutData{timer.expiryTimePoint()} }); });
-    //                                                                             ^^ expiry timestamp
+            [&]() {
+              if (timerStats) // TpTimer works in milliseconds
+                timerStats->fired(timer.expiryTimePoint() * 1000000, TpTimer::nowTimePoint() * 1000000);
+              machine()->postEvent(new UserDEventTimeout{  TimeoutData{timer.expiryTimePoint()} });
+            });
+    //                                                                 ^^ expiry timestamp
 
 
     // alternative: use timeout slot above
@@ -112,6 +148,7 @@ class StateTime : public StateBase {
   unsigned milliMaxLifetime;
   TpTimer timer;
   bool timerRunning;
+  TimerStats *timerStats = nullptr;
 };
 
 
@@ -129,8 +166,8 @@ class StateMachine : public QStateMachine {
  StateMachine(const std::string &name_, QObject * parent = nullptr)
    : QStateMachine{parent},            name{name_}, timersRunning{true},
      stateTop{this},
-     statePing{"statePing", 1000, timersRunning, &stateTop},
-     statePong{"statePong", 2000, timersRunning, &stateTop}
+     statePing{"statePing", pingPongLifetime(0), timersRunning, &stateTop},
+     statePong{"statePong", pingPongLifetime(1), timersRunning, &stateTop}
      /*
      , transX_toPing{&statePong},
        transX_toPong{&statePing},
@@ -146,8 +183,8 @@ class StateMachine : public QStateMachine {
  StateMachine(const std::string &name_, QState::ChildMode childMode, QObject * parent = nullptr)
    : QStateMachine{childMode, parent}, name{name_}, timersRunning{true},
      stateTop{this},
-     statePing{"statePing", 1000, timersRunning, &stateTop},
-     statePong{"statePong", 2000, timersRunning, &stateTop}
+     statePing{"statePing", pingPongLifetime(0), timersRunning, &stateTop},
+     statePong{"statePong", pingPongLifetime(1), timersRunning, &stateTop}
      /*
      , transX_toPing{&statePong},
        transX_toPong{&statePing},
@@ -195,6 +232,9 @@ class StateMachine : public QStateMachine {
 
 
    
+   statePing.setTimerStats(&stats);
+   statePong.setTimerStats(&stats);
+
    // stateTop  --- transT ----------|
    stateTop.addTransition(&transT);
    connect(&transT, &QAbstractTransition::triggered,
@@ -204,9 +244,21 @@ class StateMachine : public QStateMachine {
              statePong.setTimerRunning(timersRunning);
            });
  }
+
+ // accuracy of the timeouts (see timer_stats.h)
+ TimerStats &timerStats() { return stats; }
  
  private:
+ // lifetime (ms) of statePing (phase 0) / statePong (phase 1): from ring 0 of the ring config (see ring_config.h)
+ static unsigned pingPongLifetime(std::size_t phase)
+ {
+   const RingConfig &config = RingConfig::current();
+   config.require_phases(0, 2, "statePing, statePong");
+   return static_cast<unsigned>(std::chrono::duration_cast<std::chrono::milliseconds>(config.lifetime(0, phase)).count());
+ }
+
  std::string name;
+ TimerStats stats;
  bool timersRunning;
  QState stateTop; // top state, with 2 substates: statePing and statePong
  State statePing;
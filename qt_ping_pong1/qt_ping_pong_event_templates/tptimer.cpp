@@ -1,23 +1,48 @@
 #include "tptimer.h"
 #include <QDateTime>
+#include <QCoreApplication>
 
+#include <limits>
 
-TpTimer::TpTimer(QObject *parent) : QTimer{parent}, expireMillisFromEpoch{0}, passedTimepointsTrigger{false} {
+
+bool   TpTimer::virtualTime      = false;
+qint64 TpTimer::virtualNowMillis = 0;
+
+QList<TpTimer *> &TpTimer::timers() {
+  static QList<TpTimer *> all;
+  return all;
+}
+
+
+TpTimer::TpTimer(QObject *parent) : QTimer{parent}, expireMillisFromEpoch{0}, passedTimepointsTrigger{false},
+                                     parked{false}, parkedInterval{0} {
   connect(this, &QTimer::timeout, [&]() { if (isActive())
         {
           /* singleShot is false */
-          expireMillisFromEpoch += interval();
+          expireMillisFromEpoch += realInterval();
         }});
+  timers().append(this);
+}
+
+TpTimer::~TpTimer() {
+  timers().removeOne(this);
 }
 
 void TpTimer::start() {
-  expireMillisFromEpoch = QDateTime::currentMSecsSinceEpoch() + interval();
-  QTimer::start();
+  const int msec = realInterval();
+  expireMillisFromEpoch = nowTimePoint() + msec;
+  if (virtualTime)
+    park(msec);
+  else
+    QTimer::start();
 }
 
 void TpTimer::start(int msec) {
-  expireMillisFromEpoch = QDateTime::currentMSecsSinceEpoch() + msec;
-  QTimer::start(msec);
+  expireMillisFromEpoch = nowTimePoint() + msec;
+  if (virtualTime)
+    park(msec);
+  else
+    QTimer::start(msec);
 }
 
 qint64 TpTimer::expiryTimePoint() const {
@@ -27,12 +52,19 @@ qint64 TpTimer::expiryTimePoint() const {
 void TpTimer::startToTimePoint(qint64 millisSinceEpoch) {
   // set timer to expire at this millis-count-relative-to-epoch
   expireMillisFromEpoch = millisSinceEpoch;
-  const qint64 interval = expireMillisFromEpoch - QDateTime::currentMSecsSinceEpoch();
-  if (interval >= 0)
-    QTimer::start(interval);
+  const qint64 interval = expireMillisFromEpoch - nowTimePoint();
+  if (interval >= 0) {
+    if (virtualTime)
+      park(interval);
+    else
+      QTimer::start(interval);
+  }
   else {
     if (passedTimepointsTrigger) {
-      QTimer::start(0);
+      if (virtualTime)
+        park(0);                     // runVirtualUntil: times out first
+      else
+        QTimer::start(0);
     }
   }
 }
@@ -48,3 +80,40 @@ void TpTimer::setExpiryTimePoint(qint64 millisSinceEpoch) {
 void TpTimer::setPassedTimepointsTrigger(bool trigger) {
   passedTimepointsTrigger = trigger;
 }
+
+
+void TpTimer::park(int msec) {
+  parked         = true;
+  parkedInterval = msec;
+  QTimer::start(std::numeric_limits<int>::max()); // ~24 days
+}
+
+void TpTimer::useVirtualTime(qint64 startMillis) {
+  virtualTime      = true;
+  virtualNowMillis = startMillis;
+}
+
+int TpTimer::runVirtualUntil(qint64 millisSinceEpoch) {
+  int timeouts = 0;
+  for (;;) {
+    QCoreApplication::processEvents(); // everything that is ready (e.g. the transitions of the last timeout)
+
+    TpTimer *next = nullptr;           // earliest expiry-timepoint (ties: the timer created first)
+    for (TpTimer *t : timers())
+      if (t->isActive() && (!next || t->expireMillisFromEpoch < next->expireMillisFromEpoch))
+        next = t;
+    if (!next || next->expireMillisFromEpoch > millisSinceEpoch)
+      break;
+
+    if (next->expireMillisFromEpoch > virtualNowMillis)
+      virtualNowMillis = next->expireMillisFromEpoch;
+    next->QTimer::start(0);            // time out now ...
+    QCoreApplication::processEvents();
+    if (next->isActive())              // ... a repeating timer goes back to the parking lot
+      next->park(next->parkedInterval);
+    ++timeouts;
+  }
+  if (millisSinceEpoch > virtualNowMillis)
+    virtualNowMillis = millisSinceEpoch;
+  return timeouts;
+}
@@ -3,6 +3,7 @@
 
 #include <QTimer>
 #include <QDateTime>
+#include <QList>
 
 
 /////////////////////////////////
@@ -12,6 +13,7 @@ class TpTimer : public QTimer {
   Q_OBJECT
  public:
   TpTimer(QObject *parent = nullptr);
+  ~TpTimer();
 
   public slots:
     void   start();               /* Stops and restarts the timer: timeout interval given in interval - func setInterval */
@@ -36,9 +38,17 @@ class TpTimer : public QTimer {
     void setExpiryTimePoint(qint64 millisSinceEpoch); /* set expiry-timepoint without starting the timer. 
                                                          resumeToTimePoint() will start the timer towards that timepoint */
 
-    static inline qint64 nowTimePoint() {           /* return current milliseconds since Epoch */
-      return QDateTime::currentMSecsSinceEpoch();
+    static inline qint64 nowTimePoint() {           /* return current milliseconds since Epoch
+                                                       (virtual time, after useVirtualTime) */
+      return virtualTime ? virtualNowMillis : QDateTime::currentMSecsSinceEpoch();
     }
+
+    static void useVirtualTime(qint64 startMillis = 0); /* switch all TpTimers to virtual time (before any timer is started!):
+                                                           started timers are parked, and only time out in runVirtualUntil */
+
+    static int runVirtualUntil(qint64 millisSinceEpoch); /* virtual time: time out the parked timers in order of their
+                                                            expiry-timepoints (up to millisSinceEpoch), jumping the clock
+                                                            from one to the next. Returns the number of timeouts */
     
     void setPassedTimepointsTrigger(bool trigger); /* If true, then expiry-timepoints can lie in the past, and if timer is started
                                                       (either with startToTimePoint(millisSinceEpoch) or resumeToTimePoint())
@@ -52,6 +62,17 @@ class TpTimer : public QTimer {
                                   */
 
     bool passedTimepointsTrigger;  // if true, then expiresAt() can take timepoints that lie in the past and causes immediate timeout
+
+    // virtual time
+    void park(int msec);           // keep the QTimer active, but (practically) never let it time out by itself
+    int  realInterval() const { return parked ? parkedInterval : interval(); }
+
+    bool parked;
+    int  parkedInterval;           // the interval the timer would have, if it was not parked
+
+    static bool   virtualTime;
+    static qint64 virtualNowMillis;
+    static QList<TpTimer *> &timers(); // all TpTimers (runVirtualUntil picks the next one to time out)
 };
 
 
@@ -0,0 +1,227 @@
+// trace_decode: reads a trace file of TraceRecorder (see ../common/trace_recorder.h)
+//
+// usage: trace_decode [--csv | --stats] file
+//
+//   (default)  one line per record:   +elapsed_ms  [instance]  Entering: statePing  (event 2)
+//   --csv      timestamp_ns,instance,kind,state,event
+//   --stats    per-state dwell time (entry to exit of the same instance): count, min, mean, p50, p99, max
+//
+// Blocks are decoded oldest first; records lost to the rolling limit are simply absent.
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "trace_recorder.h"
+
+
+
+struct Record {
+  std::uint64_t timestamp_ns;
+  std::uint32_t instance;
+  std::uint8_t  state;
+  std::uint8_t  event;   // trace_no_event: none
+  bool          exit;
+};
+
+static bool get_varint(const unsigned char *&in, const unsigned char *end, std::uint64_t &v)
+{
+  v = 0;
+  for (unsigned shift = 0; in != end && shift < 64; shift += 7) {
+    const unsigned char byte = *in++;
+    v |= std::uint64_t{byte & 0x7fu} << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+
+class TraceFile {
+public:
+  explicit TraceFile(const std::string &path) {
+    std::ifstream in{path, std::ios::binary};
+    if (!in)
+      throw std::runtime_error{"cannot open " + path};
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, trace_magic, sizeof(trace_magic)) != 0)
+      throw std::runtime_error{path + " is not a trace file"};
+    if (header.block_size <= sizeof(TraceBlockHeader) || header.block_size > max_block_size) // (corrupt: every block is read whole)
+      throw std::runtime_error{path + ": corrupt header (block_size " + std::to_string(header.block_size) + ")"};
+
+    // order of the blocks: by sequence number
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> order;
+    for (std::uint32_t b = 0; b < header.num_blocks; ++b) {
+      TraceBlockHeader bh;
+      in.seekg(block_offset(b));
+      in.read(reinterpret_cast<char *>(&bh), sizeof(bh));
+      if (in && bh.seq != 0)
+        order.emplace_back(bh.seq, b);
+    }
+    std::sort(order.begin(), order.end());
+    for (const auto &o : order)
+      blocks.push_back(o.second);
+
+    file = std::move(in);
+  }
+
+  std::string state_name(std::uint8_t state) const {
+    if (state < header.num_states && state < TraceFileHeader::max_states && header.names[state][0])
+      return std::string{header.names[state], strnlen(header.names[state], TraceFileHeader::name_size)};
+    return "state#" + std::to_string(state);
+  }
+
+  // calls f(const Record&) for every record, oldest first
+  template <typename F>
+  void for_each(F f) {
+    std::vector<unsigned char> data(header.block_size);
+    for (std::uint32_t b : blocks) {
+      file.clear();
+      file.seekg(block_offset(b));
+      file.read(reinterpret_cast<char *>(data.data()), header.block_size);
+      if (!file)
+        break;
+
+      TraceBlockHeader bh;
+      std::memcpy(&bh, data.data(), sizeof(bh));
+      const std::size_t used = std::min<std::size_t>(bh.used, header.block_size - sizeof(bh));
+      const unsigned char *in  = data.data() + sizeof(bh);
+      const unsigned char *end = in + used;
+
+      Record r;
+      r.timestamp_ns = bh.base_ns;
+      for (std::uint32_t i = 0; i < bh.num_records && in != end; ++i) {
+        std::uint64_t delta, instance;
+        if (!get_varint(in, end, delta) || end - in < 2)
+          break;
+        r.timestamp_ns += delta;
+        r.state = *in++;
+        r.exit  = (*in & trace_exit_bit) != 0;
+        r.event = *in++ & ~trace_exit_bit;
+        if (!get_varint(in, end, instance))
+          break;
+        r.instance = static_cast<std::uint32_t>(instance);
+        f(static_cast<const Record &>(r));
+      }
+    }
+  }
+
+private:
+  static constexpr std::uint32_t max_block_size = 64 * 1024 * 1024; // (TraceRecorder: 64 KiB by default)
+
+  std::streamoff block_offset(std::uint32_t b) const {
+    return static_cast<std::streamoff>(trace_header_size + std::size_t{b} * header.block_size);
+  }
+
+  TraceFileHeader header;
+  std::vector<std::uint32_t> blocks;
+  std::ifstream file;
+};
+
+
+
+static void print_text(TraceFile &trace)
+{
+  bool first = true;
+  std::uint64_t t0 = 0;
+  std::cout << std::fixed << std::setprecision(6);
+  trace.for_each([&](const Record &r) {
+      if (first) {
+        t0 = r.timestamp_ns;
+        first = false;
+      }
+      std::cout << '+' << std::setw(14) << (r.timestamp_ns - t0) / 1e6 << " ms  [" << r.instance << "]  "
+                << (r.exit ? "Leaving : " : "Entering: ") << trace.state_name(r.state);
+      if (r.event != trace_no_event)
+        std::cout << "  (event " << unsigned{r.event} << ')';
+      std::cout << '\n';
+    });
+}
+
+static void print_csv(TraceFile &trace)
+{
+  std::cout << "timestamp_ns,instance,kind,state,event\n";
+  trace.for_each([&](const Record &r) {
+      std::cout << r.timestamp_ns << ',' << r.instance << ',' << (r.exit ? "exit" : "entry") << ','
+                << trace.state_name(r.state) << ',';
+      if (r.event != trace_no_event)
+        std::cout << unsigned{r.event};
+      std::cout << '\n';
+    });
+}
+
+static void print_stats(TraceFile &trace)
+{
+  std::map<std::pair<std::uint32_t, std::uint8_t>, std::uint64_t> entered;  // (instance, state) -> entry time
+  std::map<std::uint8_t, std::vector<std::uint64_t>> dwell_ns;                // state -> dwell times
+
+  trace.for_each([&](const Record &r) {
+      const auto key = std::make_pair(r.instance, r.state);
+      if (!r.exit) {
+        entered[key] = r.timestamp_ns;
+      } else {
+        auto it = entered.find(key);
+        if (it != entered.end()) {   // exits without entry (lost to the rolling limit) are skipped
+          dwell_ns[r.state].push_back(r.timestamp_ns - it->second);
+          entered.erase(it);
+        }
+      }
+    });
+
+  std::cout << std::fixed << std::setprecision(3)
+            << std::left << std::setw(20) << "state" << std::right
+            << std::setw(10) << "count" << std::setw(12) << "min ms" << std::setw(12) << "mean ms"
+            << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms" << std::setw(12) << "max ms" << '\n';
+  for (auto &s : dwell_ns) {
+    std::vector<std::uint64_t> &d = s.second;
+    std::sort(d.begin(), d.end());
+    double sum = 0;
+    for (std::uint64_t ns : d)
+      sum += ns;
+    const auto pct = [&](double p) { return d[static_cast<std::size_t>(p * (d.size() - 1))] / 1e6; };
+    std::cout << std::left << std::setw(20) << trace.state_name(s.first) << std::right
+              << std::setw(10) << d.size() << std::setw(12) << d.front() / 1e6 << std::setw(12) << sum / d.size() / 1e6
+              << std::setw(12) << pct(0.5) << std::setw(12) << pct(0.99) << std::setw(12) << d.back() / 1e6 << '\n';
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  std::string mode;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg{argv[i]};
+    if (arg == "--csv" || arg == "--stats")
+      mode = arg;
+    else
+      path = arg;
+  }
+  if (path.empty()) {
+    std::cerr << "usage: " << argv[0] << " [--csv | --stats] file\n";
+    return 2;
+  }
+
+  try {
+    TraceFile trace{path};
+    if (mode == "--csv")
+      print_csv(trace);
+    else if (mode == "--stats")
+      print_stats(trace);
+    else
+      print_text(trace);
+  } catch (const std::exception &e) {
+    std::cerr << argv[0] << ": " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}